@@ -1854,6 +1854,86 @@ reload_text_fstruct(F_text *t)
     t->zoom = zoomscale;
 }
 
+/*
+ * Load the fonts needed for all texts at two other zoom scales, usually the
+ * next ones in and out, while xfig is idle. Zooming in or out then does not
+ * wait for the X server to load fonts.
+ */
+
+static struct text_font {
+    int		    fnum;
+    int		    size;
+} *prefetch_list = NULL;
+static int	    prefetch_n = 0, prefetch_max = 0;
+static XtWorkProcId prefetch_proc = 0;
+
+static void
+add_prefetch_font(F_text *t, float zoom)
+{
+    int		    i, fnum, size;
+
+    /* same as in reload_text_fstruct() */
+    fnum = x_fontnum(psfont_text(t), t->font);
+    size = round(t->size*zoom);
+    for (i = 0; i < prefetch_n; ++i)
+	if (prefetch_list[i].fnum == fnum && prefetch_list[i].size == size)
+	    return;
+    if (prefetch_n == prefetch_max) {
+	struct text_font *tmp;
+	int		 n = prefetch_max ? 2 * prefetch_max : 32;
+
+	tmp = realloc(prefetch_list, n * sizeof(struct text_font));
+	if (tmp == NULL)
+	    return;
+	prefetch_list = tmp;
+	prefetch_max = n;
+    }
+    prefetch_list[prefetch_n].fnum = fnum;
+    prefetch_list[prefetch_n++].size = size;
+}
+
+static void
+add_prefetch_fonts(F_text *texts, F_compound *compounds, float zoom1,
+			float zoom2)
+{
+    F_text	   *t;
+    F_compound	   *c;
+
+    for (t = texts; t != NULL; t = t->next) {
+	add_prefetch_font(t, zoom1);
+	add_prefetch_font(t, zoom2);
+    }
+    for (c = compounds; c != NULL; c = c->next)
+	add_prefetch_fonts(c->texts, c->compounds, zoom1, zoom2);
+}
+
+static Boolean
+prefetch_workproc(XtPointer client_data)
+{
+    (void)client_data;
+
+    /* load at most one font at each call */
+    while (prefetch_n > 0) {
+	--prefetch_n;
+	if (prefetch_font(prefetch_list[prefetch_n].fnum,
+				prefetch_list[prefetch_n].size))
+	    return False;
+    }
+    prefetch_proc = 0;
+    return True;
+}
+
+void
+prefetch_text_fstructs(float zoom1, float zoom2)
+{
+    prefetch_n = 0;
+    add_prefetch_fonts(objects.texts, objects.compounds, zoom1, zoom2);
+    if (appres.DEBUG)
+	fprintf(stderr, "prefetch_text_fstructs - %d fonts\n", prefetch_n);
+    if (prefetch_n > 0 && prefetch_proc == 0)
+	prefetch_proc = XtAppAddWorkProc(tool_app, prefetch_workproc, NULL);
+}
+
 
 /****************************************************************/
 /*								*/
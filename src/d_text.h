@@ -21,6 +21,7 @@ extern void	erase_char_string(void);
 extern void	finish_text_input(int x, int y, int shift);
 extern void	reload_text_fstruct(F_text *t);
 extern void	reload_text_fstructs(void);
+extern void	prefetch_text_fstructs(float zoom1, float zoom2);
 extern Boolean	text_selection_active;
 extern Boolean	ConvertSelection();
 extern void	LoseSelection(), TransferSelectionDone();
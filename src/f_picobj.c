@@ -37,15 +37,22 @@
 #include <sys/types.h>		/* time_t */
 #include <X11/Intrinsic.h>	/* includes X11/Xlib.h, which includes X11/X.h */
 
-#include "resources.h"		/* TMPDIR */
+#include "resources.h"		/* TMPDIR, PATH_MAX */
 #include "object.h"
 #include "f_readpcx.h"		/* read_pcx() */
-#include "f_util.h"		/* file_timestamp() */
+#include "f_uncompress.h"	/* open_uncompressed() */
+#include "f_util.h"		/* file_timestamp(), remapping_colors */
 #include "u_create.h"		/* create_picture_entry() */
-#include "w_file.h"		/* check_cancel() */
+#include "u_free.h"		/* free_picture_levels() */
+#include "u_redraw.h"		/* redisplay_line() */
+#include "u_undo.h"		/* saved_objects */
+#include "u_threads.h"		/* background_job() */
+#include "w_file.h"		/* check_cancel(), preview_in_progress */
+#include "w_library.h"		/* lib_compounds */
 #include "w_msgpanel.h"
 #include "w_setup.h"		/* PIX_PER_INCH, PIX_PER_CM */
 #include "w_util.h"		/* app_flush() */
+#include "w_zoom.h"		/* zoomscale */
 
 extern	int	read_gif(F_pic *pic, struct xfig_stream *restrict pic_stream);
 extern	int	read_eps(F_pic *pic, struct xfig_stream *restrict pic_stream);
@@ -66,34 +73,73 @@ extern	int	read_xpm(F_pic *pic, struct xfig_stream *restrict pic_stream);
 #endif
 
 
+/*
+ * Readers marked as background do not use Xlib or global state and can
+ * run in a worker thread, see read_picobj_background().
+ */
 static struct _haeders {
 	char	*type;
 	char	*bytes;
 	int	(*readfunc)();
+	Boolean	background;
 } headers[] = {
-	{"GIF",		"GIF",					read_gif},
-	{"PCX",		"\012\005\001",				read_pcx},
-	{"EPS",		"%!",					read_eps},
-	{"PDF",		"%PDF",					read_pdf},
-	{"PPM",		"P3",					read_ppm},
-	{"PPM",		"P6",					read_ppm},
+	{"GIF",		"GIF",					read_gif, True},
+	{"PCX",		"\012\005\001",				read_pcx, True},
+	{"EPS",		"%!",					read_eps, True},
+	{"EPS",		"\305\320\323\306",			read_eps, True},
+	{"PDF",		"%PDF",					read_pdf, True},
+	{"PPM",		"P3",					read_ppm, True},
+	{"PPM",		"P6",					read_ppm, True},
 #ifdef HAVE_TIFF
-	{"TIFF",	"II*\000",				read_tif},
-	{"TIFF",	"MM\000*",				read_tif},
+	{"TIFF",	"II*\000",				read_tif, True},
+	{"TIFF",	"MM\000*",				read_tif, True},
 #endif
-	{"XBM",		"#define",				read_xbm},
+	{"XBM",		"#define",				read_xbm, False},
 #ifdef HAVE_JPEG
-	{"JPEG",	"\377\330\377\340",			read_jpg},
-	{"JPEG",	"\377\330\377\341",			read_jpg},
+	{"JPEG",	"\377\330\377\340",			read_jpg, True},
+	{"JPEG",	"\377\330\377\341",			read_jpg, True},
 #endif
 #ifdef HAVE_PNG
-	{"PNG",		"\211\120\116\107\015\012\032\012",	read_png},
+	{"PNG",		"\211\120\116\107\015\012\032\012",	read_png, True},
 #endif
 #ifdef USE_XPM
-	{"XPM",		"/* XPM */",				read_xpm},
+	{"XPM",		"/* XPM */",				read_xpm, False},
 #endif
 };
 
+/*
+ * A picture read in the background. The reader fills in pic and cache,
+ * which are copied to the repository entry pics in the main thread.
+ */
+struct pic_load {
+	struct _pics	*pics;		/* NULL, if no longer wanted */
+	int		type;		/* index into headers[] */
+	int		stat;		/* return value of the reader */
+	F_pic		pic;
+	struct _pics	cache;
+	struct xfig_stream	stream;
+	struct pic_load	*next;		/* in the list of deferred arrivals */
+};
+
+/*
+ * The pictures repository is indexed by file name, and by the device and
+ * inode of the file on disk. A file that is referred to by several names is
+ * decoded only once. The timestamp of a picture file is checked once per
+ * load pass; a pass ends when xfig becomes idle.
+ */
+#define PIC_HASH_SIZE	1024
+
+static struct _pics	*name_table[PIC_HASH_SIZE];
+static struct _pics	*inode_table[PIC_HASH_SIZE];
+static unsigned		pic_pass = 1;
+static bool		pass_pending = false;
+
+/*
+ * If positive, no picture is shown larger than picture_size_limit pixels,
+ * e.g., while drawing a preview, and pictures may be decoded at that size.
+ */
+int			picture_size_limit = 0;
+
 
 static void
 init_stream(struct xfig_stream *restrict xf_stream)
@@ -102,6 +148,7 @@ init_stream(struct xfig_stream *restrict xf_stream)
 	xf_stream->name = xf_stream->name_buf;
 	xf_stream->name_on_disk = xf_stream->name_on_disk_buf;
 	xf_stream->uncompress = NULL;
+	xf_stream->piped = False;
 	xf_stream->content = xf_stream->content_buf;
 	*xf_stream->content = '\0';
 }
@@ -243,6 +290,126 @@ file_on_disk(char *restrict name, char *restrict *found, size_t len,
 	return 0;
 }
 
+static unsigned
+hash_name(const char *name)
+{
+	unsigned	h = 2166136261u;	/* FNV-1a */
+
+	while (*name)
+		h = (h ^ (unsigned char)*name++) * 16777619u;
+	return h % PIC_HASH_SIZE;
+}
+
+static unsigned
+hash_inode(dev_t dev, ino_t ino)
+{
+	return (unsigned)(((unsigned long)dev * 31u + (unsigned long)ino)
+			% PIC_HASH_SIZE);
+}
+
+static struct _pics *
+lookup_name(const char *file)
+{
+	struct _pics	*pics;
+
+	for (pics = name_table[hash_name(file)]; pics; pics = pics->hash_next)
+		if (strcmp(pics->file, file) == 0)
+			return pics;
+	return NULL;
+}
+
+/*
+ * Return another entry that holds the decoded picture of the file on disk
+ * of pics, if that is not older than mtime.
+ */
+static struct _pics *
+lookup_inode(struct _pics *pics, time_t mtime)
+{
+	struct _pics	*p;
+
+	for (p = inode_table[hash_inode(pics->dev, pics->ino)]; p;
+			p = p->inode_next)
+		if (p != pics && p->dev == pics->dev && p->ino == pics->ino &&
+				p->bitmap != NULL && p->load == NULL &&
+				p->reduced == 0 && p->time_stamp >= mtime)
+			return p;
+	return NULL;
+}
+
+static void
+unhash_inode(struct _pics *pics)
+{
+	struct _pics	**p;
+
+	for (p = &inode_table[hash_inode(pics->dev, pics->ino)]; *p;
+			p = &(*p)->inode_next)
+		if (*p == pics) {
+			*p = pics->inode_next;
+			break;
+		}
+	pics->inode_next = NULL;
+}
+
+/* record the device and inode of the file on disk of pics */
+static void
+set_inode(struct _pics *pics, const struct stat *st)
+{
+	unsigned	h;
+
+	unhash_inode(pics);
+	pics->dev = st->st_dev;
+	pics->ino = st->st_ino;
+	h = hash_inode(pics->dev, pics->ino);
+	pics->inode_next = inode_table[h];
+	inode_table[h] = pics;
+}
+
+static Boolean
+end_load_pass(XtPointer client_data)
+{
+	(void)client_data;
+
+	++pic_pass;
+	pass_pending = false;
+	return True;		/* remove the work procedure */
+}
+
+/* the timestamp of pics need not be checked again in this load pass */
+static void
+set_checked(struct _pics *pics)
+{
+	pics->checked = pic_pass;
+	if (!pass_pending) {
+		pass_pending = true;
+		(void)XtAppAddWorkProc(tool_app, end_load_pass, NULL);
+	}
+}
+
+/* copy the decoded picture of src to pics */
+static bool
+copy_picture(struct _pics *pics, struct _pics *src)
+{
+	size_t	size;
+
+	if (src->numcols == 0)
+		size = (size_t)((src->bit_size.x + 7) / 8) * src->bit_size.y;
+	else if (src->numcols < 0)
+		size = (size_t)src->bit_size.x * src->bit_size.y * 4;
+	else
+		size = (size_t)src->bit_size.x * src->bit_size.y;
+	if ((pics->bitmap = malloc(size)) == NULL)
+		return false;
+	memcpy(pics->bitmap, src->bitmap, size);
+	pics->subtype = src->subtype;
+	pics->size_x = src->size_x;
+	pics->size_y = src->size_y;
+	pics->bit_size = src->bit_size;
+	memcpy(pics->cmap, src->cmap, sizeof pics->cmap);
+	pics->numcols = src->numcols;
+	pics->transp = src->transp;
+	return true;
+}
+
 /*
  * Compare the picture information in pic with "file". If the file on disk
  * is newer than the picture information, set "reread" to true.
@@ -258,6 +425,10 @@ get_picture_status(F_pic *pic, struct _pics *pics, char *file, bool force,
 	const char	*uncompress;
 	time_t		mtime;
 
+	/* the timestamp was checked already in this load pass */
+	if (!force && pics->checked == pic_pass)
+		goto cached;
+
 	/* get the name of the file on disk */
 	if (file_on_disk(pics->file, &found, sizeof found_buf, &uncompress)) {
 		if (found != found_buf)
@@ -281,7 +452,9 @@ get_picture_status(F_pic *pic, struct _pics *pics, char *file, bool force,
 		*reread = true;
 		return 0;
 	}
+	set_checked(pics);
 
+cached:
 	pic->pic_cache = pics;
 	pics->refcount++;
 
@@ -303,6 +476,198 @@ get_picture_status(F_pic *pic, struct _pics *pics, char *file, bool force,
 	return 0;
 }
 
+/* called in a worker thread */
+static void
+read_in_background(void *arg)
+{
+	struct pic_load	*load = arg;
+
+	load->stat = headers[load->type].readfunc(&load->pic, &load->stream);
+	close_stream(&load->stream);
+	free_stream(&load->stream);
+}
+
+/*
+ * Show the picture in all picture objects in c that refer to it. Skip the
+ * compound skip, an open compound whose objects may be out of date.
+ */
+static void
+show_picture(F_compound *c, F_compound *skip, struct _pics *pics,
+		float hw_ratio, bool draw)
+{
+	F_compound	*c1;
+	F_line		*l;
+
+	for (c1 = c->compounds; c1 != NULL; c1 = c1->next)
+		if (c1 != skip)
+			show_picture(c1, skip, pics, hw_ratio, draw);
+	for (l = c->lines; l != NULL; l = l->next) {
+		if (l->type != T_PICTURE || l->pic->pic_cache != pics)
+			continue;
+		l->pic->hw_ratio = hw_ratio;
+		if (l->pic->pixmap != (Pixmap)0) {
+			XFreePixmap(tool_d, l->pic->pixmap);
+			l->pic->pixmap = (Pixmap)0;
+		}
+		if (l->pic->mask != (Pixmap)0) {
+			XFreePixmap(tool_d, l->pic->mask);
+			l->pic->mask = (Pixmap)0;
+		}
+		if (draw)
+			redisplay_line(l);
+	}
+}
+
+/*
+ * Pictures that arrive while the colors are remapped or while a preview is
+ * drawn, i.e., from events processed by check_cancel(), are shown later.
+ */
+static struct pic_load	*deferred_loads = NULL;
+static XtWorkProcId	deferred_proc = 0;
+
+static void	picture_arrived(void *arg);
+
+static Boolean
+show_deferred(XtPointer client_data)
+{
+	struct pic_load	*load;
+
+	(void)client_data;
+
+	if (remapping_colors || preview_in_progress)
+		return False;	/* try again, when idle */
+	deferred_proc = 0;
+	while ((load = deferred_loads) != NULL) {
+		deferred_loads = load->next;
+		picture_arrived(load);
+	}
+	return True;
+}
+
+/* called in the main thread, after read_in_background() */
+static void
+picture_arrived(void *arg)
+{
+	struct pic_load	*load = arg;
+	struct _pics	*pics = load->pics;
+	F_compound	*c, *skip;
+	int		i;
+	bool		all;
+
+	if (pics != NULL && (remapping_colors || preview_in_progress)) {
+		load->next = deferred_loads;
+		deferred_loads = load;
+		if (!deferred_proc)
+			deferred_proc = XtAppAddWorkProc(tool_app,
+							show_deferred, NULL);
+		return;
+	}
+
+	if (pics == NULL) {
+		/* the picture was deleted or re-read in the meantime */
+		if (load->stat == PicSuccess && load->cache.bitmap)
+			free(load->cache.bitmap);
+		free(load->cache.file);
+		free(load);
+		return;
+	}
+
+	pics->load = NULL;
+	if (pics->bitmap != NULL && pics->bitmap != load->cache.bitmap)
+		free(pics->bitmap);
+	free_picture_levels(pics);
+	pics->bitmap = load->cache.bitmap;
+	pics->subtype = load->cache.subtype;
+	pics->size_x = load->cache.size_x;
+	pics->size_y = load->cache.size_y;
+	pics->bit_size = load->cache.bit_size;
+	memcpy(pics->cmap, load->cache.cmap, sizeof pics->cmap);
+	pics->numcols = load->cache.numcols;
+	pics->transp = load->cache.transp;
+	pics->reduced = load->cache.reduced;
+
+	if (load->stat != PicSuccess)
+		file_msg("%s: Bad %s format", pics->file,
+				headers[load->type].type);
+	else if (appres.DEBUG)
+		fprintf(stderr, "Read picture %s in the background\n",
+				pics->file);
+
+	/* allocate colors; on a colormapped display, the colors of the other
+	   pictures may change, too */
+	all = false;
+	if (pics->bitmap != NULL && pics->numcols > 0) {
+		remap_imagecolors();
+		all = tool_vclass != TrueColor;
+	}
+	show_picture(&objects, NULL, pics, load->pic.hw_ratio, !all);
+	/* the figure around an open compound */
+	skip = objects.GABPtr;
+	for (c = objects.parent; c != NULL; c = c->parent) {
+		show_picture(c, skip, pics, load->pic.hw_ratio, !all);
+		skip = c->GABPtr;
+	}
+	/* objects that are not drawn, but may return into the figure */
+	show_picture(&saved_objects, NULL, pics, load->pic.hw_ratio, false);
+	for (i = 0; i < num_library_objects(); ++i)
+		if (lib_compounds[i]->compound != NULL)
+			show_picture(lib_compounds[i]->compound, NULL, pics,
+					load->pic.hw_ratio, false);
+	if (all)
+		redisplay_canvas();
+
+	free(load->cache.file);
+	free(load);
+}
+
+/* forget about a picture that is being read in the background */
+void
+cancel_picobj(struct _pics *pics)
+{
+	if (pics->load) {
+		pics->load->pics = NULL;
+		pics->load = NULL;
+	}
+}
+
+/* remove pics from the repository index */
+void
+remove_picobj(struct _pics *pics)
+{
+	struct _pics	**p;
+
+	cancel_picobj(pics);
+	unhash_inode(pics);
+	if (pics->file == NULL)
+		return;
+	for (p = &name_table[hash_name(pics->file)]; *p; p = &(*p)->hash_next)
+		if (*p == pics) {
+			*p = pics->hash_next;
+			break;
+		}
+	pics->hash_next = NULL;
+}
+
+/*
+ * Write the absolute path of file into buf, and return buf. Return file, if
+ * file is absolute or the path does not fit into buf. Picture files may be
+ * read in a worker thread, after xfig changed into another directory.
+ */
+static char *
+absolute_name(char *file, char *buf, size_t size)
+{
+	size_t	len;
+
+	if (*file == '/' || getcwd(buf, size) == NULL)
+		return file;
+	len = strlen(buf);
+	if (len + strlen(file) + 2 > size)
+		return file;
+	buf[len] = '/';
+	strcpy(buf + len + 1, file);
+	return buf;
+}
+
 /*
  * Check through the pictures repository to see if "file" is already there.
  * If so, set the pic->pic_cache pointer to that repository entry and set
@@ -310,16 +675,24 @@ get_picture_status(F_pic *pic, struct _pics *pics, char *file, bool force,
  * If not, read the file via the relevant reader and add to the repository
  * and set "existing" to False.
  * If "force" is true, read the file unconditionally.
+ * If "background" is true, formats that allow it are read in the
+ * background, and the picture is shown when it arrives.
+ * The bitmap should have at least decode_size pixels, see struct _pics;
+ * readers that can, i.e., read_jpg() and read_eps(), decode a smaller bitmap.
  */
-void
-read_picobj(F_pic *pic, char *file, int color, Boolean force, Boolean *existing)
+static void
+read_picture(F_pic *pic, char *file, int color, Boolean force,
+		Boolean *existing, bool background, F_pos decode_size)
 {
 	FILE		*fp;
 	int		i;
 	char		buf[16];
 	bool		reread;
-	struct _pics	*pics, *lastpic;
-	struct xfig_stream	pic_stream;
+	char		path[PATH_MAX];
+	struct _pics	*pics, *same;
+	struct stat	st;
+	struct xfig_stream	pic_stream, *stream;
+	struct pic_load	*load = NULL;
 
 	pic->color = color;
 	/* don't touch the flipped flag - caller has already set it */
@@ -338,37 +711,42 @@ read_picobj(F_pic *pic, char *file, int color, Boolean force, Boolean *existing)
 	app_flush();
 
 	/* look in the repository for this filename */
-	lastpic = pictures;
-	for (pics = pictures; pics; pics = pics->next) {
-		if (strcmp(pics->file, file) == 0) {
-			/* check, whether picture exists, or must be re-read */
-			if (get_picture_status(pic, pics, file, force, &reread,
-						(bool *)existing) ==FileInvalid)
-				return;
-			if (!reread && *existing) {
-				/* must set the h/w ratio here */
-				pic->hw_ratio =(float)pic->pic_cache->bit_size.y
-					/ pic->pic_cache->bit_size.x;
+	if ((pics = lookup_name(file)) != NULL) {
+		if (pics->load) {
+			if (!force) {
+				/* already being read, in the background;
+				   use that */
+				pic->pic_cache = pics;
+				pics->refcount++;
+				*existing = True;
 				return;
 			}
-			break;
+			cancel_picobj(pics);
 		}
-		/* keep pointer to last entry */
-		lastpic = pics;
-	}
-
-	if (pics == NULL) {
+		/* check, whether picture exists, or must be re-read */
+		if (get_picture_status(pic, pics, file, force, &reread,
+					(bool *)existing) == FileInvalid)
+			return;
+		if (!reread && *existing && !(pics->reduced &&
+					decode_size.x == 0)) {
+			/* must set the h/w ratio here */
+			pic->hw_ratio = (float)pic->pic_cache->bit_size.y
+				/ pic->pic_cache->bit_size.x;
+			return;
+		}
+		/* otherwise, the full-size bitmap is needed */
+	} else {
 		/* didn't find it in the repository, add it */
+		unsigned	h = hash_name(file);
+
 		pics = create_picture_entry();
-		if (lastpic) {
-			/* add to list */
-			lastpic->next = pics;
-			pics->prev = lastpic;
-		} else {
-			/* first one */
-			pictures = pics;
-		}
+		pics->next = pictures;
+		if (pictures)
+			pictures->prev = pics;
+		pictures = pics;
 		pics->file = strdup(file);
+		pics->hash_next = name_table[h];
+		name_table[h] = pics;
 		pics->refcount = 1;
 		pics->bitmap = NULL;
 		pics->subtype = T_PIC_NONE;
@@ -377,26 +755,67 @@ read_picobj(F_pic *pic, char *file, int color, Boolean force, Boolean *existing)
 		pics->size_y = 0;
 		pics->bit_size.x = 0;
 		pics->bit_size.y = 0;
+		*existing = False;
 		if (appres.DEBUG)
 			fprintf(stderr, "New picture %s\n", file);
 	}
 	/* put it in the pic */
 	pic->pic_cache = pics;
 	pic->pixmap = (Pixmap)0;
+	/* the reduced bitmaps belong to the old file contents */
+	free_picture_levels(pics);
+	pics->decode_size = decode_size;
+	/* the zoom may change while a thread reads the picture */
+	pics->decode_zoom = zoomscale;
+	pics->decode_limit = picture_size_limit;
+	pics->reduced = 0;
 
 	if (appres.DEBUG)
 		fprintf(stderr, "Reading file %s\n", file);
 
-	init_stream(&pic_stream);
+	/* a background read needs its own stream */
+	if (background && !update_figs && !preview_in_progress)
+		load = malloc(sizeof(struct pic_load));
+	stream = load ? &load->stream : &pic_stream;
+	init_stream(stream);
 
-	/* open the file and read a few bytes of the header to see what it is */
-	if ((fp = open_stream(file, &pic_stream)) == NULL) {
+	/* open the file and read a few bytes of the header to see what it is;
+	   the readers only see the absolute name */
+	if ((fp = open_stream(absolute_name(file, path, sizeof path), stream))
+			== NULL) {
 		file_msg("No such picture file: %s", file);
-		free_stream(&pic_stream);
+		free_stream(stream);
+		free(load);
 		return;
 	}
 	/* get the modified time and save it */
-	pics->time_stamp = file_timestamp(pic_stream.name_on_disk);
+	if (stat(stream->name_on_disk, &st) == 0) {
+		pics->time_stamp = st.st_mtime;
+		set_inode(pics, &st);
+		set_checked(pics);
+
+		/* the same file may have been read under another name */
+		if ((same = lookup_inode(pics, st.st_mtime)) != NULL) {
+			if (pics->bitmap != NULL) {
+				free(pics->bitmap);
+				pics->bitmap = NULL;
+			}
+			if (copy_picture(pics, same)) {
+				if (appres.DEBUG)
+					fprintf(stderr, "Picture %s is %s\n",
+							file, same->file);
+				pic->hw_ratio = (float)pics->bit_size.y /
+							pics->bit_size.x;
+				put_msg("Reading Picture object file...found cached picture");
+				close_stream(stream);
+				free_stream(stream);
+				free(load);
+				return;
+			}
+		}
+	} else {
+		pics->time_stamp = -1;
+	}
 
 	/* read some bytes from the file */
 	for (i = 0; i < (int)sizeof buf; ++i) {
@@ -416,26 +835,96 @@ read_picobj(F_pic *pic, char *file, int color, Boolean force, Boolean *existing)
 		file_msg("%s: Unknown image format", file);
 		put_msg("Reading Picture object file...Failed");
 		app_flush();
-		close_stream(&pic_stream);
-		free_stream(&pic_stream);
+		close_stream(stream);
+		free_stream(stream);
+		free(load);
+		return;
+	}
+
+	if (load && headers[i].background) {
+		/* the reader fills a copy of the repository entry */
+		load->pics = pics;
+		load->type = i;
+		load->pic = *pic;
+		load->cache = *pics;
+		load->cache.file = strdup(file);
+		load->cache.bitmap = NULL;
+		load->cache.prev = load->cache.next = NULL;
+		load->cache.load = NULL;
+		for (i = 0; i < PIC_LEVELS; ++i)
+			load->cache.level[i] = NULL;
+		load->pic.pic_cache = &load->cache;
+		pics->load = load;
+		background_job(read_in_background, picture_arrived, load);
 		return;
 	}
 
 	/* readfunc() expect an open file stream, positioned not at the
 	   start of the stream. The stream remains open after returning. */
-	if (headers[i].readfunc(pic, &pic_stream) != PicSuccess) {
+	if (pics->bitmap != NULL) {
+		free(pics->bitmap);
+		pics->bitmap = NULL;
+	}
+	if (headers[i].readfunc(pic, stream) != PicSuccess) {
 		file_msg("%s: Bad %s format", file, headers[i].type);
 	} else {
 		put_msg("Reading Picture object file...Done");
 	}
 
-	close_stream(&pic_stream);
-	free_stream(&pic_stream);
+	close_stream(stream);
+	free_stream(stream);
+	free(load);
+}
+
+void
+read_picobj(F_pic *pic, char *file, int color, Boolean force, Boolean *existing)
+{
+	F_pos	full = {0, 0};
+
+	read_picture(pic, file, color, force, existing, false, full);
+}
+
+/*
+ * Like read_picobj(), but read the usual bitmap formats in the background.
+ * Until the picture arrives, the picture object is drawn as an empty box.
+ * Jpeg pictures are decoded at about the size at which they are shown, DOS
+ * EPS pictures show their tiff preview, if that is large enough.
+ */
+void
+read_picobj_background(F_pic *pic, char *file, int color)
+{
+	Boolean	existing;
+	F_pos	shown = {-1, -1};
+
+	read_picture(pic, file, color, False, &existing, true, shown);
+}
+
+/*
+ * The bitmap of the picture in pic was decoded at a reduced size, see
+ * read_jpg() and read_eps(), and is now shown larger. Decode it again, with
+ * at least width x height pixels.
+ */
+void
+enlarge_picobj(F_pic *pic, int color, int width, int height)
+{
+	Boolean		existing;
+	F_pos		size;
+	struct _pics	*pics = pic->pic_cache;
+
+	if (pics == NULL || lookup_name(pics->file) != pics)
+		return;
+	if (appres.DEBUG)
+		fprintf(stderr, "Decode picture %s again for %dx%d pixels\n",
+				pics->file, width, height);
+	size.x = width;
+	size.y = height;
+	read_picture(pic, pics->file, color, True, &existing, false, size);
 }
 
 /*
  * Return a file stream, either to a pipe or to a regular file.
- * If xf_stream->uncompress[0] == '\0', it is a regular file, otherwise a pipe.
+ * If xf_stream->uncompress[0] == '\0', it is a regular file. Otherwise, the
+ * file is uncompressed in-process if possible, or else read from a pipe.
  */
 FILE *
 open_stream(char *restrict name, struct xfig_stream *restrict xf_stream)
@@ -462,6 +951,13 @@ open_stream(char *restrict name, struct xfig_stream *restrict xf_stream)
 		return NULL;
 	}
 
+	xf_stream->piped = False;
+	if (*xf_stream->uncompress && (xf_stream->fp =
+			open_uncompressed(xf_stream->name_on_disk)) != NULL) {
+		/* a compressed file, uncompressed in-process */
+		return xf_stream->fp;
+	}
+
 	if (*xf_stream->uncompress) {
 		/* a compressed file */
 		char	command_buf[256];
@@ -478,6 +974,7 @@ open_stream(char *restrict name, struct xfig_stream *restrict xf_stream)
 		sprintf(command, "%s '%s'",
 				xf_stream->uncompress, xf_stream->name_on_disk);
 		xf_stream->fp = popen(command, "r");
+		xf_stream->piped = True;
 		if (command != command_buf)
 			free(command);
 	} else {
@@ -497,8 +994,8 @@ close_stream(struct xfig_stream *restrict xf_stream)
 	if (xf_stream->fp == NULL)
 		return -1;
 
-	if (xf_stream->uncompress[0] == '\0') {
-		/* a regular file */
+	if (!xf_stream->piped) {
+		/* a regular file, or uncompressed in-process */
 		return fclose(xf_stream->fp);
 	} else {
 		/* a pipe */
@@ -518,8 +1015,8 @@ rewind_stream(struct xfig_stream *restrict xf_stream)
 	if (xf_stream->fp == NULL)
 		return NULL;
 
-	if (xf_stream->uncompress[0] == '\0') {
-		/* a regular file */
+	if (!xf_stream->piped) {
+		/* a regular file, or uncompressed in-process */
 		rewind(xf_stream->fp);
 		return xf_stream->fp;
 	} else  {
@@ -534,7 +1031,8 @@ rewind_stream(struct xfig_stream *restrict xf_stream)
 /*
  * Have xf_stream->content either point to a regular file containing the
  * uncompressed content of xf_stream->name, or to xf_stream->name_on_disk, if
- * name_on_disk is not compressed.
+ * name_on_disk is not compressed. Only for readers that need a file name,
+ * e.g., to pass to ghostscript; otherwise, see stream_content().
  * Use after a call to open_stream():
  *	struct xfig_stream	xf_stream;
  *	open_stream(name, &xf_stream);
@@ -584,6 +1082,18 @@ uncompressed_content(struct xfig_stream *restrict xf_stream)
 		return ret;
 	}
 
+	/* without the shell, if possible */
+	if (uncompress_to_fd(xf_stream->name_on_disk, fd) == 0) {
+		close(fd);
+		return 0;
+	}
+	if (ftruncate(fd, (off_t)0) || lseek(fd, (off_t)0, SEEK_SET)) {
+		file_msg("Could not truncate temporary file %s",
+				xf_stream->content);
+		close(fd);
+		return ret;
+	}
+
 	/*
 	 * One could already here redirect stdout to the fd of our tmp
 	 * file - but then, how to re-open stdout?
@@ -621,6 +1131,48 @@ uncompressed_content(struct xfig_stream *restrict xf_stream)
 	return ret;
 }
 
+/*
+ * Read the uncompressed content of xf_stream into memory, without a temporary
+ * file. Return the content, followed by a '\0', and its length in *len, or
+ * NULL on error. The caller must free() the content.
+ */
+char *
+stream_content(struct xfig_stream *restrict xf_stream, size_t *len)
+{
+	FILE	*fp;
+	char	*buf, *p;
+	size_t	size = 65536;
+	size_t	n = 0;
+	size_t	r;
+
+	if ((fp = rewind_stream(xf_stream)) == NULL)
+		return NULL;
+	if ((buf = malloc(size)) == NULL) {
+		file_msg("Out of memory.");
+		return NULL;
+	}
+	while ((r = fread(buf + n, 1, size - n - 1, fp)) > 0) {
+		n += r;
+		if (n == size - 1) {
+			if ((p = realloc(buf, 2 * size)) == NULL) {
+				file_msg("Out of memory.");
+				free(buf);
+				return NULL;
+			}
+			buf = p;
+			size *= 2;
+		}
+	}
+	if (ferror(fp)) {
+		file_msg("Could not read %s", xf_stream->name_on_disk);
+		free(buf);
+		return NULL;
+	}
+	buf[n] = '\0';
+	*len = n;
+	return buf;
+}
+
 /*
  * Compute the image dimension (size_x, size_y) in Fig-units from the number of
  * pixels and the resolution in x- and y-direction, pixels_x, pixels_y, and
@@ -661,3 +1213,40 @@ image_size(int *size_x, int *size_y, int pixels_x, int pixels_y,
 		*size_y = pixels_y * PIC_FACTOR * res_x / res_y + 0.5;
 	}
 }
+
+/*
+ * Return in want_x and want_y the number of pixels wanted for the bitmap of
+ * the picture repository entry pics, see decode_size in struct _pics. The
+ * picture measures size_x x size_y Fig units. Return 0 for the full size.
+ */
+void
+wanted_size(struct _pics *pics, int size_x, int size_y, int *want_x,
+		int *want_y)
+{
+	*want_x = pics->decode_size.x;
+	*want_y = pics->decode_size.y;
+
+	if (*want_x == 0 || *want_y == 0) {
+		*want_x = *want_y = 0;
+		return;
+	}
+	if (*want_x > 0 && *want_y > 0)
+		return;
+
+	/* the size shown at the zoom when reading was started */
+	*want_x = (int)(size_x * pics->decode_zoom) + 1;
+	*want_y = (int)(size_y * pics->decode_zoom) + 1;
+	/* shrink to the limit, keeping the aspect ratio */
+	if (pics->decode_limit > 0 && (*want_x > pics->decode_limit ||
+				*want_y > pics->decode_limit)) {
+		if (*want_x >= *want_y) {
+			*want_y = (int)((double)*want_y *
+					pics->decode_limit / *want_x) + 1;
+			*want_x = pics->decode_limit;
+		} else {
+			*want_x = (int)((double)*want_x *
+					pics->decode_limit / *want_y) + 1;
+			*want_y = pics->decode_limit;
+		}
+	}
+}
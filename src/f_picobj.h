@@ -41,6 +41,9 @@ struct xfig_stream {
 				   uncompressed content of name */
 	const char *uncompress;	/* e.g., "gunzip -c", "", or NULL
 				   NULL if compression status is undecided */
+	Boolean	piped;		/* fp is a pipe from uncompress, otherwise
+				   uncompressed in-process, see
+				   open_uncompressed() */
 	char	name_buf[128];
 	char	name_on_disk_buf[128];
 	char	content_buf[128];
@@ -49,14 +52,23 @@ struct xfig_stream {
 
 extern void	read_picobj(F_pic *pic, char *file, int color, Boolean force,
 				Boolean *existing);
+extern void	read_picobj_background(F_pic *pic, char *file, int color);
+extern void	enlarge_picobj(F_pic *pic, int color, int width, int height);
+extern void	cancel_picobj(struct _pics *pics);
+extern void	remove_picobj(struct _pics *pics);
+extern int	picture_size_limit;
 extern void	image_size(int *size_x, int *size_y, int pixels_x, int pixels_y,
 				char unit, float res_x, float res_y);
+extern void	wanted_size(struct _pics *pics, int size_x, int size_y,
+				int *want_x, int *want_y);
 
 extern FILE	*open_stream(char *restrict name,
 				struct xfig_stream *restrict xf_stream);
 extern int	close_stream(struct xfig_stream *restrict xf_stream);
 extern FILE	*rewind_stream(struct xfig_stream *restrict xf_stream);
 extern int	uncompressed_content(struct xfig_stream *restrict xf_stream);
+extern char	*stream_content(struct xfig_stream *restrict xf_stream,
+				size_t *len);
 extern void	free_stream(struct xfig_stream *restrict xf_stream);
 
 #endif
@@ -218,9 +218,7 @@ read_fig(char *file_name, F_compound *obj, Boolean merge, int xoff, int yoff, fi
 
     read_file_name = file_name;
     first_file_msg = True;
-    if (uncompress_file(file_name) == False)
-	return ENOENT;		/* doesn't exist */
-    if ((fp = fopen(file_name, "r")) == NULL)
+    if ((fp = open_file_uncompressed(file_name)) == NULL)
 	return errno;
     else {
 	if (!update_figs)
@@ -898,7 +896,6 @@ read_lineobject(FILE *fp)
     float	    thickness, wd, ht;
     int		    ox, oy;
     char	    picfile[PATH_MAX];
-    Boolean	    dum;
 
     if ((l = create_line()) == NULL){
 	numcom=0;
@@ -1012,7 +1009,7 @@ read_lineobject(FILE *fp)
 
 	if (!update_figs) {
 	    /* only read in the image if update_figs is False */
-	    read_picobj(l->pic, picfile, l->pen_color, False, &dum);
+	    read_picobj_background(l->pic, picfile, l->pen_color);
 	} else {
 	    /* otherwise just make a pseudo entry with the filename */
 	    l->pic->pic_cache = create_picture_entry();
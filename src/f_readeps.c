@@ -26,33 +26,61 @@
 #endif
 
 #include <ctype.h>
+#include <limits.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#ifdef I18N
-#include <locale.h>
-#endif
 #include <X11/Xlib.h>
 
 #include "resources.h"
 #include "object.h"
 #include "f_picobj.h"
+#include "f_util.h"		/* strtod_c() */
+#include "u_ghostscript.h"	/* gs_mediabox(), gs_bitmap() */
+#include "u_threads.h"		/* in_main_thread() */
 #include "w_msgpanel.h"
 #include "w_setup.h"
 #include "w_util.h"
 #include "xfig_math.h"
 
-/* u_ghostscript.c */
-extern int	gs_mediabox(char *file, int *llx, int *lly, int *urx, int *ury);
-extern int	gs_bitmap(char *file, F_pic *pic, int llx, int lly,
-						int urx, int ury);
+#ifdef HAVE_TIFF
+/* f_readtif.c */
+extern int	read_tif_part(F_pic *pic, const char *name, long offset,
+						long length);
+#endif
+
+/*
+ * A DOS EPS file starts with a binary header of 30 bytes: The bytes C5 D0 D3
+ * C6, followed by the offset and length of the PostScript section, of a
+ * Windows metafile and of a tiff preview, each a four-byte little-endian
+ * number, and a checksum.
+ */
+#define DOSEPS_HEADER	30
 
 static void	lower(char *buf);
 static int	hex(char c);
 
 
+/*
+ * Read four numbers from s into bb. Return 0 on success, -1 on failure.
+ */
+static int
+scan_box(char *s, double bb[4])
+{
+	int	i;
+	char	*end;
+
+	for (i = 0; i < 4; ++i) {
+		bb[i] = strtod_c(s, &end);
+		if (end == s)
+			return -1;
+		s = end;
+	}
+	return 0;
+}
+
 /*
  * Scan a pdf-file for a /MediaBox specification.
  * Return 0 on success, -1 on failure.
@@ -68,7 +96,7 @@ scan_mediabox(char *name, int *llx, int *lly, int *urx, int *ury)
 	char	buf[512];
 	char	*s;
 	int	ret = -1;	/* prime with failure */
-	double	lx, ly, ux, uy;
+	double	bb[4];
 	FILE	*file;
 
 	if ((file = fopen(name, "rb")) == NULL)
@@ -77,12 +105,11 @@ scan_mediabox(char *name, int *llx, int *lly, int *urx, int *ury)
 	while (fgets(buf, sizeof buf, file) != NULL) {
 		if ((s = strstr(buf, "/MediaBox"))) {
 			s = strchr(s, '[');
-			if (s && sscanf(s + 1, "%lf %lf %lf %lf",
-						&lx, &ly, &ux, &uy) == 4) {
-				*llx = (int)floor(lx);
-				*lly = (int)floor(ly);
-				*urx = (int)ceil(ux);
-				*ury = (int)ceil(uy);
+			if (s && scan_box(s + 1, bb) == 0) {
+				*llx = (int)floor(bb[0]);
+				*lly = (int)floor(bb[1]);
+				*urx = (int)ceil(bb[2]);
+				*ury = (int)ceil(bb[3]);
 				ret = 0;
 			}
 			/* do not search for a second occurrence of /MediaBox */
@@ -110,7 +137,8 @@ correct_boundingbox(int *llx, int *lly, int *urx, int *ury, const char *box) {
 	*ury = paper_sizes[appres.papersize].height * 72 / PIX_PER_INCH;
 	file_msg("Bad %s, assuming %s size", box,
 			paper_sizes[appres.papersize].sname);
-	app_flush();
+	if (in_main_thread())
+		app_flush();
 }
 
 
@@ -121,7 +149,6 @@ correct_boundingbox(int *llx, int *lly, int *urx, int *ury, const char *box) {
 int
 read_pdf(F_pic *pic, struct xfig_stream *restrict pic_stream)
 {
-	char	*savelocale;
 	/* prime with an invalid bounding box */
 	int	llx = 0, lly = 0, urx = 0, ury = 0;
 
@@ -130,24 +157,11 @@ read_pdf(F_pic *pic, struct xfig_stream *restrict pic_stream)
 
 	/*
 	 * Find the /MediaBox. First, do a simple text-scan for "/MediaBox",
-	 * failing that, call ghostscript. Both scan_mediabox() and
-	 * gs_mediabox() need the C or POSIX locale. Do not reset the locale to
-	 * the environment, because read_pdf might be called from readfp_fig(),
-	 * which temporarily sets and needs the C locale.
+	 * failing that, call ghostscript. Both read numbers with strtod_c(),
+	 * independent of the locale; read_pdf() may run in a worker thread.
 	 */
-#ifdef I18N
-	savelocale = setlocale(LC_NUMERIC, NULL);
-	if (strcmp(savelocale, "C") && strcmp(savelocale, "POSIX"))
-		setlocale(LC_NUMERIC, "C");
-	else
-		savelocale = "";
-#endif
 	if (scan_mediabox(pic_stream->content, &llx, &lly, &urx, &ury))
 		gs_mediabox(pic_stream->content, &llx, &lly, &urx, &ury);
-#ifdef I18N
-	if (*savelocale)
-		setlocale(LC_NUMERIC, savelocale);
-#endif
 
 	/* provide A4 or Letter bounding box, if reading /MediaBox fails */
 	correct_boundingbox(&llx, &lly, &urx, &ury, "/MediaBox");
@@ -172,6 +186,66 @@ read_pdf(F_pic *pic, struct xfig_stream *restrict pic_stream)
 }
 
 
+/*
+ * Return the four-byte little-endian number at p.
+ */
+static long
+le32(const unsigned char *p)
+{
+	return (long)((unsigned long)p[0] | (unsigned long)p[1] << 8 |
+			(unsigned long)p[2] << 16 | (unsigned long)p[3] << 24);
+}
+
+/*
+ * Like fgets(), but read no further than *left more bytes, and count the
+ * bytes read off *left. Used to stay within the PostScript section of a DOS
+ * EPS file.
+ */
+static char *
+gets_section(char *buf, int size, FILE *fp, long *left)
+{
+	size_t	len;
+
+	if (*left <= 0 || fgets(buf, size, fp) == NULL)
+		return NULL;
+	len = strlen(buf);
+	if ((long)len > *left) {
+		len = (size_t)*left;
+		buf[len] = '\0';
+	}
+	*left -= (long)len;
+	return buf;
+}
+
+#ifdef HAVE_TIFF
+/*
+ * Read the tiff preview of a DOS EPS file, but keep the size of the picture
+ * given by the bounding box. Return codes as for read_tif().
+ */
+static int
+read_tif_preview(F_pic *pic, char *file, long offset, long length)
+{
+	int	size_x = pic->pic_cache->size_x;
+	int	size_y = pic->pic_cache->size_y;
+	float	hw_ratio = pic->hw_ratio;
+
+	if (read_tif_part(pic, file, offset, length) != PicSuccess) {
+		/* read_tif_part() may have freed the bitmap */
+		pic->pic_cache->bitmap = NULL;
+		return FileInvalid;
+	}
+	if (appres.DEBUG)
+		fprintf(stderr, "Read tiff preview of EPS file, %d x %d.\n",
+				pic->pic_cache->bit_size.x,
+				pic->pic_cache->bit_size.y);
+	pic->pic_cache->subtype = T_PIC_EPS;
+	pic->pic_cache->size_x = size_x;
+	pic->pic_cache->size_y = size_y;
+	pic->hw_ratio = hw_ratio;
+	return PicSuccess;
+}
+#endif
+
 /*
  * Read an EPS file.
  * Return codes:	PicSuccess (1): success
@@ -182,41 +256,72 @@ read_eps(F_pic *pic, struct xfig_stream *restrict pic_stream)
 {
 	bool		bitmapz;
 	bool		flag;
+	bool		content = false;	/* pic_stream->content is set */
 	int		llx, lly, urx, ury;
 	int		nested;
 	char		*cp;
 	unsigned char	*mp;
 	unsigned int	hexnib;
 	unsigned char	*last;
+	unsigned char	head[DOSEPS_HEADER];
 	char		buf[300];
 	size_t		nbitmap;
+	long		n;
+	long		ps_offset;
+	long		ps_left = LONG_MAX;	/* bytes left in the section */
+	long		tif_offset = 0;
+	long		tif_length = 0;
 
 	if (!rewind_stream(pic_stream))
 		return FileInvalid;
 
+	/* a DOS EPS file, skip to the PostScript section */
+	if (fread(head, 1, sizeof head, pic_stream->fp) == sizeof head &&
+			!memcmp(head, "\305\320\323\306", 4)) {
+		ps_offset = le32(head + 4);
+		ps_left = le32(head + 8);
+		tif_offset = le32(head + 20);
+		tif_length = le32(head + 24);
+		if (ps_offset < DOSEPS_HEADER || ps_left <= 0) {
+			file_msg("Bad DOS EPS header: %s", pic->pic_cache->file);
+			return FileInvalid;
+		}
+		for (n = DOSEPS_HEADER; n < ps_offset; ++n)
+			if (getc(pic_stream->fp) == EOF)
+				return FileInvalid;
+		if (appres.DEBUG)
+			fprintf(stderr, "DOS EPS file, PostScript at %ld, tiff "
+					"preview at %ld.\n", ps_offset,
+					tif_length > 0 ? tif_offset : 0L);
+		/* the tiff preview is read from a regular file */
+		if (tif_length > 0 && !uncompressed_content(pic_stream))
+			content = true;
+	} else if (!rewind_stream(pic_stream)) {
+		return FileInvalid;
+	}
+
 	/* invalid bounding box */
 	llx = lly = urx = ury = 0;
 
 	/* scan for the bounding box */
 	nested = 0;
-	while (fgets(buf, sizeof buf, pic_stream->fp) != NULL) {
+	while (gets_section(buf, sizeof buf, pic_stream->fp, &ps_left) != NULL) {
 		if (!nested && !strncmp(buf, "%%BoundingBox:", 14)) {
 			/* make sure doesn't say (atend) */
 			if (!strstr(buf, "(atend)")) {
-				float       rllx, rlly, rurx, rury;
+				double	bb[4];
 
-				if (sscanf(strchr(buf, ':') + 1, "%f %f %f %f",
-						&rllx,&rlly,&rurx,&rury) < 4) {
+				if (scan_box(strchr(buf, ':') + 1, bb)) {
 					file_msg("Bad EPS file: %s",
 							/* name might be a
 							   temporary file */
 							pic->pic_cache->file);
 					return FileInvalid;
 				}
-				llx = floor(rllx);
-				lly = floor(rlly);
-				urx = ceil(rurx);
-				ury = ceil(rury);
+				llx = floor(bb[0]);
+				lly = floor(bb[1]);
+				urx = ceil(bb[2]);
+				ury = ceil(bb[3]);
 				if (appres.DEBUG)
 					fputs("Found EPS Bounding Box\n",
 							stderr);
@@ -237,6 +342,38 @@ read_eps(F_pic *pic, struct xfig_stream *restrict pic_stream)
 	pic->pic_cache->subtype = T_PIC_EPS;
 	pic->pic_cache->size_x = round((urx - llx) * PIC_FACTOR);
 	pic->pic_cache->size_y = round((ury - lly) * PIC_FACTOR);
+
+#ifdef HAVE_TIFF
+	/*
+	 * Use the tiff preview of a DOS EPS file instead of ghostscript, if the
+	 * picture is not shown larger than the preview. Mark the bitmap as
+	 * reduced, to render it with ghostscript when it is shown larger, see
+	 * enlarge_picobj(). As with jpeg pictures, only on a TrueColor visual;
+	 * otherwise, the rendered bitmap would need its colors remapped.
+	 */
+	if (content && appres.eps_preview) {
+		int	want_x, want_y;
+
+		wanted_size(pic->pic_cache, pic->pic_cache->size_x,
+				pic->pic_cache->size_y, &want_x, &want_y);
+		if (want_x > 0 && want_y > 0 && read_tif_preview(pic,
+					pic_stream->content, tif_offset,
+					tif_length) == PicSuccess) {
+			if (want_x <= pic->pic_cache->bit_size.x &&
+					want_y <= pic->pic_cache->bit_size.y) {
+				if (tool_vclass == TrueColor &&
+						image_bpp == 4 &&
+						!appres.monochrome)
+					pic->pic_cache->reduced = 1;
+				return PicSuccess;
+			}
+			/* too small, render with ghostscript */
+			free(pic->pic_cache->bitmap);
+			pic->pic_cache->bitmap = NULL;
+		}
+	}
+#endif
+
 	/* make 2-entry colormap here if we use monochrome */
 	pic->pic_cache->cmap[0].red = pic->pic_cache->cmap[0].green =
 		pic->pic_cache->cmap[0].blue = 0;
@@ -247,7 +384,7 @@ read_eps(F_pic *pic, struct xfig_stream *restrict pic_stream)
 
 	/* look for a preview bitmap */
 	bitmapz = False;
-	while (fgets(buf, sizeof buf, pic_stream->fp) != NULL) {
+	while (gets_section(buf, sizeof buf, pic_stream->fp, &ps_left) != NULL) {
 		lower(buf);
 		if (!strncmp(buf, "%%beginpreview", 14)) {
 			sscanf(buf, "%%%%beginpreview: %d %d %*d",
@@ -260,12 +397,21 @@ read_eps(F_pic *pic, struct xfig_stream *restrict pic_stream)
 		}
 	}
 
-	/* use ghostscript, if a preview bitmap does not exist */
-	if (!bitmapz && !uncompressed_content(pic_stream) && !gs_bitmap(
-				pic_stream->content, pic, llx, lly, urx, ury)) {
+	/* use ghostscript, if a preview bitmap does not exist; ghostscript
+	   itself skips the binary header of a DOS EPS file */
+	if (!bitmapz && (content || !uncompressed_content(pic_stream)) &&
+			!gs_bitmap(pic_stream->content, pic, llx, lly, urx,
+				ury)) {
 		return PicSuccess;
 	}
 
+#ifdef HAVE_TIFF
+	/* without ghostscript, show the tiff preview at any size */
+	if (!bitmapz && content && read_tif_preview(pic, pic_stream->content,
+				tif_offset, tif_length) == PicSuccess)
+		return PicSuccess;
+#endif
+
 	if (!bitmapz) {
 		file_msg("EPS object read OK, but no preview bitmap "
 				"found/generated");
@@ -296,7 +442,8 @@ read_eps(F_pic *pic, struct xfig_stream *restrict pic_stream)
 	memset(mp, 0, nbitmap);
 	last = pic->pic_cache->bitmap + nbitmap;
 	flag = true;
-	while (fgets(buf, sizeof buf, pic_stream->fp) != NULL && mp < last) {
+	while (gets_section(buf, sizeof buf, pic_stream->fp, &ps_left) != NULL &&
+			mp < last) {
 		lower(buf);
 		if (!strncmp(buf, "%%endpreview", 12) ||
 				!strncmp(buf, "%%endimage", 10))
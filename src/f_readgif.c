@@ -37,306 +37,179 @@
 
 #include <X11/Intrinsic.h>	/* Boolean */
 #include <X11/Xlib.h>		/* True, False */
-#include <errno.h>
 #include <stdio.h>
-#include <stdlib.h>		/* mkstemp */
-#include <string.h>		/* mkstemp */
-#include <unistd.h>		/* close, unlink */
+#include <stdlib.h>
+#include <string.h>
 
-#include "resources.h"		/* PATH_MAX */
+#include "resources.h"
 #include "object.h"
 #include "f_picobj.h"
-#include "f_readpcx.h"
+#include "f_util.h"		/* map_to_mono() */
 #include "w_msgpanel.h"
+#include "w_setup.h"		/* PIX_PER_INCH, PIX_PER_CM */
 
 
-static Boolean	ReadColorMap(FILE *fd, unsigned int number, struct Cmap *cmap);
-static Boolean	DoGIFextension(FILE *fd, int label);
-static int	GetDataBlock(FILE *fd, unsigned char *buf);
-
+/*
+ * The decoder keeps its state on the stack, so that gif files can be read
+ * in a worker thread.
+ */
 #define LOCALCOLORMAP		0x80
+#define INTERLACE		0x40
+#define MAX_LZW_BITS		12
 #define	ReadOK(file,buffer,len)	\
 	    (fread((void *)buffer, (size_t)len, (size_t)1, (FILE *)file) != 0)
 #define BitSet(byte, bit)	(((byte) & (bit)) == (bit))
 
 #define LM_to_uint(a,b)		(((b)<<8)|(a))
 
-struct {
-	unsigned int	Width;
-	unsigned int	Height;
-	struct	 Cmap	ColorMap[MAX_COLORMAP_SIZE];
-	unsigned int	BitPixel;
-	unsigned int	ColorResolution;
-	unsigned int	Background;
-	unsigned int	AspectRatio;
-} GifScreen;
-
-struct {
-	int	transparent;
-	int	delayTime;
-	int	inputFlag;
-	int	disposal;
-} Gif89 = { -1, -1, -1, 0 };
+/* the bit stream of LZW codes, packed into data blocks */
+struct lzw_stream {
+	FILE		*fp;
+	unsigned long	bits;		/* bits not yet consumed */
+	int		nbits;		/* number of bits in bits */
+	int		len;		/* length of the current data block */
+	int		pos;		/* position in the current data block */
+	Boolean		end;		/* the block terminator was read */
+	unsigned char	block[256];
+};
+
+static Boolean	ReadColorMap(FILE *fd, unsigned int number, struct Cmap *cmap);
+static Boolean	DoGIFextension(FILE *fd, int label, int *transparent);
+static int	GetDataBlock(FILE *fd, unsigned char *buf);
+static Boolean	ReadImage(FILE *fd, unsigned char *image, unsigned int width,
+			unsigned int height, Boolean interlaced);
 
 /* return codes:  PicSuccess (1) : success
 		  FileInvalid (-2) : invalid file
 */
 
-
-
 int
 read_gif(F_pic *pic, struct xfig_stream *restrict pic_stream)
 {
-	char		buf[BUFSIZ];
-	const char 	pcxname_fmt[] = "%s/xfig-pcx.XXXXXX";
-	char		pcxname_buf[128];
-	char		*pcxname = pcxname_buf;
-	char		*cmd_fmt;
-	char		*cmd = buf;
-	FILE		*giftopcx;
-	struct Cmap	localColorMap[MAX_COLORMAP_SIZE];
-	int		i, stat, fd;
-	int		useGlobalColormap;
-	unsigned int	bitPixel, red, green, blue;
+	/* make scale factor smaller for metric */
+	const double scale =
+		(appres.INCHES ? (double)PIX_PER_INCH : 2.54*PIX_PER_CM)
+		/ DISPLAY_PIX_PER_INCH;
+	unsigned char	buf[16];
+	struct Cmap	globalColorMap[MAX_COLORMAP_SIZE];
+	struct Cmap	*cmap;
+	unsigned char	*image;
+	unsigned int	width, height, bitPixel, globalBitPixel = 0;
+	unsigned int	i;
+	int		transparent = TRANSP_NONE;
 	unsigned char	c;
-	char		version[4];
-	size_t		size;
-	struct xfig_stream	pcx;
 
 	if (!rewind_stream(pic_stream))
 		return FileInvalid;
 
-	/* command string to convert gif to pcx */
-	if (!system("{ giftopnm -version && ppmtopcx -version; } 2>/dev/null"))
-		cmd_fmt = "giftopnm -quiet | ppmtopcx -quiet >'%s'";
-	else if (!system("convert -version >/dev/null"))
-		cmd_fmt = "convert - pcx:'%s'";
-	else if (!system("gm -version >/dev/null"))
-		cmd_fmt = "gm convert - pcx:'%s'";
-	else {
-		file_msg("Cannot read gif files.");
-		file_msg("To read gif files, install either the netpbm, or the "
-				"imagemagick, or the graphicsmagick package.");
+	/* read the header */
+	if (!ReadOK(pic_stream->fp, buf, 6))
 		return FileInvalid;
-	}
 
-	/* first read header to look for any transparent color extension */
-	if (!ReadOK(pic_stream->fp, buf, 6)) {
+	if (strncmp((char *)buf, "GIF", 3) != 0)
 		return FileInvalid;
-	}
 
-	if (strncmp((char*)buf, "GIF", 3) != 0) {
+	if (strncmp((char *)buf + 3, "87a", 3) != 0 &&
+			strncmp((char *)buf + 3, "89a", 3) != 0) {
+		buf[6] = '\0';
+		file_msg("Unknown GIF version %s", (char *)buf + 3);
 		return FileInvalid;
 	}
 
-	strncpy(version, (char*)(buf + 3), 3);
-	version[3] = '\0';
-
-	if ((strcmp(version, "87a") != 0) && (strcmp(version, "89a") != 0)) {
-		file_msg("Unknown GIF version %s", version);
-		return FileInvalid;
-	}
-
-	if (!ReadOK(pic_stream->fp, buf, 7)) {
+	if (!ReadOK(pic_stream->fp, buf, 7))
 		return FileInvalid;	/* failed to read screen descriptor */
-	}
-
-	GifScreen.Width           = LM_to_uint(buf[0],buf[1]);
-	GifScreen.Height          = LM_to_uint(buf[2],buf[3]);
-	GifScreen.BitPixel        = 2<<(buf[4]&0x07);
-	GifScreen.ColorResolution = (((((int)buf[4])&0x70)>>3)+1);
-	GifScreen.Background      = (unsigned int) buf[5];
-	GifScreen.AspectRatio     = (unsigned int) buf[6];
 
 	if (BitSet(buf[4], LOCALCOLORMAP)) {	/* Global Colormap */
-		if (!ReadColorMap(pic_stream->fp, GifScreen.BitPixel,
-					GifScreen.ColorMap)) {
+		globalBitPixel = 2<<(buf[4]&0x07);
+		if (!ReadColorMap(pic_stream->fp, globalBitPixel,
+					globalColorMap))
 			return FileInvalid;  /* error reading global colormap */
-		}
 	}
 
-	if (GifScreen.AspectRatio != 0 && GifScreen.AspectRatio != 49) {
+	if (buf[6] != 0 && buf[6] != 49) {
 		if (appres.DEBUG)
 			fprintf(stderr, "warning - non-square pixels\n");
 	}
 
-	/* assume no transparent color for now */
-	Gif89.transparent = TRANSP_NONE;
-
-	/* read the full header to get any transparency information */
+	/* read up to the first image, to get any transparency information */
 	for (;;) {
-		if (!ReadOK(pic_stream->fp, &c, 1)) {
+		if (!ReadOK(pic_stream->fp, &c, 1))
 			return FileInvalid;	/* EOF / read error on image data */
-		}
 
-		if (c == ';') {			/* GIF terminator, finish up */
-			return PicSuccess;	/* all done */
+		if (c == ';') {			/* GIF terminator, no image */
+			file_msg("No image in GIF file");
+			return FileInvalid;
 		}
 
 		if (c == '!') {			/* Extension */
 			if (!ReadOK(pic_stream->fp, &c, 1))
 				file_msg("GIF read error on extension function code");
-			(void)DoGIFextension(pic_stream->fp, c);
+			(void)DoGIFextension(pic_stream->fp, c, &transparent);
 			continue;
 		}
 
-		if (c != ',') {			/* Not a valid start character*/
-			continue;
-		}
-
-		if (!ReadOK(pic_stream->fp, buf, 9)) {
-			/* couldn't read left/top/width/height */
-			return FileInvalid;
-		}
-
-		useGlobalColormap = !BitSet(buf[8], LOCALCOLORMAP);
-
-		bitPixel = 1<<((buf[8]&0x07)+1);
-
-		if (!useGlobalColormap) {
-			if (!ReadColorMap(pic_stream->fp, bitPixel,
-						localColorMap)) {
-				file_msg("error reading local GIF colormap" );
-				return PicSuccess;
-			}
-		}
-		break;			/* image starts here, header is done */
-	}
-
-	/* save transparent indicator */
-	pic->pic_cache->transp = Gif89.transparent;
-
-	/* now call giftopnm and ppmtopcx */
-
-	/* make name for temp output file */
-	size = sizeof pcxname_fmt + strlen(TMPDIR) - 2;
-	if (size > sizeof pcxname_buf && (pcxname = malloc(size)) == NULL) {
-		file_msg("Out of memory.");
-		return FileInvalid;
-	}
-	if (sprintf(pcxname, pcxname_fmt, TMPDIR) < 0) {
-		i = errno;
-		file_msg("Unable to write temporary file path to string");
-		file_msg("Error: %s", strerror(i));
-		if (pcxname != pcxname_buf)
-			free(pcxname);
-		return FileInvalid;
-	}
-	if ((fd = mkstemp(pcxname)) == -1) {
-		file_msg("Cannot create temporary file\n");
-		if (pcxname != pcxname_buf)
-			free(pcxname);
-		return FileInvalid;
+		if (c == ',')			/* image starts here */
+			break;
+		/* Not a valid start character, skip it */
 	}
-	close(fd);
 
-	/* make command to convert gif to pcx */
-	size += strlen(cmd_fmt) - 2;	/* from above, size == sizeof pcxname */
-	if (size > sizeof buf && (cmd = malloc(size)) == NULL) {
-		file_msg("Out of memory.");
-		unlink(pcxname);
-		if (pcxname != pcxname_buf)
-			free(pcxname);
+	/* left, top, width, height, flags */
+	if (!ReadOK(pic_stream->fp, buf, 9))
 		return FileInvalid;
-	}
-	if (sprintf(cmd, cmd_fmt, pcxname) < 0) {
-		i = errno;
-		file_msg("Cannot write command to convert gif to pcx.");
-		file_msg("Error: %s", strerror(i));
-		unlink(pcxname);
-		if (pcxname != pcxname_buf)
-			free(pcxname);
+	width = LM_to_uint(buf[4], buf[5]);
+	height = LM_to_uint(buf[6], buf[7]);
+	if (width == 0 || height == 0) {
+		file_msg("Empty GIF image");
 		return FileInvalid;
 	}
 
-	giftopcx = popen(cmd, "w");
-	if (giftopcx == NULL) {
-		i = errno;
-		file_msg("Cannot open pipe to convert gif to pcx\n");
-		file_msg("Command: %s", cmd);
-		file_msg("Error: %s", strerror(i));
-		if (cmd != buf)
-			free(cmd);
-		unlink(pcxname);
-		if (pcxname != pcxname_buf)
-			free(pcxname);
-		return FileInvalid;
+	cmap = pic->pic_cache->cmap;
+	if (BitSet(buf[8], LOCALCOLORMAP)) {
+		bitPixel = 1<<((buf[8]&0x07)+1);
+		if (!ReadColorMap(pic_stream->fp, bitPixel, cmap)) {
+			file_msg("error reading local GIF colormap" );
+			return FileInvalid;
+		}
+	} else if (globalBitPixel) {
+		bitPixel = globalBitPixel;
+		memcpy(cmap, globalColorMap, bitPixel * sizeof(struct Cmap));
+	} else {
+		/* no colormap at all, use a gray ramp */
+		bitPixel = MAX_COLORMAP_SIZE;
+		for (i = 0; i < bitPixel; ++i)
+			cmap[i].red = cmap[i].green = cmap[i].blue = i;
 	}
 
-	/* write the temporary pcx file */
-	rewind_stream(pic_stream);
-	while ((size = fread(buf, 1, sizeof buf, pic_stream->fp)) != 0)
-		fwrite(buf, size, 1, giftopcx);
-
-	if (pclose(giftopcx)) {
-		i = errno; 
-		file_msg("Cannot convert gif to pcx\n");
-		file_msg("Command: %s", cmd);
-		file_msg("Error: %s", strerror(i));
-		if (cmd != buf)
-			free(cmd);
-		unlink(pcxname);
-		if (pcxname != pcxname_buf)
-			free(pcxname);
+	if ((image = calloc((size_t)width * height, (size_t)1)) == NULL) {
+		file_msg("Out of memory.");
 		return FileInvalid;
 	}
-
-	if (cmd != buf)
-		free(cmd);
-
-	/*
-	 * Construct a rudimentary struct xfig_stream that can be passed to
-	 * read_pcx(). Tell read_pcx() that the FILE pointer is positioned at
-	 * the start (*name == '\0') and that it is a regular file
-	 * (*uncompress == '\0').
-	 * ATTENTION, requires knowledge of fields of struct xfig_stream.
-	 */
-	pcx.name_buf[0] = '\0';
-	pcx.name = pcx.name_buf;
-	pcx.uncompress = pcx.name_buf;
-
-	if ((pcx.fp = fopen(pcxname, "rb")) == NULL) {
-		file_msg("Cannot open temporary output file\n");
-		perror("Error");
-		unlink(pcxname);
-		if (pcxname != pcxname_buf)
-			free(pcxname);
+	if (!ReadImage(pic_stream->fp, image, width, height,
+				BitSet(buf[8], INTERLACE))) {
+		free(image);
 		return FileInvalid;
 	}
-
-	/* now call read_pcx to read the pcx file */
-	stat = read_pcx(pic, &pcx);
-
-	/* remove temp file */
-	fclose(pcx.fp);
-	unlink(pcxname);
-	if (pcxname != pcxname_buf)
-		free(pcxname);
-
+	/* indices beyond the colormap, from a corrupt file */
+	for (i = 0; i < width * height; ++i)
+		if (image[i] >= bitPixel)
+			image[i] = 0;
+
+	pic->pic_cache->bitmap = image;
+	pic->pic_cache->numcols = (int)bitPixel;
+	pic->pic_cache->transp = transparent < (int)bitPixel ?
+						transparent : TRANSP_NONE;
+	pic->pic_cache->bit_size.x = width;
+	pic->pic_cache->bit_size.y = height;
+	pic->pic_cache->size_x = width * scale;
+	pic->pic_cache->size_y = height * scale;
 	pic->pic_cache->subtype = T_PIC_GIF;
-	/* now match original transparent colortable index with possibly new
-	   colortable from ppmtopcx */
-	if (pic->pic_cache->transp != TRANSP_NONE) {
-	    if (useGlobalColormap) {
-		red = GifScreen.ColorMap[pic->pic_cache->transp].red;
-		green = GifScreen.ColorMap[pic->pic_cache->transp].green;
-		blue = GifScreen.ColorMap[pic->pic_cache->transp].blue;
-	    } else {
-		red = localColorMap[pic->pic_cache->transp].red;
-		green = localColorMap[pic->pic_cache->transp].green;
-		blue = localColorMap[pic->pic_cache->transp].blue;
-	    }
-	    for (i = 0; i < pic->pic_cache->numcols; ++i) {
-		if (pic->pic_cache->cmap[i].red == red &&
-		    pic->pic_cache->cmap[i].green == green &&
-		    pic->pic_cache->cmap[i].blue == blue)
-			break;
-	    }
-	    if (i < pic->pic_cache->numcols)
-		pic->pic_cache->transp = i;
-	}
+	pic->pixmap = None;
+	pic->hw_ratio = (float)height / width;
+	/* if monochrome display map bitmap */
+	if (tool_cells <= 2 || appres.monochrome)
+		map_to_mono(pic);
 
-	return stat;
+	return PicSuccess;
 }
 
 static Boolean
@@ -358,10 +231,10 @@ ReadColorMap(FILE *fd, unsigned int number, struct Cmap *cmap)
 }
 
 static Boolean
-DoGIFextension(FILE *fd, int label)
+DoGIFextension(FILE *fd, int label, int *transparent)
 {
-	static unsigned char buf[256];
-	char	    *str;
+	unsigned char	buf[256];
+	char		*str;
 
 	switch (label) {
 	case 0x01:		/* Plain Text Extension */
@@ -372,20 +245,16 @@ DoGIFextension(FILE *fd, int label)
 		break;
 	case 0xfe:		/* Comment Extension */
 		str = "Comment Extension";
-		while (GetDataBlock(fd, buf) != 0) {
+		while (GetDataBlock(fd, buf) > 0) {
 			; /* GIF comment */
 		}
 		return False;
 	case 0xf9:		/* Graphic Control Extension */
 		str = "Graphic Control Extension";
-		(void) GetDataBlock(fd, (unsigned char*) buf);
-		Gif89.disposal    = (buf[0] >> 2) & 0x7;
-		Gif89.inputFlag   = (buf[0] >> 1) & 0x1;
-		Gif89.delayTime   = LM_to_uint(buf[1],buf[2]);
-		if ((buf[0] & 0x1) != 0)
-			Gif89.transparent = buf[3];
-
-		while (GetDataBlock(fd, buf) != 0)
+		if (GetDataBlock(fd, buf) >= 4 && (buf[0] & 0x1) != 0)
+			*transparent = buf[3];
+
+		while (GetDataBlock(fd, buf) > 0)
 			;
 		return False;
 	default:
@@ -397,14 +266,12 @@ DoGIFextension(FILE *fd, int label)
 	if (appres.DEBUG)
 		fprintf(stderr,"got a '%s' extension\n", str );
 
-	while (GetDataBlock(fd, buf) != 0)
+	while (GetDataBlock(fd, buf) > 0)
 		;
 
 	return False;
 }
 
-int	ZeroDataBlock = False;
-
 static int
 GetDataBlock(FILE *fd, unsigned char *buf)
 {
@@ -415,8 +282,6 @@ GetDataBlock(FILE *fd, unsigned char *buf)
 		return -1;
 	}
 
-	ZeroDataBlock = count == 0;
-
 	/* error in reading DataBlock */
 	if ((count != 0) && (! ReadOK(fd, buf, count))) {
 		return -1;
@@ -424,3 +289,151 @@ GetDataBlock(FILE *fd, unsigned char *buf)
 
 	return count;
 }
+
+/* return the next code of size bits, or -1 at the end of the data */
+static int
+GetCode(struct lzw_stream *lzw, int size)
+{
+	int	code;
+
+	while (lzw->nbits < size) {
+		if (lzw->pos == lzw->len) {
+			if (lzw->end)
+				return -1;
+			lzw->len = GetDataBlock(lzw->fp, lzw->block);
+			lzw->pos = 0;
+			if (lzw->len <= 0) {
+				lzw->end = True;
+				lzw->len = 0;
+				return -1;
+			}
+		}
+		lzw->bits |= (unsigned long)lzw->block[lzw->pos++] << lzw->nbits;
+		lzw->nbits += 8;
+	}
+	code = (int)(lzw->bits & ((1UL << size) - 1));
+	lzw->bits >>= size;
+	lzw->nbits -= size;
+	return code;
+}
+
+/*
+ * Decode the LZW compressed raster data into image, one byte per pixel.
+ * A truncated raster leaves the remaining pixels at 0.
+ */
+static Boolean
+ReadImage(FILE *fd, unsigned char *image, unsigned int width,
+		unsigned int height, Boolean interlaced)
+{
+	unsigned short	prefix[1 << MAX_LZW_BITS];
+	unsigned char	suffix[1 << MAX_LZW_BITS];
+	unsigned char	stack[(1 << MAX_LZW_BITS) + 1];
+	unsigned char	*sp;
+	unsigned char	*row;
+	unsigned char	c;
+	unsigned int	x, y;
+	int		pass;
+	int		min_size, code_size, clear, end, next;
+	int		code, incode, oldcode, first;
+	struct lzw_stream	lzw;
+	static const int	start[] = {0, 4, 2, 1};
+	static const int	step[] = {8, 8, 4, 2};
+
+	if (!ReadOK(fd, &c, 1))
+		return False;
+	min_size = c;
+	if (min_size < 1 || min_size >= MAX_LZW_BITS) {
+		file_msg("Bad GIF code size %d", min_size);
+		return False;
+	}
+
+	lzw.fp = fd;
+	lzw.bits = 0;
+	lzw.nbits = 0;
+	lzw.len = lzw.pos = 0;
+	lzw.end = False;
+
+	clear = 1 << min_size;
+	end = clear + 1;
+	for (code = 0; code < clear; ++code) {
+		prefix[code] = 0;
+		suffix[code] = (unsigned char)code;
+	}
+	code_size = min_size + 1;
+	next = clear + 2;
+	oldcode = -1;
+	first = 0;
+
+	x = y = 0;
+	pass = 0;
+	row = image;
+	while ((code = GetCode(&lzw, code_size)) >= 0) {
+		if (code == clear) {
+			code_size = min_size + 1;
+			next = clear + 2;
+			oldcode = -1;
+			continue;
+		}
+		if (code == end)
+			break;
+
+		sp = stack;
+		incode = code;
+		if (oldcode == -1) {
+			if (code > clear)
+				break;		/* corrupt data */
+			first = code;
+			*sp++ = (unsigned char)code;
+		} else {
+			if (code >= next) {
+				if (code > next)
+					break;	/* corrupt data */
+				*sp++ = (unsigned char)first;
+				code = oldcode;
+			}
+			while (code >= clear) {
+				*sp++ = suffix[code];
+				code = prefix[code];
+			}
+			first = code;
+			*sp++ = (unsigned char)first;
+
+			if (next < (1 << MAX_LZW_BITS)) {
+				prefix[next] = (unsigned short)oldcode;
+				suffix[next] = (unsigned char)first;
+				if (++next == 1 << code_size &&
+						code_size < MAX_LZW_BITS)
+					++code_size;
+			}
+		}
+		oldcode = incode;
+
+		/* write the string, which is stored in reverse order */
+		while (sp > stack) {
+			row[x] = *--sp;
+			if (++x == width) {
+				x = 0;
+				if (interlaced) {
+					y += step[pass];
+					while (y >= height && pass < 3)
+						y = start[++pass];
+				} else {
+					++y;
+				}
+				if (y >= height)
+					goto done;
+				row = image + (size_t)y * width;
+			}
+		}
+	}
+done:
+	if (y < height && appres.DEBUG)
+		fprintf(stderr, "GIF image data truncated\n");
+
+	/* skip the rest of the image data */
+	if (!lzw.end) {
+		while (GetDataBlock(fd, lzw.block) > 0)
+			;
+	}
+	return True;
+}
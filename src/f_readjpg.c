@@ -100,6 +100,34 @@ read_jpg(F_pic *pic, struct xfig_stream *restrict pic_stream)
 }
 
 
+/*
+ * Return the denominator 1, 2, 4 or 8, by which the image can be reduced
+ * while decoding, such that it still has the size wanted by the picture
+ * repository entry pics. A decode_size of -1 asks for the size at which the
+ * picture is shown at its natural size, at the zoom when reading started.
+ */
+static unsigned int
+decode_scale(struct _pics *pics, j_decompress_ptr cinfo, char unit)
+{
+	unsigned int	denom;
+	int		want_x, want_y;
+	int		size_x, size_y;
+
+	image_size(&size_x, &size_y, (int)cinfo->image_width,
+			(int)cinfo->image_height, unit, (float)cinfo->X_density,
+			(float)cinfo->Y_density);
+	wanted_size(pics, size_x, size_y, &want_x, &want_y);
+	if (want_x == 0 || want_y == 0)
+		return 1u;
+	for (denom = 8u; denom > 1u; denom /= 2u)
+		if ((cinfo->image_width + denom - 1) / denom >=
+					(unsigned)want_x &&
+				(cinfo->image_height + denom - 1) / denom >=
+					(unsigned)want_y)
+			break;
+	return denom;
+}
+
 /*
  * Return codes: 0 - success, (-1) - failure
  */
@@ -107,8 +135,10 @@ static int
 read_JPEG_file(FILE *file, F_pic *pic)
 {
 	int				i;
+	unsigned int			denom;
+	char				unit;
 	size_t				bitmap_row;	/* row size of bitmap */
-	static jmp_buf			setjmp_buffer;
+	jmp_buf				setjmp_buffer;	/* per call, for threads */
 	struct jpeg_decompress_struct	cinfo;
 	struct jpeg_error_mgr		jerr;		/* error handler */
 
@@ -124,8 +154,10 @@ read_JPEG_file(FILE *file, F_pic *pic)
 	if (setjmp(setjmp_buffer)) {
 		/* an error has occured */
 		jpeg_destroy_decompress(&cinfo);
-		if (pic->pic_cache->bitmap != NULL)
+		if (pic->pic_cache->bitmap != NULL) {
 			free(pic->pic_cache->bitmap);
+			pic->pic_cache->bitmap = NULL;
+		}
 		return -1;
 	}
 	/* Now we can initialize the JPEG decompression object. */
@@ -143,8 +175,17 @@ read_JPEG_file(FILE *file, F_pic *pic)
 	 *   (b) we passed TRUE to reject a tables-only JPEG file as an error.
 	 * See libjpeg.doc for more info.
 	 */
+	unit = cinfo.density_unit == 1u ? 'i' :
+				(cinfo.density_unit == 2u ? 'c': 'u');
 
 	if (tool_vclass == TrueColor && image_bpp == 4 && !appres.monochrome) {
+		/*
+		 * Use the DCT scaling of libjpeg to decode a large image at
+		 * about the size it is shown. Colormapped images are always
+		 * decoded at full size, the colormap would depend on the size.
+		 */
+		cinfo.scale_num = 1;
+		cinfo.scale_denom = decode_scale(pic->pic_cache, &cinfo, unit);
 #ifdef JCS_EXTENSIONS
 #ifdef WORDS_BIGENDIAN
 		cinfo.out_color_space = JCS_EXT_XRGB;
@@ -154,7 +195,7 @@ read_JPEG_file(FILE *file, F_pic *pic)
 #else
 		cinfo.out_color_space = JCS_RGB;
 #endif
-		bitmap_row = 4 * cinfo.image_width;
+		bitmap_row = 4;
 	} else {
 		/* colormapped color space */
 		cinfo.quantize_colors = TRUE;
@@ -164,13 +205,15 @@ read_JPEG_file(FILE *file, F_pic *pic)
 		 *			making an extra pass over the image.)
 		 * cinfo.desired_number_of_colors = 256;
 		 */
-		bitmap_row = cinfo.image_width;
+		bitmap_row = 1;
 	}
+	jpeg_calc_output_dimensions(&cinfo);
+	bitmap_row *= cinfo.output_width;
 
 
 	/* Now fill in the pic parameters */
 
-	pic->pic_cache->bitmap = malloc(bitmap_row * cinfo.image_height);
+	pic->pic_cache->bitmap = malloc(bitmap_row * cinfo.output_height);
 	if (pic->pic_cache->bitmap == NULL) {
 		file_msg("Can't alloc memory for JPEG image");
 		jpeg_destroy_decompress(&cinfo);
@@ -297,13 +340,20 @@ read_JPEG_file(FILE *file, F_pic *pic)
 	/* fill the pic struct */
 	pic->pixmap = None;
 	pic->pic_cache->subtype = T_PIC_JPEG;
-	pic->pic_cache->bit_size.x = (int)cinfo.image_width;
-	pic->pic_cache->bit_size.y = (int)cinfo.image_height;
+	pic->pic_cache->bit_size.x = (int)cinfo.output_width;
+	pic->pic_cache->bit_size.y = (int)cinfo.output_height;
+	/* scale_denom is 1, unless set above; a local variable changed after
+	   setjmp() might be clobbered by longjmp() */
+	pic->pic_cache->reduced = 0;
+	for (denom = cinfo.scale_denom; denom > 1u; denom /= 2u)
+		++pic->pic_cache->reduced;
+	if (appres.DEBUG && pic->pic_cache->reduced)
+		fprintf(stderr, "Decoded jpeg image of %ux%u at %ux%u pixels\n",
+				cinfo.image_width, cinfo.image_height,
+				cinfo.output_width, cinfo.output_height);
 	pic->hw_ratio = (float)cinfo.image_height / cinfo.image_width;
 	image_size(&pic->pic_cache->size_x, &pic->pic_cache->size_y,
-			pic->pic_cache->bit_size.x, pic->pic_cache->bit_size.y,
-			cinfo.density_unit == 1u ? 'i' :
-					(cinfo.density_unit == 2u ? 'c': 'u'),
+			(int)cinfo.image_width, (int)cinfo.image_height, unit,
 			(float)cinfo.X_density, (float)cinfo.Y_density);
 
 	return 0;
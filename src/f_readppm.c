@@ -20,9 +20,16 @@
 #include "config.h"		/* restrict */
 #endif
 
+#include <limits.h>		/* UINT_MAX */
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include <X11/X.h>	/* TrueColor, None */
 #include <X11/Xmd.h>	/* CARD32 */
 
@@ -62,128 +69,140 @@ skip_comments_whitespace(FILE *file)
 #define THREE_BYTEPERPIXEL	(tool_vclass != TrueColor || image_bpp != 4 \
 					|| appres.monochrome)
 
-static int
-read_8bitppm(FILE *file, unsigned char *restrict dst, unsigned int width,
-						unsigned int height)
+/*
+ * Convert width pixels of a raw ppm row in src to the bitmap format in dst.
+ * Samples of two bytes, i.e., if maxval > 255, or samples with a maxval
+ * other than 255 are scaled to 0--255 through lut.
+ */
+static void
+convert_row(const unsigned char *restrict src, unsigned char *restrict dst,
+		unsigned int width, bool wide, const unsigned char *lut)
 {
-	int		c[3];
-	unsigned int	w;
-
-	if (THREE_BYTEPERPIXEL) {
-		while (height-- > 0u) {
-			w = width;
-			while (w-- > 0u) {
-				if ((c[0] = fgetc(file)) == EOF ||
-						(c[1] = fgetc(file)) == EOF ||
-						(c[2] = fgetc(file)) == EOF)
-					return FileInvalid;
-				/* map_to_palette expects BGR triples */
-				*(dst++) = (unsigned char)c[2];
-				*(dst++) = (unsigned char)c[1];
-				*(dst++) = (unsigned char)c[0];
-			}
+	unsigned int	r, g, b;
+	const bool	three = THREE_BYTEPERPIXEL;
+
+	while (width-- > 0u) {
+		if (wide) {
+			/* the most significant byte comes first */
+			r = lut[(unsigned)src[0] << 8 | src[1]];
+			g = lut[(unsigned)src[2] << 8 | src[3]];
+			b = lut[(unsigned)src[4] << 8 | src[5]];
+			src += 6;
+		} else if (lut) {
+			r = lut[src[0]];
+			g = lut[src[1]];
+			b = lut[src[2]];
+			src += 3;
+		} else {
+			r = src[0];
+			g = src[1];
+			b = src[2];
+			src += 3;
 		}
-		return PicSuccess;
-	}
-
-	while (height-- > 0u) {
-		w = width;
-		while (w-- > 0u) {
-			if ((c[0] = fgetc(file)) == EOF ||
-					(c[1] = fgetc(file)) == EOF ||
-					(c[2] = fgetc(file)) == EOF)
-				return FileInvalid;
-			*(CARD32 *)dst = ((CARD32)c[0] << 16) +
-					((CARD32)c[1] << 8) + (CARD32)c[2];
+		if (three) {
+			/* map_to_palette expects BGR triples */
+			*(dst++) = (unsigned char)b;
+			*(dst++) = (unsigned char)g;
+			*(dst++) = (unsigned char)r;
+		} else {
+			*(CARD32 *)dst = ((CARD32)r << 16) + ((CARD32)g << 8) +
+						(CARD32)b;
 			dst += sizeof(CARD32);
 		}
 	}
-	return PicSuccess;
-}
-
-static void
-scale_to_255(unsigned char *restrict byte, unsigned maxval, unsigned rowbytes,
-		unsigned height)
-{
-	unsigned int	w;
-	const unsigned	rnd = maxval / 2;
-
-	/* This scales also the unused alpha channel for TrueColor visuals. One
-	   would have to check endian-ness, to avoid the unecessary scaling */
-	while (height-- > 0u) {
-		w = rowbytes;
-		while (w-- > 0u) {
-			*byte = (*byte * 255u + rnd) / maxval;
-			++byte;
-		}
-	}
 }
 
 /*
- * Read the next six bytes from file, which correspond to a rgb triplet with two
- * bytes for each channel, and return the values scaled into the range 0--255.
+ * Return a table that scales the samples 0--maxval to 0--255, or NULL if
+ * no scaling is necessary. Samples beyond maxval give 255.
  */
-static int
-read6bytes(FILE *file, unsigned maxval, unsigned *r, unsigned *g, unsigned *b)
+static unsigned char *
+scale_table(unsigned int maxval)
 {
-	int		c[6];
+	unsigned char	*lut;
+	const unsigned	size = maxval < 256u ? 256u : 65536u;
 	const uint32_t	rnd = maxval / 2;
-
-	if ((c[0] = fgetc(file)) == EOF || (c[1] = fgetc(file)) == EOF ||
-		   (c[2] = fgetc(file)) == EOF || (c[3] = fgetc(file)) == EOF ||
-		   (c[4] = fgetc(file)) == EOF || (c[5] = fgetc(file)) == EOF)
-		return FileInvalid;
-
-	/* scale to the range 0 - 255 */
-	/* two-byte ppm files have the most significant byte first */
-	*r = ((((uint32_t)c[0] << 8) + c[1]) * 255u + rnd) / maxval;
-	*g = ((((uint32_t)c[2] << 8) + c[3]) * 255u + rnd) / maxval;
-	*b = ((((uint32_t)c[4] << 8) + c[5]) * 255u + rnd) / maxval;
-
-	if (*r > 255u)
-		*r = 255u;
-	if (*g > 255u)
-		*g = 255u;
-	if (*b > 255u)
-		*b = 255u;
-
-	return 0;
+	unsigned int	i;
+
+	if (maxval == 255u)
+		return NULL;
+	if ((lut = malloc(size)) == NULL)
+		return NULL;
+	for (i = 0; i < size; ++i)
+		lut[i] = i >= maxval ? 255u :
+				(unsigned char)(((uint32_t)i * 255u + rnd) / maxval);
+	return lut;
 }
 
+/*
+ * Read a raw ppm file. A regular file is mapped into memory, otherwise it
+ * is read row by row.
+ */
 static int
-read_16bitppm(FILE *file, unsigned char *restrict dst, unsigned int maxval,
-		unsigned int width, unsigned int height)
+read_rawppm(FILE *file, unsigned char *restrict dst, unsigned int maxval,
+		unsigned int width, unsigned int height, bool regular)
 {
-	unsigned int	w;
-	unsigned int	r, g, b;
+	const bool	wide = maxval > 255u;
+	const size_t	srcbytes = (size_t)width * (wide ? 6u : 3u);
+	const size_t	dstbytes = (size_t)width *
+				(THREE_BYTEPERPIXEL ? 3u : sizeof(CARD32));
+	unsigned char	*lut;
+	unsigned char	*row;
+	int		stat = FileInvalid;
 
-	if (THREE_BYTEPERPIXEL) {
-		while (height-- > 0u) {
-			w = width;
-			while (w-- > 0u) {
-				if (read6bytes(file, maxval, &r, &g, &b))
-					return FileInvalid;
+	lut = scale_table(maxval);
+	if (lut == NULL && maxval != 255u) {
+		file_msg("Out of memory, could not read PPM file.");
+		return FileInvalid;
+	}
 
-				/* map_to_palette expects BGR triples */
-				*(dst++) = (unsigned char)b;
-				*(dst++) = (unsigned char)g;
-				*(dst++) = (unsigned char)r;
+#ifdef HAVE_MMAP
+	if (regular) {
+		struct stat	st;
+		long		offset = ftell(file);
+		int		fd = fileno(file);
+		void		*map;
+
+		if (offset >= 0 && fd >= 0 && !fstat(fd, &st) &&
+				S_ISREG(st.st_mode) && (off_t)(offset +
+					srcbytes * height) <= st.st_size &&
+				(map = mmap(NULL, (size_t)st.st_size, PROT_READ,
+					MAP_PRIVATE, fd, (off_t)0)) != MAP_FAILED) {
+			const unsigned char	*src =
+					(unsigned char *)map + offset;
+#ifdef MADV_SEQUENTIAL
+			(void)madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+			while (height-- > 0u) {
+				convert_row(src, dst, width, wide, lut);
+				src += srcbytes;
+				dst += dstbytes;
 			}
+			munmap(map, (size_t)st.st_size);
+			free(lut);
+			return PicSuccess;
 		}
-		return PicSuccess;
 	}
+#else
+	(void)regular;
+#endif
 
+	if ((row = malloc(srcbytes)) == NULL) {
+		file_msg("Out of memory, could not read PPM file.");
+		free(lut);
+		return FileInvalid;
+	}
 	while (height-- > 0u) {
-		w = width;
-		while (w-- > 0u) {
-			if (read6bytes(file, maxval, &r, &g, &b))
-				return FileInvalid;
-			*(CARD32 *)dst = ((CARD32)r << 16) + ((CARD32)g << 8) +
-						(CARD32)b;
-			dst += sizeof(CARD32);
-		}
+		if (fread(row, srcbytes, (size_t)1, file) != 1)
+			break;
+		convert_row(row, dst, width, wide, lut);
+		dst += dstbytes;
 	}
-	return PicSuccess;
+	if (height == UINT_MAX)		/* all rows were read */
+		stat = PicSuccess;
+	free(row);
+	free(lut);
+	return stat;
 }
 
 static int
@@ -351,17 +370,9 @@ read_ppm(F_pic *pic, struct xfig_stream *restrict pic_stream)
 		if (appres.DEBUG)
 			fprintf(stderr, "Reading raw PPM file, %u x %u, max. "
 					"value %u.\n", width, height, maxval);
-		if (maxval < 256u) {
-			stat = read_8bitppm(pic_stream->fp,
-					pic->pic_cache->bitmap, width, height);
-			if (maxval != 255u)
-				scale_to_255(pic->pic_cache->bitmap, maxval,
-						rowbytes, height);
-		} else {
-			stat = read_16bitppm(pic_stream->fp,
-					pic->pic_cache->bitmap, maxval,
-					width, height);
-		}
+		stat = read_rawppm(pic_stream->fp, pic->pic_cache->bitmap,
+				maxval, width, height,
+				*pic_stream->uncompress == '\0');
 	} else { /* magic == '3' */
 		if (appres.DEBUG)
 			fprintf(stderr, "Reading ascii PPM file, %u x %u, max. "
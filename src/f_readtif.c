@@ -23,6 +23,7 @@
 
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 #include <tiffio.h>
 
 #include "resources.h"
@@ -41,28 +42,235 @@ error_handler(const char *module, const char *fmt, va_list ap)
 	file_msg("%s: %s", module, buffer);
 }
 
+/*
+ * A tiff image embedded in another file, at offset with the given length,
+ * e.g., the preview of a DOS EPS file. Read via TIFFClientOpen().
+ */
+struct tif_part {
+	FILE	*fp;
+	toff_t	offset;
+	toff_t	length;
+};
+
+static tsize_t
+part_read(thandle_t handle, tdata_t buf, tsize_t size)
+{
+	struct tif_part	*part = (struct tif_part *)handle;
+	off_t		pos = ftello(part->fp) - (off_t)part->offset;
+
+	if (pos < 0 || (toff_t)pos >= part->length)
+		return 0;
+	if ((toff_t)(pos + size) > part->length)
+		size = (tsize_t)(part->length - pos);
+	return (tsize_t)fread(buf, 1, (size_t)size, part->fp);
+}
+
+static tsize_t
+part_write(thandle_t handle, tdata_t buf, tsize_t size)
+{
+	(void)handle;
+	(void)buf;
+	(void)size;
+	return (tsize_t)-1;
+}
+
+static toff_t
+part_seek(thandle_t handle, toff_t off, int whence)
+{
+	struct tif_part	*part = (struct tif_part *)handle;
+	off_t		pos;
+
+	switch (whence) {
+	case SEEK_SET:
+		pos = (off_t)off;
+		break;
+	case SEEK_CUR:
+		pos = ftello(part->fp) - (off_t)part->offset + (off_t)off;
+		break;
+	case SEEK_END:
+		pos = (off_t)part->length + (off_t)off;
+		break;
+	default:
+		return (toff_t)-1;
+	}
+	if (pos < 0 || fseeko(part->fp, (off_t)part->offset + pos, SEEK_SET))
+		return (toff_t)-1;
+	return (toff_t)pos;
+}
+
+static int
+part_close(thandle_t handle)
+{
+	(void)handle;
+	return 0;
+}
+
+static toff_t
+part_size(thandle_t handle)
+{
+	return ((struct tif_part *)handle)->length;
+}
+
+static int
+part_map(thandle_t handle, tdata_t *base, toff_t *size)
+{
+	(void)handle;
+	(void)base;
+	(void)size;
+	return 0;
+}
+
+static void
+part_unmap(thandle_t handle, tdata_t base, toff_t size)
+{
+	(void)handle;
+	(void)base;
+	(void)size;
+}
+
+/*
+ * A tiff image in memory, e.g., the uncompressed content of a compressed
+ * file. Read via TIFFClientOpen(), with the no-ops of tif_part above.
+ */
+struct tif_mem {
+	const char	*data;
+	toff_t		size;
+	toff_t		pos;
+};
+
+static tsize_t
+mem_read(thandle_t handle, tdata_t buf, tsize_t size)
+{
+	struct tif_mem	*mem = (struct tif_mem *)handle;
+
+	if (mem->pos >= mem->size)
+		return 0;
+	if ((toff_t)size > mem->size - mem->pos)
+		size = (tsize_t)(mem->size - mem->pos);
+	memcpy(buf, mem->data + mem->pos, (size_t)size);
+	mem->pos += (toff_t)size;
+	return size;
+}
+
+static toff_t
+mem_seek(thandle_t handle, toff_t off, int whence)
+{
+	struct tif_mem	*mem = (struct tif_mem *)handle;
+	off_t		pos;
+
+	switch (whence) {
+	case SEEK_SET:
+		pos = (off_t)off;
+		break;
+	case SEEK_CUR:
+		pos = (off_t)mem->pos + (off_t)off;
+		break;
+	case SEEK_END:
+		pos = (off_t)mem->size + (off_t)off;
+		break;
+	default:
+		return (toff_t)-1;
+	}
+	if (pos < 0)
+		return (toff_t)-1;
+	mem->pos = (toff_t)pos;
+	return mem->pos;
+}
+
+static toff_t
+mem_size(thandle_t handle)
+{
+	return ((struct tif_mem *)handle)->size;
+}
+
+static int	read_tiff(F_pic *pic, TIFF *tif);
+
 /* return codes:  PicSuccess (1) : success
 		  FileInvalid (-2) : invalid file
 */
 int
 read_tif(F_pic *pic, struct xfig_stream *restrict pic_stream)
 {
-	int		stat = FileInvalid;
-	uint16		unit;
-	uint32		w, h;
-	float		res_x, res_y;
+	int		stat;
+	size_t		len;
 	TIFF		*tif;
-
-	if (uncompressed_content(pic_stream))
-		return FileInvalid;
+	struct tif_mem	mem;
 
 	/* re-direct TIFF errors to file_msg() */
 	(void)TIFFSetErrorHandler(error_handler);
 	/* ignore warnings */
 	(void)TIFFSetWarningHandler(NULL);
 
-	if ((tif = TIFFOpen(pic_stream->content, "r")) == NULL)
-		return stat;
+	if (*pic_stream->uncompress == '\0') {
+		if ((tif = TIFFOpen(pic_stream->name_on_disk, "r")) == NULL)
+			return FileInvalid;
+		return read_tiff(pic, tif);
+	}
+
+	/* a compressed file, uncompress it into memory */
+	if ((mem.data = stream_content(pic_stream, &len)) == NULL)
+		return FileInvalid;
+	mem.size = (toff_t)len;
+	mem.pos = 0;
+	if ((tif = TIFFClientOpen(pic_stream->name, "rm", (thandle_t)&mem,
+				mem_read, part_write, mem_seek, part_close,
+				mem_size, part_map, part_unmap)) == NULL) {
+		free((char *)mem.data);
+		return FileInvalid;
+	}
+	stat = read_tiff(pic, tif);
+	free((char *)mem.data);
+	return stat;
+}
+
+/*
+ * Read the tiff image of length bytes at offset in the regular file name.
+ * Return codes as for read_tif().
+ */
+int
+read_tif_part(F_pic *pic, const char *name, long offset, long length)
+{
+	int		stat;
+	TIFF		*tif;
+	struct tif_part	part;
+
+	if (offset <= 0 || length <= 0)
+		return FileInvalid;
+	if ((part.fp = fopen(name, "rb")) == NULL)
+		return FileInvalid;
+	part.offset = (toff_t)offset;
+	part.length = (toff_t)length;
+	/* libtiff reads the header without seeking to it */
+	if (fseeko(part.fp, (off_t)offset, SEEK_SET)) {
+		fclose(part.fp);
+		return FileInvalid;
+	}
+
+	(void)TIFFSetErrorHandler(error_handler);
+	(void)TIFFSetWarningHandler(NULL);
+
+	/* "m", do not try to memory-map the file */
+	if ((tif = TIFFClientOpen(name, "rm", (thandle_t)&part, part_read,
+				part_write, part_seek, part_close, part_size,
+				part_map, part_unmap)) == NULL) {
+		fclose(part.fp);
+		return FileInvalid;
+	}
+	stat = read_tiff(pic, tif);
+	fclose(part.fp);
+	return stat;
+}
+
+/*
+ * Read the image from tif, and close tif.
+ */
+static int
+read_tiff(F_pic *pic, TIFF *tif)
+{
+	int		stat = FileInvalid;
+	uint16		unit;
+	uint32		w, h;
+	float		res_x, res_y;
 
 	/* read image width and height */
 	if (TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &w) != 1) {
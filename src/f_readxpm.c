@@ -35,9 +35,18 @@
 #include "w_msgpanel.h"
 #include "w_setup.h"
 
+/* read the image from the file, or from data, the content of a compressed
+   file */
+static int
+read_image(struct xfig_stream *restrict pic_stream, char *data,
+		XpmImage *image)
+{
+	if (data)
+		return XpmCreateXpmImageFromBuffer(data, image, NULL);
+	return XpmReadFileToXpmImage(pic_stream->name_on_disk, image, NULL);
+}
+
 /* attempt to read a XPM (color pixmap) file */
-/* the filename is passed since XpmReadFileToXpmImage needs a name
-   instead of a FILE pointer.  This is fine because it handles compressed files */
 
 /* return codes:  PicSuccess (1) : success
 		  FileInvalid (-2) : invalid file
@@ -51,23 +60,30 @@ read_xpm(F_pic *pic, struct xfig_stream *restrict pic_stream)
 	unsigned int	i;
 	char		*c;
 	XColor		exact_def;
+	char		*data;
+	size_t		len;
 
 	/* make scale factor smaller for metric */
 	float scale = (appres.INCHES ?
 			(float)PIX_PER_INCH :
 			2.54*PIX_PER_CM)/(float)DISPLAY_PIX_PER_INCH;
 
-	if (uncompressed_content(pic_stream))
+	/* a compressed file is uncompressed into memory */
+	data = NULL;
+	if (*pic_stream->uncompress &&
+			(data = stream_content(pic_stream, &len)) == NULL)
 		return FileInvalid;
 
-	status = XpmReadFileToXpmImage(pic_stream->content, &image, NULL);
+	status = read_image(pic_stream, data, &image);
 	/* if out of colors, try switching colormaps and reading again */
 	if (status == XpmColorFailed) {
-		if (!switch_colormap())
+		if (!switch_colormap()) {
+			free(data);
 			return PicSuccess;
-		status = XpmReadFileToXpmImage(pic_stream->content, &image,
-						NULL);
+		}
+		status = read_image(pic_stream, data, &image);
 	}
+	free(data);
 	if (status == XpmSuccess) {
 		/* now look up the colors in the image and put them
 		   in the pic colormap */
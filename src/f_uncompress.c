@@ -0,0 +1,466 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2015 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+/*
+ * Uncompress gzip, bzip2 and xz compressed files in-process.
+ *
+ * open_uncompressed() returns a stdio stream that reads the uncompressed
+ * content of a file; it is built with fopencookie() or funopen(). The
+ * stream can be rewound, and seeks forward by decompressing and
+ * discarding data, seeks backward by starting over. Formats that cannot
+ * be decoded in-process, e.g., files compressed with compress(1) or zip,
+ * give NULL, and the caller falls back to an external program.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE		/* fopencookie() */
+#endif
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include "f_uncompress.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BZLIB
+#include <bzlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+
+#if (defined HAVE_FOPENCOOKIE || defined HAVE_FUNOPEN) && \
+	(defined HAVE_ZLIB || defined HAVE_BZLIB || defined HAVE_LZMA)
+#define UNCOMPRESS_IN_PROCESS
+#endif
+
+#ifdef UNCOMPRESS_IN_PROCESS
+
+enum zformat { Z_GZIP, Z_BZIP2, Z_XZ };
+
+#ifdef HAVE_FOPENCOOKIE
+typedef off64_t	zoff_t;
+#else
+typedef off_t	zoff_t;
+#endif
+
+struct zsource {
+	FILE		*in;		/* the compressed file */
+	enum zformat	format;
+	int		end;		/* end of the compressed data */
+	int		error;		/* error to report on the next read */
+	int		member;		/* number of the gzip member */
+	zoff_t		pos;		/* position in the uncompressed data */
+	union {
+#ifdef HAVE_ZLIB
+		z_stream	gz;
+#endif
+#ifdef HAVE_BZLIB
+		bz_stream	bz;
+#endif
+#ifdef HAVE_LZMA
+		lzma_stream	xz;
+#endif
+	} s;
+	unsigned char	buf[16384];	/* compressed input */
+};
+
+/* determine the compression format from the magic bytes */
+static int
+zformat(FILE *in, enum zformat *format)
+{
+	unsigned char	magic[6];
+	size_t		n;
+
+	n = fread(magic, 1, sizeof magic, in);
+	rewind(in);
+#ifdef HAVE_ZLIB
+	if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+		*format = Z_GZIP;
+		return 0;
+	}
+#endif
+#ifdef HAVE_BZLIB
+	if (n >= 3 && !memcmp(magic, "BZh", 3)) {
+		*format = Z_BZIP2;
+		return 0;
+	}
+#endif
+#ifdef HAVE_LZMA
+	if (n >= 6 && !memcmp(magic, "\3757zXZ", 6)) {
+		*format = Z_XZ;
+		return 0;
+	}
+#endif
+	(void)n;
+	return -1;
+}
+
+static int
+zinit(struct zsource *z)
+{
+	z->end = 0;
+	z->error = 0;
+	z->member = 0;
+	z->pos = 0;
+	memset(&z->s, 0, sizeof z->s);
+	switch (z->format) {
+#ifdef HAVE_ZLIB
+	case Z_GZIP:
+		return inflateInit2(&z->s.gz, 15 + 16) == Z_OK ? 0 : -1;
+#endif
+#ifdef HAVE_BZLIB
+	case Z_BZIP2:
+		return BZ2_bzDecompressInit(&z->s.bz, 0, 0) == BZ_OK ? 0 : -1;
+#endif
+#ifdef HAVE_LZMA
+	case Z_XZ:
+		return lzma_stream_decoder(&z->s.xz, UINT64_MAX,
+				LZMA_CONCATENATED) == LZMA_OK ? 0 : -1;
+#endif
+	default:
+		return -1;
+	}
+}
+
+static void
+zend(struct zsource *z)
+{
+	switch (z->format) {
+#ifdef HAVE_ZLIB
+	case Z_GZIP:
+		(void)inflateEnd(&z->s.gz);
+		break;
+#endif
+#ifdef HAVE_BZLIB
+	case Z_BZIP2:
+		(void)BZ2_bzDecompressEnd(&z->s.bz);
+		break;
+#endif
+#ifdef HAVE_LZMA
+	case Z_XZ:
+		lzma_end(&z->s.xz);
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+/* return whether more compressed data follow a finished stream */
+static int
+more_input(struct zsource *z, size_t avail)
+{
+	int	c;
+
+	if (avail > 0)
+		return 1;
+	if ((c = getc(z->in)) == EOF)
+		return 0;
+	ungetc(c, z->in);
+	return 1;
+}
+
+/*
+ * Decompress up to len bytes into out. Return the number of bytes,
+ * 0 at the end of the data, or -1 on error. An error after some bytes
+ * were decompressed is reported on the next call.
+ */
+static ssize_t
+zread(void *cookie, char *out, size_t len)
+{
+	struct zsource	*z = cookie;
+	size_t		done = 0;
+
+	if (z->error) {
+		errno = z->error;
+		return -1;
+	}
+	while (done < len && !z->end) {
+		switch (z->format) {
+#ifdef HAVE_ZLIB
+		case Z_GZIP: {
+			z_stream	*s = &z->s.gz;
+			int		ret;
+
+			if (s->avail_in == 0) {
+				s->next_in = z->buf;
+				s->avail_in = (uInt)fread(z->buf, 1,
+						sizeof z->buf, z->in);
+				if (s->avail_in == 0)
+					goto fail;	/* truncated */
+			}
+			s->next_out = (Bytef *)out + done;
+			s->avail_out = (uInt)(len - done);
+			ret = inflate(s, Z_NO_FLUSH);
+			done = len - s->avail_out;
+			if (ret == Z_STREAM_END) {
+				/* gzip allows several members in a file */
+				if (more_input(z, s->avail_in)) {
+					ret = inflateReset(s);
+					++z->member;
+				} else {
+					z->end = 1;
+				}
+			} else if (ret == Z_DATA_ERROR && z->member > 0 &&
+					s->total_out == 0) {
+				/* ignore trailing garbage, like gunzip */
+				z->end = 1;
+				break;
+			}
+			if (ret != Z_OK && ret != Z_STREAM_END &&
+					ret != Z_BUF_ERROR)
+				goto fail;
+			break;
+		}
+#endif
+#ifdef HAVE_BZLIB
+		case Z_BZIP2: {
+			bz_stream	*s = &z->s.bz;
+			int		ret;
+
+			if (s->avail_in == 0) {
+				s->next_in = (char *)z->buf;
+				s->avail_in = (unsigned)fread(z->buf, 1,
+						sizeof z->buf, z->in);
+				if (s->avail_in == 0)
+					goto fail;
+			}
+			s->next_out = out + done;
+			s->avail_out = (unsigned)(len - done);
+			ret = BZ2_bzDecompress(s);
+			done = len - s->avail_out;
+			if (ret == BZ_STREAM_END) {
+				/* concatenated streams, as with gzip */
+				if (more_input(z, s->avail_in)) {
+					char		*next = s->next_in;
+					unsigned	avail = s->avail_in;
+
+					(void)BZ2_bzDecompressEnd(s);
+					memset(s, 0, sizeof *s);
+					if (BZ2_bzDecompressInit(s, 0, 0)
+							!= BZ_OK)
+						goto fail;
+					s->next_in = next;
+					s->avail_in = avail;
+				} else {
+					z->end = 1;
+				}
+			} else if (ret != BZ_OK) {
+				goto fail;
+			}
+			break;
+		}
+#endif
+#ifdef HAVE_LZMA
+		case Z_XZ: {
+			lzma_stream	*s = &z->s.xz;
+			lzma_ret	ret;
+			int		eof = 0;
+
+			if (s->avail_in == 0) {
+				s->next_in = z->buf;
+				s->avail_in = fread(z->buf, 1, sizeof z->buf,
+						z->in);
+				eof = s->avail_in == 0;
+			}
+			s->next_out = (uint8_t *)out + done;
+			s->avail_out = len - done;
+			ret = lzma_code(s, eof ? LZMA_FINISH : LZMA_RUN);
+			done = len - s->avail_out;
+			if (ret == LZMA_STREAM_END) {
+				z->end = 1;
+			} else if (ret != LZMA_OK) {
+				goto fail;
+			}
+			break;
+		}
+#endif
+		default:
+			goto fail;
+		}
+	}
+	z->pos += done;
+	return (ssize_t)done;
+
+fail:
+	if (done == 0) {
+		errno = EIO;
+		return -1;
+	}
+	z->error = EIO;
+	z->pos += done;
+	return (ssize_t)done;
+}
+
+/* only SEEK_SET and SEEK_CUR are possible */
+static int
+zseek(void *cookie, zoff_t *offset, int whence)
+{
+	struct zsource	*z = cookie;
+	zoff_t		target;
+	char		trash[4096];
+	ssize_t		n;
+
+	if (whence == SEEK_SET)
+		target = *offset;
+	else if (whence == SEEK_CUR)
+		target = z->pos + *offset;
+	else
+		target = -1;
+	if (target < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (target < z->pos) {
+		/* start over */
+		zend(z);
+		rewind(z->in);
+		if (zinit(z)) {
+			errno = EIO;
+			return -1;
+		}
+	}
+	while (z->pos < target) {
+		size_t	len = sizeof trash;
+
+		if ((zoff_t)len > target - z->pos)
+			len = (size_t)(target - z->pos);
+		if ((n = zread(z, trash, len)) <= 0)
+			break;
+	}
+	*offset = z->pos;
+	return 0;
+}
+
+static int
+zclose(void *cookie)
+{
+	struct zsource	*z = cookie;
+	int		ret;
+
+	zend(z);
+	ret = fclose(z->in);
+	free(z);
+	return ret;
+}
+
+#ifndef HAVE_FOPENCOOKIE
+/* the funopen() interface, e.g., on BSD */
+static int
+zread_fun(void *cookie, char *out, int len)
+{
+	return (int)zread(cookie, out, (size_t)len);
+}
+
+static fpos_t
+zseek_fun(void *cookie, fpos_t offset, int whence)
+{
+	zoff_t	off = (zoff_t)offset;
+
+	if (zseek(cookie, &off, whence))
+		return (fpos_t)-1;
+	return (fpos_t)off;
+}
+#endif
+
+#endif /* UNCOMPRESS_IN_PROCESS */
+
+/*
+ * Return a stream to read the uncompressed content of the file name.
+ * Return NULL, if the file cannot be decompressed in-process.
+ */
+FILE *
+open_uncompressed(const char *name)
+{
+#ifdef UNCOMPRESS_IN_PROCESS
+	struct zsource	*z;
+	FILE		*fp;
+
+	if ((z = malloc(sizeof(struct zsource))) == NULL)
+		return NULL;
+	if ((z->in = fopen(name, "rb")) == NULL) {
+		free(z);
+		return NULL;
+	}
+	if (zformat(z->in, &z->format) || zinit(z)) {
+		fclose(z->in);
+		free(z);
+		return NULL;
+	}
+
+#ifdef HAVE_FOPENCOOKIE
+	{
+		cookie_io_functions_t	io = {zread, NULL, zseek, zclose};
+		fp = fopencookie(z, "rb", io);
+	}
+#else
+	fp = funopen(z, zread_fun, NULL, zseek_fun, zclose);
+#endif
+	if (fp == NULL)
+		zclose(z);
+	return fp;
+#else
+	(void)name;
+	return NULL;
+#endif /* UNCOMPRESS_IN_PROCESS */
+}
+
+/*
+ * Write the uncompressed content of the file name to fd.
+ * Return 0 on success, or -1 if the file cannot be decompressed in-process,
+ * or on error.
+ */
+int
+uncompress_to_fd(const char *name, int fd)
+{
+	FILE	*fp;
+	char	buf[BUFSIZ];
+	size_t	n;
+	ssize_t	w;
+	int	ret = 0;
+
+	if ((fp = open_uncompressed(name)) == NULL)
+		return -1;
+	while (ret == 0 && (n = fread(buf, 1, sizeof buf, fp)) > 0) {
+		char	*p = buf;
+
+		while (n > 0) {
+			if ((w = write(fd, p, n)) < 0) {
+				if (errno == EINTR)
+					continue;
+				ret = -1;
+				break;
+			}
+			p += w;
+			n -= (size_t)w;
+		}
+	}
+	if (ferror(fp))
+		ret = -1;
+	fclose(fp);
+	return ret;
+}
@@ -20,7 +20,10 @@
 #include "config.h"
 #endif
 
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <math.h>
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,6 +34,9 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <X11/Xlib.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "resources.h"
 #include "object.h"
@@ -38,6 +44,7 @@
 #include "f_neuclrtab.h"
 #include "f_read.h"
 #include "f_save.h"		/* write_file() */
+#include "f_uncompress.h"	/* open_uncompressed(), uncompress_to_fd() */
 #include "f_util.h"
 #include "u_create.h"		/* new_string() */
 #include "u_fonts.h"		/* psfontnum() */
@@ -232,12 +239,38 @@ static int	  num_oldcolors = -1;
 static Boolean	  usenet;
 static int	  npixels;
 
+/* pictures may be read in worker threads, all share the neural net */
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t	neu_lock = PTHREAD_MUTEX_INITIALIZER;
+#define	lock_neu()	pthread_mutex_lock(&neu_lock)
+#define	unlock_neu()	pthread_mutex_unlock(&neu_lock)
+#else
+#define	lock_neu()
+#define	unlock_neu()
+#endif
+
 #define REMAP_MSG	"Remapping picture colors..."
 #define REMAP_MSG2	"Remapping picture colors...Done"
 
+/* true while the picture colors are being remapped */
+Boolean	remapping_colors = False;
+
+static void	do_remap_imagecolors(void);
+
 /* remap the colors for all the pictures in the picture repository */
 
 void remap_imagecolors(void)
+{
+    /* check_cancel() may process events, do not start over from there */
+    if (remapping_colors)
+	return;
+    remapping_colors = True;
+    do_remap_imagecolors();
+    remapping_colors = False;
+}
+
+static void
+do_remap_imagecolors(void)
 {
     int		    i;
 
@@ -315,7 +348,10 @@ void remap_imagecolors(void)
 	/* initialize the neural network */
 	/* -1 means can't alloc memory, -2 or more means must have that many times
 		as many pixels */
+	/* Do not process events while the network is locked: a callback might
+	   remap the colors again, or a worker may wait for the lock. */
 	set_temp_cursor(wait_cursor);
+	lock_neu();
 	if ((stat=neu_init(npixels)) <= -2) {
 	    mult = -stat;
 	    npixels *= mult;
@@ -325,6 +361,7 @@ void remap_imagecolors(void)
 	if (stat == -1) {
 	    /* couldn't alloc memory for network */
 	    fprintf(stderr,"Can't alloc memory for neural network\n");
+	    unlock_neu();
 	    reset_cursor();
 	    put_msg(REMAP_MSG2);
 	    app_flush();
@@ -345,14 +382,11 @@ void remap_imagecolors(void)
 	    image_cells[i].blue  = (unsigned short) clrtab[i][N_BLU] << 8;
 	}
 	YStoreColors(tool_cm, image_cells, avail_image_cols);
-	reset_cursor();
-
-	/* check if user pressed cancel button */
-	if (check_cancel())
-	    return;
 
 	/* get the new, mapped indices for the image colormap */
 	remap_image_colormap();
+	unlock_neu();
+	reset_cursor();
     } else {
 	/*
 	 * Extract the RGB values from the image's colormap and allocate
@@ -497,9 +531,6 @@ void add_all_pixels(void)
 	    /* now add each pixel to the sample list */
 	    npix = pics->bit_size.x * pics->bit_size.y;
 	    for (i=0; i < npix; i++) {
-		/* check if user pressed cancel button */
-		if (i%1000==0 && check_cancel())
-		    return;
 		byte = pics->bitmap[i];
 		col[N_RED] = pics->cmap[byte].red;
 		col[N_GRN] = pics->cmap[byte].green;
@@ -683,15 +714,37 @@ safe_strcpy(char *p1, char *p2)
     return c1;
 }
 
-/* gunzip file if necessary */
+/* uncompress name to newname in-process, return 0 on success */
 
-Boolean
-uncompress_file(char *name)
+static int
+uncompress_to(char *name, char *newname)
+{
+    int		    fd, ret;
+    struct stat	    status;
+
+    if (stat(name, &status))
+	return -1;
+    fd = open(newname, O_WRONLY | O_CREAT | O_TRUNC, status.st_mode & 0777);
+    if (fd == -1)
+	return -1;
+    ret = uncompress_to_fd(name, fd);
+    if (close(fd))
+	ret = -1;
+    if (ret)
+	unlink(newname);
+    return ret;
+}
+
+/*
+ * Find the file name, or name with another or without a .gz, .Z or .z
+ * suffix. Return False, if none exists. Store the name without the suffix
+ * in plainname.
+ */
+
+static Boolean
+find_file(char *name, char *plainname)
 {
-    char	    plainname[PATH_MAX];
-    char	    dirname[PATH_MAX];
     char	    tmpfile[PATH_MAX];
-    char	    unc[PATH_MAX+20];	/* temp buffer for uncompress/gunzip command */
     char	   *c;
     struct stat	    status;
 
@@ -724,6 +777,52 @@ uncompress_file(char *name)
 	}
       }
     }
+    return True;
+}
+
+/*
+ * Open the file name, or name with another or without a .gz, .Z or .z
+ * suffix, for reading. A compressed file is uncompressed in-process, if
+ * possible, and name is changed to the name without the suffix.
+ */
+
+FILE *
+open_file_uncompressed(char *name)
+{
+    char	    plainname[PATH_MAX];
+    FILE	   *fp;
+
+    if (!find_file(name, plainname)) {
+	errno = ENOENT;
+	return NULL;
+    }
+    if (strcmp(name, plainname) != 0) {
+	if ((fp = open_uncompressed(name)) != NULL) {
+	    strcpy(name, plainname);
+	    return fp;
+	}
+	/* e.g., compressed with compress(1) */
+	if (uncompress_file(name) == False) {
+	    errno = ENOENT;
+	    return NULL;
+	}
+    }
+    return fopen(name, "r");
+}
+
+/* gunzip file if necessary */
+
+Boolean
+uncompress_file(char *name)
+{
+    char	    plainname[PATH_MAX];
+    char	    dirname[PATH_MAX];
+    char	    tmpfile[PATH_MAX];
+    char	    unc[PATH_MAX+20];	/* temp buffer for uncompress/gunzip command */
+    char	   *c;
+
+    if (!find_file(name, plainname))
+	return False;
     /* file doesn't have .gz etc suffix anymore, return modified name */
     if (strcmp(name, plainname) == 0) return True;
 
@@ -733,9 +832,13 @@ uncompress_file(char *name)
     else strcpy(dirname, ".");
 
     if (access(dirname, W_OK) == 0) {  /* OK - the directory is writable */
-      sprintf(unc, "gunzip -q %s", name);
-      if (system(unc) != 0)
-	file_msg("Couldn't uncompress the file: \"%s\"", unc);
+      if (uncompress_to(name, plainname) == 0) {
+	unlink(name);
+      } else {
+	sprintf(unc, "gunzip -q %s", name);
+	if (system(unc) != 0)
+	  file_msg("Couldn't uncompress the file: \"%s\"", unc);
+      }
       strcpy(name, plainname);
     } else {  /* the directory is not writable */
       /* create a path to TMPDIR in case we need to uncompress a read-only file to there */
@@ -744,9 +847,11 @@ uncompress_file(char *name)
 	  sprintf(tmpfile, "%s%s", TMPDIR, c);
       else
 	  sprintf(tmpfile, "%s/%s", TMPDIR, plainname);
-      sprintf(unc, "gunzip -q -c %s > %s", name, tmpfile);
-      if (system(unc) != 0)
-	  file_msg("Couldn't uncompress the file: \"%s\"", unc);
+      if (uncompress_to(name, tmpfile) != 0) {
+	  sprintf(unc, "gunzip -q -c %s > %s", name, tmpfile);
+	  if (system(unc) != 0)
+	      file_msg("Couldn't uncompress the file: \"%s\"", unc);
+      }
       file_msg ("Uncompressing file %s in %s because it is in a read-only directory",
 		name, TMPDIR);
       strcpy(name, tmpfile);
@@ -1153,10 +1258,69 @@ strerror(e)
 #endif /* HAVE_STRERROR */
 
 
+/*
+ * Like strtod(), but with a full stop as the decimal point, regardless of the
+ * locale. Used for numbers in PostScript and pdf files, which may be read in
+ * a worker thread, where setlocale() must not be called.
+ */
+double
+strtod_c(const char *s, char **end)
+{
+	const char	*p = s;
+	Boolean		digits = False;
+	int		frac = 0;	/* digits after the decimal point */
+	double		val = 0.0;
+	double		sign = 1.0;
+
+	while (isspace((unsigned char)*p))
+		++p;
+	if (*p == '-' || *p == '+')
+		sign = *p++ == '-' ? -1.0 : 1.0;
+	for (; isdigit((unsigned char)*p); ++p, digits = True)
+		val = 10.0 * val + (*p - '0');
+	if (*p == '.')
+		for (++p; isdigit((unsigned char)*p); ++p, ++frac, digits = True)
+			val = 10.0 * val + (*p - '0');
+	if (!digits) {
+		if (end)
+			*end = (char *)s;
+		return 0.0;
+	}
+	/* dividing once by an exact power of ten rounds correctly */
+	if (frac > 0)
+		val /= pow(10.0, (double)frac);
+	if (*p == 'e' || *p == 'E') {
+		char	*q;
+		long	exp = strtol(p + 1, &q, 10);
+
+		if (q > p + 1 && isdigit((unsigned char)q[-1])) {
+			val *= pow(10.0, (double)exp);
+			p = q;
+		}
+	}
+	if (end)
+		*end = (char *)p;
+	return sign * val;
+}
+
+
 /* for images with no palette, we'll use neural net to reduce to 256 colors with palette */
 
+static Boolean	neu_palette(F_pic *pic);
+
 Boolean
 map_to_palette(F_pic *pic)
+{
+	Boolean	 stat;
+
+	lock_neu();
+	stat = neu_palette(pic);
+	unlock_neu();
+	return stat;
+}
+
+static Boolean
+neu_palette(F_pic *pic)
 {
 	int	 w,h,x,y;
 	int	 mult, neu_stat, size;
@@ -19,6 +19,7 @@
 #ifndef F_UTIL_H
 #define F_UTIL_H
 
+#include <stdio.h>
 #include <X11/Intrinsic.h>	/* Boolean */
 #include <sys/types.h>		/* time_t */
 
@@ -28,6 +29,7 @@ extern char	*xf_basename(char *filename);
 extern int	 emptyfigure(void);
 extern char	*safe_strcpy(char *p1, char *p2);
 extern Boolean	 uncompress_file(char *name);
+extern FILE	*open_file_uncompressed(char *name);
 extern char	*build_command(char *program, char *filename);
 extern Boolean	 map_to_palette(F_pic *pic);
 extern Boolean	 dimline_components(F_compound *dimline, F_line **line,
@@ -37,6 +39,7 @@ extern int	 find_smallest_depth(F_compound *compound);
 extern void	 get_grid_spec(char *grid, Widget minor_grid_panel,
 					Widget major_grid_panel);
 extern time_t	file_timestamp(char *file);
+extern double	strtod_c(const char *s, char **end);
 extern void	map_to_mono(F_pic *pic);
 extern void	read_xfigrc(void);
 extern void	init_settings(void);
@@ -48,6 +51,7 @@ extern int	emptyname_msg(char *name, char *msg);
 extern int	get_directory(char *direct);
 extern int	ok_to_write(char *file_name, char *op_name);
 extern void	remap_imagecolors(void);
+extern Boolean	remapping_colors;
 extern void	update_recent_files(void);
 extern void	update_xfigrc(char *name, char *string);
 extern int	update_fig_files(int argc, char **argv);
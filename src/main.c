@@ -362,6 +362,25 @@ static XtResource application_resources[] = {
       XtOffset(appresPtr, autorefresh), XtRBoolean, (caddr_t) & false},
     {"write_bak", "Refresh",   XtRBoolean, sizeof(Boolean),
       XtOffset(appresPtr, write_bak), XtRBoolean, (caddr_t) & true},
+    {"layer_cache", "Layer_cache", XtRInt, sizeof(int),
+      XtOffset(appresPtr, layer_cache), XtRImmediate, (caddr_t) 0},
+    {"lod_size", "Lod_size", XtRInt, sizeof(int),
+      XtOffset(appresPtr, lod_size), XtRImmediate, (caddr_t) 3},
+    {"prefetch_fonts", "Prefetch_fonts", XtRBoolean, sizeof(Boolean),
+      XtOffset(appresPtr, prefetch_fonts), XtRBoolean, (caddr_t) & true},
+    {"text_cache", "Text_cache", XtRInt, sizeof(int),
+      XtOffset(appresPtr, text_cache), XtRImmediate,
+      (caddr_t) CACHE_SIZE_LIMIT},
+    {"threads", "Threads", XtRInt, sizeof(int),
+      XtOffset(appresPtr, threads), XtRImmediate, (caddr_t) 0},
+    {"gs_jobs", "Gs_jobs", XtRInt, sizeof(int),
+      XtOffset(appresPtr, gs_jobs), XtRImmediate, (caddr_t) 0},
+    {"gs_timeout", "Gs_timeout", XtRInt, sizeof(int),
+      XtOffset(appresPtr, gs_timeout), XtRImmediate, (caddr_t) 30},
+    {"gs_cache", "Gs_cache", XtRInt, sizeof(int),
+      XtOffset(appresPtr, gs_cache), XtRImmediate, (caddr_t) 131072},
+    {"eps_preview", "Eps_preview", XtRBoolean, sizeof(Boolean),
+      XtOffset(appresPtr, eps_preview), XtRBoolean, (caddr_t) & true},
 
 #ifdef I18N
     {"international", "International", XtRBoolean, sizeof(Boolean),
@@ -429,6 +448,9 @@ static XrmOptionDescRec options[] =
     {"-flushleft", ".flushleft", XrmoptionNoArg, "True"},
     {"-freehand_resolution", ".freehand_resolution", XrmoptionSepArg, 0},
     {"-ghostscript", ".ghostscript", XrmoptionSepArg, GSEXE},
+    {"-gs_cache", ".gs_cache", XrmoptionSepArg, 0},
+    {"-gs_jobs", ".gs_jobs", XrmoptionSepArg, 0},
+    {"-gs_timeout", ".gs_timeout", XrmoptionSepArg, 0},
     {"-grid_color", ".grid_color", XrmoptionSepArg, "lightblue"},
     {"-grid_unit", ".grid_unit", XrmoptionSepArg, "default"},
     {"-hiddentext", ".hiddentext", XrmoptionNoArg, "True"},
@@ -445,16 +467,20 @@ static XrmOptionDescRec options[] =
     {"-Landscape", ".landscape", XrmoptionNoArg, "True"},
     {"-landscape", ".landscape", XrmoptionNoArg, "True"},
     {"-latexfonts", ".latexfonts", XrmoptionNoArg, "True"},
+    {"-layer_cache", ".layer_cache", XrmoptionSepArg, 0},
     {"-left", ".justify", XrmoptionNoArg, "False"},
     {"-library_dir", ".library_dir", XrmoptionSepArg, 0},
     {"-library_icon_size", ".library_icon_size", XrmoptionSepArg, 0},
     {"-list_view", ".icon_view", XrmoptionNoArg, "False"},
+    {"-lod_size", ".lod_size", XrmoptionSepArg, 0},
     {"-magnification", ".magnification", XrmoptionSepArg, 0},
     {"-max_image_colors", ".max_image_colors", XrmoptionSepArg, 0},
     {"-metric", ".inches", XrmoptionNoArg, "False"},
     {"-monochrome", ".monochrome", XrmoptionNoArg, "True"},
     {"-multiple", ".multiple", XrmoptionNoArg, "True"},
     {"-nooverlap", ".overlap", XrmoptionNoArg, "False"},
+    {"-noeps_preview", ".eps_preview", XrmoptionNoArg, "False"},
+    {"-noprefetch_fonts", ".prefetch_fonts", XrmoptionNoArg, "False"},
     {"-normalFont", ".normalFont", XrmoptionSepArg, 0},
     {"-noscalablefonts", ".scalablefonts", XrmoptionNoArg, "False"},
     {"-nosplash", ".splash", XrmoptionNoArg, "False"},
@@ -466,6 +492,7 @@ static XrmOptionDescRec options[] =
     {"-pheight", ".pheight", XrmoptionSepArg, 0},
     {"-Portrait", ".landscape", XrmoptionNoArg, "False"},
     {"-portrait", ".landscape", XrmoptionNoArg, "False"},
+    {"-prefetch_fonts", ".prefetch_fonts", XrmoptionNoArg, "True"},
     {"-pwidth", ".pwidth", XrmoptionSepArg, 0},
     {"-right", ".justify", XrmoptionNoArg, "True"},
     {"-rigidtext", ".rigidtext", XrmoptionNoArg, "True"},
@@ -502,6 +529,8 @@ static XrmOptionDescRec options[] =
     {"-startpsFont", ".startpsFont", XrmoptionSepArg, 0},
     {"-starttextstep", ".starttextstep",  XrmoptionSepArg, 0},
     {"-tablet", ".tablet", XrmoptionNoArg, "True"},
+    {"-text_cache", ".text_cache", XrmoptionSepArg, 0},
+    {"-threads", ".threads", XrmoptionSepArg, 0},
     {"-track", ".trackCursor", XrmoptionNoArg, "True"},
     {"-transparent_color", ".transparent", XrmoptionSepArg, 0},
     {"-userscale", ".userscale", XrmoptionSepArg, 0},
@@ -548,6 +577,9 @@ static char *help_list[] = {
 	"[-ghostscript <gsname>] ",
 	"[-grid_color <grid_color>] ",
 	"[-grid_unit <grid_unit>] ",
+	"[-gs_cache <kbytes>] ",
+	"[-gs_jobs <number>] ",
+	"[-gs_timeout <seconds>] ",
 	"[-gslib <gslibrary name>] ",
 	"[-hiddentext] ",
 	"[-dontshowdepthmanager] ",
@@ -562,15 +594,19 @@ static char *help_list[] = {
 	"[-keyFile <file>] ",
 	"[-landscape] ",
 	"[-latexfonts] ",
+	"[-layer_cache <kbytes>] ",
 	"[-left] ",
 	"[-library_dir <directory>] ",
 	"[-library_icon_size <size>] ",
 	"[-list_view] ",
+	"[-lod_size <pixels>] ",
 	"[-magnification <print/export_mag>] ",
 	"[-max_image_colors <number>] ",
 	"[-metric] ",
 	"[-monochrome] ",
 	"[-multiple] ",
+	"[-noeps_preview] ",
+	"[-noprefetch_fonts] ",
 	"[-normalFont <font>] ",
 	"[-noscalablefonts] ",
 	"[-nosplash] ",
@@ -581,6 +617,7 @@ static char *help_list[] = {
 	"[-paper_size <size>] ",
 	"[-pheight <height>] ",
 	"[-portrait] ",
+	"[-prefetch_fonts] ",
 	"[-pwidth <width>] ",
 	"[-right] ",
 	"[-rigidtext] ",
@@ -612,6 +649,8 @@ static char *help_list[] = {
 	"[-startpsFont <font>] ",
 	"[-starttextstep <number>] ",
 	"[-tablet] ",
+	"[-text_cache <kbytes>] ",
+	"[-threads <number>] ",
 	"[-track] ",
 	"[-transparent_color <color number>] ",
 	"[-update file1 file2 ...] ",
@@ -678,6 +717,14 @@ main(int argc, char **argv)
     /* get the TMPDIR environment variable for temporary files */
     if (((TMPDIR = getenv("XFIGTMPDIR")) && !access(TMPDIR, W_OK | X_OK)) ||
 		((TMPDIR = getenv("TMPDIR")) && !access(TMPDIR, W_OK | X_OK))) {
+	/* temporary files are also created in worker threads, while xfig
+	   may change its current directory */
+	if (*TMPDIR != '/' && getcwd(tmpstr, sizeof tmpstr) &&
+		    strlen(tmpstr) + strlen(TMPDIR) + 2 <= sizeof tmpstr) {
+	    strcat(tmpstr, "/");
+	    strcat(tmpstr, TMPDIR);
+	    TMPDIR = strdup(tmpstr);
+	}
 	if (strchr(TMPDIR, '\'')) {
 		fprintf(stderr, "Cannot use a temporary directory with an "
 			"apostrophe (') in its name: %s.\nPlease set the "
@@ -1507,6 +1554,8 @@ main(int argc, char **argv)
         /* appropriately */
 	while (1) {
 	  XtAppNextEvent(tool_app, &event);
+	  /* draw the regions damaged while handling the previous events */
+	  redisplay_damage();
 	  if (event.type == motiontype) {
 	    devmotevt = (XDeviceMotionEvent *) &event;
             devmotevt->axis_data[0] /= tablet_res;
@@ -1556,6 +1605,8 @@ notablet:
     if (xim_ic != NULL) {
       while (1) {
 	XtAppNextEvent(tool_app, &event);
+	/* draw the regions damaged while handling the previous events */
+	redisplay_damage();
 	if (splash_onscreen) {
 	    /* if user presses key or mouse button, clear splash */
 	    if (event.type == KeyPress || event.type == ButtonPress)
@@ -1590,6 +1641,8 @@ notablet:
 
     while (1) {
 	XtAppNextEvent(tool_app, &event);
+	/* draw the regions damaged while handling the previous events */
+	redisplay_damage();
 	if (splash_onscreen) {
 	    /* if user presses key or mouse button, clear splash */
 	    if (event.type == KeyPress || event.type == ButtonPress)
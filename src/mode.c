@@ -26,6 +26,7 @@
 #include "resources.h"
 #include "object.h"
 #include "u_fonts.h"
+#include "u_redraw.h"		/* objects_modified() */
 #include "w_indpanel.h"
 #include "w_msgpanel.h"
 #include "w_setup.h"
@@ -274,6 +275,8 @@ void
 set_modifiedflag(void)
 {
 	figure_modified = 1;
+	/* keep the spatial index and the layer cache right */
+	objects_modified();
 }
 
 void
@@ -114,6 +114,9 @@ typedef struct f_pos {
 	int x, y;
 } F_pos;
 
+/* maximum number of reduced levels of a picture bitmap */
+#define PIC_LEVELS	12
+
 struct _pics {
 	char *file;
 	time_t time_stamp;	/* to see if the file has changed */
@@ -126,6 +129,23 @@ struct _pics {
 	int transp;		/* transparent color
 				   (TRANSP_NONE if none) for GIFs */
 	int refcount;		/* number of references to picture */
+	unsigned char *level[PIC_LEVELS];	/* bitmap reduced by 2, 4, 8,..,
+				   built on demand by create_pic_pixmap() */
+	F_pos level_size[PIC_LEVELS];	/* size of the reduced bitmaps */
+	struct pic_load *load;	/* set while read in the background */
+	F_pos decode_size;	/* size of the bitmap wanted when decoding,
+				   0 for full size, -1 for the size shown */
+	float decode_zoom;	/* zoomscale and picture_size_limit, taken */
+	int decode_limit;	/* when reading was started, for the size
+				   shown; readers may run in a thread */
+	int reduced;		/* bitmap decoded at 1 / 2^reduced of the
+				   size of the image, see read_jpg(), or
+				   the preview of an EPS, see read_eps() */
+	dev_t dev;		/* device and inode of the file on disk */
+	ino_t ino;
+	unsigned checked;	/* load pass of the last timestamp check */
+	struct _pics *hash_next;	/* chain in the hash table by name */
+	struct _pics *inode_next;	/* chain in the hash table by inode */
 	struct _pics *prev;
 	struct _pics *next;
 };
@@ -397,6 +417,7 @@ typedef struct f_spline {
 
 	struct f_shape *sfactors;
 	char *comments;
+	struct f_spline_cache *cache;	/* points last drawn, see u_draw.c */
 	struct f_spline *next;
 } F_spline;
 
@@ -282,6 +282,15 @@ typedef struct _appres {
     Boolean	 crosshair;		/* draw crosshair cursor wherever the pointer is */
     Boolean	 autorefresh;		/* automatically redraw figure when file has changed */
     Boolean	 write_bak;		/* automatically rename current to .bak when saving */
+    int		 layer_cache;		/* kB for pixmaps of the depths, 0 = off */
+    int		 lod_size;		/* objects smaller than this (pixels) are simplified */
+    int		 text_cache;		/* kB for bitmaps of rotated text, 0 = off */
+    Boolean	 prefetch_fonts;	/* load the fonts for the next zoom steps while idle */
+    int		 threads;		/* threads for scaling images, 0 = one per processor */
+    int		 gs_jobs;		/* ghostscript processes for eps/pdf, 0 = one per processor */
+    int		 gs_timeout;		/* seconds for ghostscript to render a picture, 0 = no limit */
+    int		 gs_cache;		/* kB on disk for pictures rendered by ghostscript, 0 = off */
+    Boolean	 eps_preview;		/* show the tiff preview of DOS EPS files at low zoom */
 
 #ifdef I18N
     Boolean	 international;
@@ -313,8 +313,8 @@ void active_compound_bound(F_compound *compound, int *xmin, int *ymin, int *xmax
     }
 }
 
-/* basically, use the code for drawing the ellipse to find its bounds */
-/* From James Tough (see u_draw.c: angle_ellipse() */
+/* scan convert the ellipse to find its bounds */
+/* From James Tough's ellipse generator, formerly in u_draw.c */
 
 void ellipse_bound(F_ellipse *e, int *xmin, int *ymin, int *xmax, int *ymax)
 {
@@ -438,15 +438,19 @@ void line_bound(F_line *l, int *xmin, int *ymin, int *xmax, int *ymax)
 
 void spline_bound(F_spline *s, int *xmin, int *ymin, int *xmax, int *ymax)
 {
+    int		    half_wd;
+
     if (approx_spline(s))
 	approx_spline_bound(s, xmin, ymin, xmax, ymax);
     else
 	general_spline_bound(s, xmin, ymin, xmax, ymax);
 
-    *xmax += s->thickness>>1;
-    *xmin -= s->thickness>>1;
-    *ymax += s->thickness>>1;
-    *ymin -= s->thickness>>1;
+    /* the thickness is in 1/80 inch */
+    half_wd = s->thickness / 2.0 * ZOOM_FACTOR;
+    *xmax += half_wd;
+    *xmin -= half_wd;
+    *ymax += half_wd;
+    *ymin -= half_wd;
 
     /* now add in the arrow (if any) boundaries */
     arrow_bound(O_SPLINE, (F_line *)s, xmin, ymin, xmax, ymax);
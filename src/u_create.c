@@ -455,11 +455,23 @@ struct _pics *
 create_picture_entry(void)
 {
     struct _pics *picture;
+    int		  i;
 
     picture = malloc(sizeof(struct _pics));
 
     picture->file = NULL;
     picture->bitmap = NULL;
+    for (i = 0; i < PIC_LEVELS; ++i)
+	picture->level[i] = NULL;
+    picture->load = NULL;
+    picture->decode_size.x = picture->decode_size.y = 0;
+    picture->decode_zoom = 0.0f;
+    picture->decode_limit = 0;
+    picture->reduced = 0;
+    picture->dev = 0;
+    picture->ino = 0;
+    picture->checked = 0;
+    picture->hash_next = picture->inode_next = NULL;
     picture->transp = TRANSP_NONE;
     picture->numcols = 0;
     picture->refcount = 0;
@@ -557,6 +569,7 @@ create_spline(void)
     s->tagged = 0;
     s->next = NULL;
     s->comments = NULL;
+    s->cache = NULL;
     return s;
 }
 
@@ -572,6 +585,7 @@ copy_spline(F_spline *s)
     /* copy static items first */
     *spline = *s;
     spline->next = NULL;
+    spline->cache = NULL;
 
     /* do comments next */
     copy_comments(&s->comments, &spline->comments);
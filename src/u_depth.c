@@ -0,0 +1,197 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2015 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+/*
+ * Index of all primitive objects of a figure, bucketed by depth.
+ *
+ * redisplay_objects() used to walk every object list once per depth, which
+ * is O(depths x objects). The index is built in a single walk over the
+ * object tree and then gives, for each depth, the objects to draw in the
+ * same order as the old per-depth walk. It is invalidated by add_depth(),
+ * remove_depth(), the list_add_*() and list_delete_*() routines and the
+ * functions that save, restore or swap the depth counts. In addition, the
+ * head pointers of the root compound are compared on each access, which
+ * catches a compound being opened or closed, or a figure being swapped in
+ * by undo. The index is rebuilt lazily, on the next access.
+ */
+
+#include "fig.h"
+#include "resources.h"
+#include "object.h"
+#include "u_depth.h"
+#include "w_msgpanel.h"
+
+struct depth_index {
+	F_compound	*root;
+	/* the list heads of root when the index was built */
+	F_arc		*arcs;
+	F_compound	*compounds;
+	F_ellipse	*ellipses;
+	F_line		*lines;
+	F_spline	*splines;
+	F_text		*texts;
+	unsigned	generation;
+	Boolean		valid;
+	int		min, max;	/* min = -1, if empty */
+	F_depth_bucket	bucket[MAX_DEPTH + 1];
+};
+
+/*
+ * Keep one index for the figure, and one for any other compound passed
+ * to redisplay_objects(), e.g., the parent of an open compound, or a
+ * library object being placed.
+ */
+static struct depth_index	figure_index, other_index;
+static unsigned			depth_generation = 0;
+
+static void	index_compound(struct depth_index *idx, F_compound *c);
+
+void
+invalidate_depth_index(void)
+{
+	++depth_generation;
+}
+
+static void
+add_to_bucket(struct depth_index *idx, int depth, int type, void *obj)
+{
+	F_depth_bucket	*b;
+
+	if (depth < 0)
+		depth = 0;
+	else if (depth > MAX_DEPTH)
+		depth = MAX_DEPTH;
+	b = &idx->bucket[depth];
+	if (b->num >= b->size) {
+		int		n = b->size ? 2 * b->size : 16;
+		F_depth_obj	*tmp;
+
+		if ((tmp = realloc(b->objs, n * sizeof(F_depth_obj))) == NULL) {
+			put_msg("Running out of memory.");
+			return;
+		}
+		b->objs = tmp;
+		b->size = n;
+	}
+	b->objs[b->num].type = type;
+	b->objs[b->num].depth = depth;
+	b->objs[b->num].obj = obj;
+	++b->num;
+	if (idx->min == -1 || depth < idx->min)
+		idx->min = depth;
+	if (depth > idx->max)
+		idx->max = depth;
+}
+
+/*
+ * The objects of a compound are drawn in this order: arcs, compounds,
+ * ellipses, lines, splines and texts.
+ */
+static void
+index_compound(struct depth_index *idx, F_compound *c)
+{
+	F_arc		*a;
+	F_compound	*cc;
+	F_ellipse	*e;
+	F_line		*l;
+	F_spline	*s;
+	F_text		*t;
+
+	for (a = c->arcs; a != NULL; a = a->next)
+		add_to_bucket(idx, a->depth, O_ARC, a);
+	for (cc = c->compounds; cc != NULL; cc = cc->next)
+		index_compound(idx, cc);
+	for (e = c->ellipses; e != NULL; e = e->next)
+		add_to_bucket(idx, e->depth, O_ELLIPSE, e);
+	for (l = c->lines; l != NULL; l = l->next)
+		add_to_bucket(idx, l->depth, O_POLYLINE, l);
+	for (s = c->splines; s != NULL; s = s->next)
+		add_to_bucket(idx, s->depth, O_SPLINE, s);
+	for (t = c->texts; t != NULL; t = t->next)
+		add_to_bucket(idx, t->depth, O_TXT, t);
+}
+
+static struct depth_index *
+get_index(F_compound *root)
+{
+	struct depth_index	*idx;
+	int			i;
+
+	idx = root == &objects ? &figure_index : &other_index;
+
+	if (idx->valid && idx->root == root &&
+			idx->generation == depth_generation &&
+			idx->arcs == root->arcs &&
+			idx->compounds == root->compounds &&
+			idx->ellipses == root->ellipses &&
+			idx->lines == root->lines &&
+			idx->splines == root->splines &&
+			idx->texts == root->texts)
+		return idx;
+
+	/* rebuild; keep the memory allocated for the buckets */
+	if (idx->valid && idx->min > -1)
+		for (i = idx->min; i <= idx->max; ++i)
+			idx->bucket[i].num = 0;
+	idx->min = idx->max = -1;
+	index_compound(idx, root);
+
+	idx->root = root;
+	idx->arcs = root->arcs;
+	idx->compounds = root->compounds;
+	idx->ellipses = root->ellipses;
+	idx->lines = root->lines;
+	idx->splines = root->splines;
+	idx->texts = root->texts;
+	idx->generation = depth_generation;
+	idx->valid = True;
+	if (appres.DEBUG)
+		fprintf(stderr, "depth index rebuilt, depths %d to %d\n",
+				idx->min, idx->max);
+	return idx;
+}
+
+/*
+ * Return the bucket of objects at the given depth within root.
+ * The pointer is valid until the next change of the object lists.
+ */
+F_depth_bucket *
+depth_bucket(F_compound *root, int depth)
+{
+	struct depth_index	*idx = get_index(root);
+
+	if (depth < 0 || depth > MAX_DEPTH)
+		return NULL;
+	if (idx->min == -1 || depth < idx->min || depth > idx->max)
+		return NULL;
+	return &idx->bucket[depth];
+}
+
+/*
+ * Return the minimum and maximum depth of the objects within root.
+ * Return False, if root does not contain any object.
+ */
+Boolean
+depth_range(F_compound *root, int *min, int *max)
+{
+	struct depth_index	*idx = get_index(root);
+
+	*min = idx->min;
+	*max = idx->max;
+	return idx->min > -1;
+}
@@ -0,0 +1,43 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2015 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+#ifndef U_DEPTH_H
+#define U_DEPTH_H
+
+/*
+ * One entry of the depth index: a primitive object (not a compound),
+ * its type, O_ARC, O_ELLIPSE, O_POLYLINE, O_SPLINE or O_TXT, and depth.
+ */
+typedef struct f_depth_obj {
+	int		type;
+	int		depth;
+	void		*obj;
+} F_depth_obj;
+
+/* all primitive objects at one depth, in drawing order */
+typedef struct f_depth_bucket {
+	F_depth_obj	*objs;
+	int		num;
+	int		size;
+} F_depth_bucket;
+
+extern void		invalidate_depth_index(void);
+extern F_depth_bucket	*depth_bucket(F_compound *root, int depth);
+extern Boolean		depth_range(F_compound *root, int *min, int *max);
+
+#endif /* U_DEPTH_H */
@@ -20,8 +20,10 @@
  *
  */
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <X11/Intrinsic.h> /* includes X11/Xlib.h */	/* Boolean */
 #include <X11/ImUtil.h>	/* must first include X11/Xlib.h */
@@ -31,7 +33,8 @@
 #include "mode.h"
 #include "object.h"
 #include "d_text.h"		/* reload_text_fstruct() */
-#include "f_util.h"		/* xf_basename() */
+#include "f_picobj.h"		/* enlarge_picobj() */
+#include "f_util.h"		/* xf_basename(), remap_imagecolors() */
 #include "u_bound.h"		/* <obj>_bound(), overlapping() */
 #include "u_draw.h"
 #include "u_geom.h"		/* compute_angle() */
@@ -42,12 +45,17 @@
 #include "w_msgpanel.h"		/* put_msg() */
 #include "w_util.h"		/* NUM_ARROW_TYPES */
 #include "u_redraw.h"		/* redisplay_line() */
+#include "u_threads.h"		/* parallel_rows() */
 #include "w_cursor.h"		/* reset_cursor() */
 #include "xfig_math.h"
 
 static Boolean add_point(int x, int y);
 static void init_point_array(void);
 static Boolean add_closepoint(void);
+static void simplify_point_array(void);
+static Boolean draw_lod(int xmin, int ymin, int xmax, int ymax, int op,
+		int depth, int thickness, int fill_style, int pen_color,
+		int fill_color);
 
 /* the spline definition stuff has been moved to u_draw_spline.c */
 #include "u_draw_spline.c"
@@ -172,7 +180,13 @@ static struct _arrow_shape arrow_shapes[NUM_ARROW_TYPES] = {
 static int	npoints;
 static zXPoint *points = NULL;
 static int	max_points = 0;
-static int	allocstep = 200;
+/*
+ * The point array grows by doubling its size. Once it is larger than
+ * POINTS_KEEP points, it is shrunk back before the next object is drawn,
+ * so that a single huge object does not hold on to its memory.
+ */
+#define		POINTS_MIN	256
+#define		POINTS_KEEP	16384
 static char     bufx[10];	/* for appres.shownums */
 
 /* these are for the arrowheads */
@@ -186,7 +200,6 @@ static int	    nfpts, nbpts, nffillpts, nbfillpts;
 void clip_arrows (F_line *obj, int objtype, int op, int skip);
 void draw_arrow (F_line *obj, F_arrow *arrow, zXPoint *points, int npoints, zXPoint *points2, int npoints2, int op);
 void debug_depth (int depth, int x, int y);
-void newpoint (float xp, float yp);
 void draw_arcbox (F_line *line, int op);
 void draw_pic_pixmap (F_line *box, int op);
 void create_pic_pixmap (F_line *box, int rotation, int width, int height, int flipped);
@@ -197,6 +210,17 @@ static void
 init_point_array(void)
 {
   npoints = 0;
+  if (max_points > POINTS_KEEP) {
+      zXPoint *tmp_p;
+
+      if ((tmp_p = realloc(points, POINTS_KEEP * sizeof(zXPoint))) != NULL) {
+	  points = tmp_p;
+	  max_points = POINTS_KEEP;
+	  if (appres.DEBUG)
+	      fprintf(stderr,"init_point_array - shrink to %d points\n",
+			POINTS_KEEP);
+      }
+  }
 }
 
 static Boolean
@@ -205,22 +229,18 @@ add_point(int x, int y)
 	if (npoints >= max_points) {
 	    int tmp_n;
 	    zXPoint *tmp_p;
-	    tmp_n = max_points + allocstep;
-	    /* too many points, return false */
-	    if (tmp_n > MAXNUMPTS) {
+
+	    tmp_n = max_points == 0 ? POINTS_MIN : 2 * max_points;
+	    if (tmp_n < max_points ||
+		    (size_t)tmp_n > (size_t)-1 / sizeof(zXPoint)) {
 		if (appres.DEBUG)
-		    fprintf(stderr,"add_point - reached MAXNUMPTS (%d)\n",tmp_n);
+		    fprintf(stderr,"add_point - cannot grow beyond %d points\n",
+				max_points);
 		return False;
 	    }
-	    if (max_points == 0) {
-		tmp_p = (zXPoint *) malloc(tmp_n * sizeof(zXPoint));
-		if (appres.DEBUG)
-		    fprintf(stderr,"add_point - alloc %d points\n",tmp_n);
-	    } else {
-		tmp_p = (zXPoint *) realloc(points, tmp_n * sizeof(zXPoint));
-		if (appres.DEBUG)
-		    fprintf(stderr,"add_point - realloc %d points\n",tmp_n);
-	    }
+	    tmp_p = (zXPoint *) realloc(points, tmp_n * sizeof(zXPoint));
+	    if (appres.DEBUG)
+		fprintf(stderr,"add_point - alloc %d points\n",tmp_n);
 	    if (tmp_p == NULL) {
 		fprintf(stderr,
 		      "xfig: insufficient memory to allocate point array\n");
@@ -239,12 +259,171 @@ y)
 	return True;
 }
 
+/* simplify the drawing of small objects, see draw_lod() */
+#define LOD_ACTIVE	(appres.lod_size > 0 && display_zoomscale < 1.0)
+
 void draw_point_array(Window w, int op, int depth, int line_width, int line_style, float style_val, int join_style, int cap_style, int fill_style, int pen_color, int fill_color)
 {
+	if (LOD_ACTIVE)
+		simplify_point_array();
 	pw_lines(w, points, npoints, op, depth, line_width, line_style, style_val,
 		    join_style, cap_style, fill_style, pen_color, fill_color);
 }
 
+/*************** LEVEL OF DETAIL ****************/
+
+/*
+ * When zoomed far out, many objects cover only a few pixels, and the
+ * points of polylines and tessellated splines pile up on the same pixels.
+ * With appres.lod_size > 0 and a zoom below 100%, objects whose width and
+ * height are both less than lod_size pixels are drawn as a box in their
+ * colors, like greek_text() does for text, or as a dot, or not at all, if
+ * smaller than a pixel; and point arrays with more points than pixels they
+ * cover are simplified to within half a pixel before they are drawn.
+ * At normal and larger zoom, all objects are drawn in full detail, see
+ * LOD_ACTIVE.
+ */
+
+static char	*lod_keep = NULL;
+static int	*lod_stack = NULL;
+static int	lod_max = 0;
+
+/* Douglas-Peucker simplification of points[] with a tolerance of 0.5 pixel */
+static void
+simplify_point_array(void)
+{
+	int	i, n, first, last, top, imax;
+	int	xmin, ymin, xmax, ymax;
+	double	dx, dy, len2, d, dmax, tol2;
+
+	if (npoints < 4)
+		return;
+	/* only worth it if there are more points than pixels to draw */
+	xmin = xmax = points[0].x;
+	ymin = ymax = points[0].y;
+	for (i = 1; i < npoints; ++i) {
+		xmin = min2(xmin, points[i].x);
+		xmax = max2(xmax, points[i].x);
+		ymin = min2(ymin, points[i].y);
+		ymax = max2(ymax, points[i].y);
+	}
+	if (npoints <= (xmax - xmin + ymax - ymin) * zoomscale)
+		return;
+
+	if (npoints > lod_max) {
+		char	*k;
+		int	*st;
+
+		if ((k = realloc(lod_keep, npoints)) == NULL)
+			return;
+		lod_keep = k;
+		if ((st = realloc(lod_stack, 2 * npoints * sizeof(int))) == NULL)
+			return;
+		lod_stack = st;
+		lod_max = npoints;
+	}
+
+	tol2 = 0.25 / (zoomscale * zoomscale);
+	for (i = 1; i < npoints - 1; ++i)
+		lod_keep[i] = 0;
+	lod_keep[0] = lod_keep[npoints - 1] = 1;
+	top = 0;
+	lod_stack[top++] = 0;
+	lod_stack[top++] = npoints - 1;
+	while (top > 0) {
+		last = lod_stack[--top];
+		first = lod_stack[--top];
+		if (last - first < 2)
+			continue;
+		dx = points[last].x - points[first].x;
+		dy = points[last].y - points[first].y;
+		len2 = dx * dx + dy * dy;
+		dmax = 0.0;
+		imax = first;
+		for (i = first + 1; i < last; ++i) {
+			double	px = points[i].x - points[first].x;
+			double	py = points[i].y - points[first].y;
+
+			if (len2 == 0.0) {	/* closed, first == last */
+				d = px * px + py * py;
+			} else {
+				d = dx * py - dy * px;
+				d = d * d / len2;
+			}
+			if (d > dmax) {
+				dmax = d;
+				imax = i;
+			}
+		}
+		if (dmax > tol2) {
+			lod_keep[imax] = 1;
+			lod_stack[top++] = first;
+			lod_stack[top++] = imax;
+			lod_stack[top++] = imax;
+			lod_stack[top++] = last;
+		}
+	}
+	for (i = n = 0; i < npoints; ++i)
+		if (lod_keep[i])
+			points[n++] = points[i];
+	if (appres.DEBUG)
+		fprintf(stderr, "simplify_point_array - %d of %d points\n",
+				n, npoints);
+	npoints = n;
+	/* do not keep the buffers of a huge object */
+	if (lod_max > POINTS_KEEP) {
+		free(lod_keep);
+		free(lod_stack);
+		lod_keep = NULL;
+		lod_stack = NULL;
+		lod_max = 0;
+	}
+}
+
+/*
+ * Draw an object with the bounding box (xmin, ymin), (xmax, ymax) in its
+ * simplified form, if it is small enough. Return True, if it was drawn.
+ */
+static Boolean
+draw_lod(int xmin, int ymin, int xmax, int ymax, int op, int depth,
+	 int thickness, int fill_style, int pen_color, int fill_color)
+{
+	double	wd, ht;
+	zXPoint	box[5];
+
+	if (!LOD_ACTIVE || appres.shownums)
+		return False;
+	wd = (xmax - xmin) * zoomscale;
+	ht = (ymax - ymin) * zoomscale;
+	if (wd >= appres.lod_size || ht >= appres.lod_size)
+		return False;
+
+	/* smaller than a pixel, a dot will do */
+	if (wd < 1.0 && ht < 1.0) {
+		if (thickness > 0)
+			pw_point(canvas_win, (xmin + xmax) / 2,
+				(ymin + ymax) / 2, op, depth, thickness,
+				pen_color, CAP_BUTT);
+		else if (fill_style != UNFILLED)
+			pw_point(canvas_win, (xmin + xmax) / 2,
+				(ymin + ymax) / 2, op, depth, 1,
+				fill_color, CAP_BUTT);
+		return True;
+	}
+
+	/* a pattern would not be visible, use the fill color */
+	if (fill_style >= NUMSHADEPATS + NUMTINTPATS)
+		fill_style = NUMSHADEPATS - 1;
+	box[0].x = box[3].x = box[4].x = xmin;
+	box[1].x = box[2].x = xmax;
+	box[0].y = box[1].y = box[4].y = ymin;
+	box[2].y = box[3].y = ymax;
+	pw_lines(canvas_win, box, 5, op, depth, thickness > 0 ? 1 : 0,
+			SOLID_LINE, 0.0, JOIN_MITER, CAP_BUTT, fill_style,
+			pen_color, fill_color);
+	return True;
+}
+
 /*********************** ARC ***************************/
 
 void draw_arc(F_arc *a, int op)
@@ -259,6 +438,9 @@ void draw_arc(F_arc *a, int op)
     if (!overlapping(ZOOMX(xmin), ZOOMY(ymin), ZOOMX(xmax), ZOOMY(ymax),
 		     clip_xmin, clip_ymin, clip_xmax, clip_ymax))
 	return;
+    if (draw_lod(xmin, ymin, xmax, ymax, op, a->depth, a->thickness,
+		a->fill_style, a->pen_color, a->fill_color))
+	return;
 
     rx = a->point[0].x - a->center.x;
     ry = a->center.y - a->point[0].y;
@@ -291,6 +473,33 @@ void draw_arc(F_arc *a, int op)
 	/* restore original clip window */
 	set_clip_window(clip_xmin, clip_ymin, clip_xmax, clip_ymax);
     }
+
+    /* solid arcs without arrowheads are drawn by the server, but the
+       outline of a pie wedge needs the joins at the center */
+    if (a->style == SOLID_LINE && a->for_arrow == NULL &&
+	    a->back_arrow == NULL &&
+	    (a->type == T_OPEN_ARC ||
+	     (a->type == T_PIE_WEDGE_ARC && a->thickness == 0))) {
+	double	angle1, angle2;
+
+	angle1 = atan2(rcy - a->point[0].y, a->point[0].x - rcx);
+	angle2 = atan2(rcy - a->point[2].y, a->point[2].x - rcx) - angle1;
+	if (a->direction) {		/* counter-clockwise */
+	    if (angle2 <= 0.0)
+		angle2 += 2*M_PI;
+	} else if (angle2 >= 0.0) {
+	    angle2 -= 2*M_PI;
+	}
+	pw_arc(canvas_win, round(rcx - radius), round(rcy - radius),
+		2 * radius, round(angle1 * 180. / M_PI * 64.),
+		round(angle2 * 180. / M_PI * 64.),
+		a->type == T_PIE_WEDGE_ARC, op, a->depth, a->thickness,
+		a->style, a->style_val, a->fill_style, a->pen_color,
+		a->fill_color, a->cap_style);
+	debug_depth(a->depth,a->point[0].x,a->point[0].y);
+	return;
+    }
+
     /* fill points array but don't display the points yet */
 
     curve(canvas_win, a->depth,
@@ -340,6 +549,9 @@ void draw_ellipse(F_ellipse *e, int op)
     if (!overlapping(ZOOMX(xmin), ZOOMY(ymin), ZOOMX(xmax), ZOOMY(ymax),
 		     clip_xmin, clip_ymin, clip_xmax, clip_ymax))
 	return;
+    if (draw_lod(xmin, ymin, xmax, ymax, op, e->depth, e->thickness,
+		e->fill_style, e->pen_color, e->fill_color))
+	return;
 
     if (e->angle != 0.0) {
 	angle_ellipse(e->center.x, e->center.y, e->radiuses.x, e->radiuses.y,
@@ -376,202 +588,96 @@ add_closepoint(void)
 }
 
 /*
- *  An Ellipse Generator.
- *  Written by James Tough   7th May 92
- *
- *  The following routines displays a filled ellipse on the screen from the
- *    semi-minor axis 'a', semi-major axis 'b' and angle of rotation
- *    'phi'.
- *
- *  It works along these principles .....
- *
- *        The standard ellipse equation is
- *
- *             x*x     y*y
- *             ---  +  ---
- *             a*a     b*b
- *
- *
- *        Rotation of a point (x,y) is well known through the use of
- *
- *            x' = x*COS(phi) - y*SIN(phi)
- *            y' = y*COS(phi) + y*COS(phi)
- *
- *        Taking these to together, this gives the equation for a rotated
- *      ellipse centered around the origin.
- *
- *           [x*COS(phi) - y*SIN(phi)]^2   [x*SIN(phi) + y*COS(phi)]^2
- *           --------------------------- + ---------------------------
- *                      a*a                           b*b
- *
- *        NOTE -  some of the above equation can be precomputed, eg,
- *
- *              i = COS(phi)/a        and        j = SIN(phi)/b
- *
- *        NOTE -  y is constant for each line so,
- *
- *              m = -yk*SIN(phi)/a    and     n = yk*COS(phi)/b
- *              where yk stands for the kth line ( y subscript k)
- *
- *        Where yk=y, we get a quadratic,
- *
- *              (i*x + m)^2 + (j*x + n)^2 = 1
- *
- *        Thus for any particular line, y, there is two corresponding x
- *      values. These are the roots of the quadratic. To get the roots,
- *      the above equation can be rearranged using the standard method,
- *
- *          -(i*m + j*n) +- sqrt[i^2 + j^2 - (i*n -j*m)^2]
- *      x = ----------------------------------------------
- *                           i^2 + j^2
- *
- *        NOTE -  again much of this equation can be precomputed.
- *
- *           c1 = i^2 + j^2
- *           c2 = [COS(phi)*SIN(phi)*(a-b)]
- *           c3 = [b*b*(COS(phi)^2) + a*a*(SIN(phi)^2)]
- *           c4 = a*b/c3
- *
- *      x = c2*y +- c4*sqrt(c3 - y*y),    where +- must be evaluated once
- *                                      for plus, and once for minus.
- *
- *        We also need to know how large the ellipse is. This condition
- *      arises when the sqrt of the above equation evaluates to zero.
- *      Thus the height of the ellipse is give by
- *
- *              sqrt[ b*b*(COS(phi)^2) + a*a*(SIN(phi)^2) ]
- *
- *       which just happens to be equal to sqrt(c3).
- *
- *         It is now possible to create a routine that will scan convert
- *       the ellipse on the screen.
- *
- *        NOTE -  c2 is the gradient of the new ellipse axis.
- *                c4 is the new semi-minor axis, 'a'.
- *           sqr(c3) is the new semi-major axis, 'b'.
- *
- *         These values could be used in a 4WS or 8WS ellipse generator
- *       that does not work on rotation, to give the feel of a rotated
- *       ellipse. These ellipses are not very accurate and give visable
- *       bumps along the edge of the ellipse. However, these routines
- *       are very quick, and give a good approximation to a rotated ellipse.
- *
- *       NOTES on the code given.
- *
- *           All the routines take there parameters as ( x, y, a, b, phi ),
- *           where x,y are the center of the ellipse ( relative to the
- *           origin ), a and b are the vertical and horizontal axis, and
- *           phi is the angle of rotation in RADIANS.
- *
- *           The 'moveto(x,y)' command moves the screen cursor to the
- *               (x,y) point.
- *           The 'lineto(x,y)' command draws a line from the cursor to
- *               the point (x,y).
- *
+ * Rotated ellipses are drawn as polygons. The number of vertices, a power
+ * of two, is chosen such that the polygon deviates from the ellipse by
+ * less than a quarter of a pixel. The sines and cosines of the vertex
+ * angles are computed once for each number of vertices, and kept.
  */
 
+#define		TRIG_MINLOG	3	/* at least 8 vertices */
+#define		TRIG_MAXLOG	14	/* at most 16384 vertices */
+
+static struct trig_table {
+	double	*c;
+	double	*s;
+} trig_tables[TRIG_MAXLOG + 1] = {{NULL, NULL}};
 
 /*
- *  QuickEllipse, uses the same method as Ellipse, but uses incremental
- *    methods to reduce the amount of work that has to be done inside
- *    the main loop. The speed increase is very noticeable.
- *
- *  Written by James Tough
- *  7th May 1992
- *
+ * Return the table of sine and cosine values for n = 2^l equidistant
+ * angles, or NULL if it cannot be allocated.
  */
-
-static int	x[MAXNUMPTS/4][4],y[MAXNUMPTS/4][4];
-static int	nump[4];
-static int	totpts,i,j;
-static int	order[4]={0,1,3,2};
+static struct trig_table *
+trig_table(int l)
+{
+	struct trig_table	*t = &trig_tables[l];
+	int			k, n = 1 << l;
+
+	if (t->c != NULL)
+		return t;
+	if ((t->c = malloc(2 * n * sizeof(double))) == NULL)
+		return NULL;
+	t->s = t->c + n;
+	for (k = 0; k < n; ++k) {
+		t->c[k] = cos(2. * M_PI * k / n);
+		t->s[k] = sin(2. * M_PI * k / n);
+	}
+	if (appres.DEBUG)
+		fprintf(stderr, "trig_table - %d angles\n", n);
+	return t;
+}
 
 void angle_ellipse(int center_x, int center_y, int radius_x, int radius_y, float angle, int op, int depth, int thickness, int style, float style_val, int fill_style, int pen_color, int fill_color)
 {
-	float	xcen, ycen, a, b;
-
-	double	c1, c2, c3, c4, c5, c6, v1, cphi, sphi, cphisqr, sphisqr;
-	double	xleft, xright, d, asqr, bsqr;
-	int	ymax, yy=0;
-	int	k,m,dir;
+	double	xcen, ycen, a, b, r;
+	double	cphi, sphi, u, v;
+	int	k, l, n;
 	float	savezoom;
 	int	savexoff, saveyoff;
+	struct trig_table	*t;
 
 	if (radius_x == 0 || radius_y == 0)
 		return;
 
-	/* adjust for zoomscale so we iterate over zoomed pixels */
+	/* adjust for zoomscale so we compute zoomed pixels */
 	xcen = ZOOMX(center_x);
 	ycen = ZOOMY(center_y);
 	a = radius_x*zoomscale;
 	b = radius_y*zoomscale;
+
+	/*
+	 * The sagitta of a polygon with n vertices on a circle of radius r
+	 * is about r/2 * (PI/n)^2. Require n >= PI * sqrt(2 r).
+	 */
+	r = max2(fabs(a), fabs(b));
+	for (l = TRIG_MINLOG; l < TRIG_MAXLOG && (1 << l) < M_PI * sqrt(2. * r);
+			++l)
+		;
+	if ((t = trig_table(l)) == NULL)
+		return;
+	n = 1 << l;
+
 	savezoom = zoomscale;
 	savexoff = zoomxoff;
 	saveyoff = zoomyoff;
 	zoomscale = 1.0;
 	zoomxoff = zoomyoff = 0;
 
+	/* the y-axis points downwards, hence a positive angle turns the ellipse
+	   counter-clockwise on the screen */
 	cphi = cos((double)angle);
 	sphi = sin((double)angle);
-	cphisqr = cphi*cphi;
-	sphisqr = sphi*sphi;
-	asqr = a*a;
-	bsqr = b*b;
-
-	c1 = (cphisqr/asqr)+(sphisqr/bsqr);
-	c2 = ((cphi*sphi/asqr)-(cphi*sphi/bsqr))/c1;
-	c3 = (bsqr*cphisqr) + (asqr*sphisqr);
-	ymax = sqrt(c3);
-	c4 = a*b/c3;
-	c5 = 0;
-	v1 = c4*c4;
-	c6 = 2*v1;
-	c3 = c3*v1-v1;
-	totpts = 0;
-	for (i=0; i<=3; i++)
-		nump[i]=0;
-	i=0; j=0;
-	/* odd first points */
-	if (ymax % 2) {
-		d = sqrt(c3);
-		newpoint(xcen-d,ycen);
-		newpoint(xcen+d,ycen);
-		c5 = c2;
-		yy=1;
-	}
-	while (c3>=0) {
-		d = sqrt(c3);
-		xleft = c5-d;
-		xright = c5+d;
-		newpoint(xcen+xleft,ycen+yy);
-		newpoint(xcen+xright,ycen+yy);
-		newpoint(xcen-xright,ycen-yy);
-		newpoint(xcen-xleft,ycen-yy);
-		c5+=c2;
-		v1+=c6;
-		c3-=v1;
-		yy=yy+1;
-	}
-	dir=0;
-	totpts++;	/* add another point to join with first */
 	init_point_array();
-	/* now go down the 1st column, up the 2nd, down the 4th
-	   and up the 3rd to get the points in the correct order */
-	for (k=0; k<=3; k++) {
-	    if (dir==0)
-		for (m=0; m<nump[k]; m++) {
-		    if (!add_point(x[m][order[k]],y[m][order[k]]))
-			break;
-		}
-	    else
-		for (m=nump[k]-1; m>=0; m--) {
-		    if (!add_point(x[m][order[k]],y[m][order[k]]))
+	for (k = 0; k < n; ++k) {
+		u = a * t->c[k];
+		v = b * t->s[k];
+		if (!add_point(round(xcen + u*cphi + v*sphi),
+					round(ycen - u*sphi + v*cphi))) {
+			too_many_points();
 			break;
 		}
-	    dir = 1-dir;
-	} /* next k */
+	}
 	/* add another point to join with first */
-	if (!add_point(points[0].x,points[0].y))
+	if (!add_closepoint())
 		too_many_points();
 	draw_point_array(canvas_win, op, depth, thickness, style, style_val,
 		 JOIN_BEVEL, CAP_ROUND, fill_style, pen_color, fill_color);
@@ -579,29 +685,6 @@ void angle_ellipse(int center_x, int center_y, int radius_x, int radius_y, float
 	zoomscale = savezoom;
 	zoomxoff = savexoff;
 	zoomyoff = saveyoff;
-	return;
-}
-
-/* store the points across (row-wise in) the matrix */
-
-void newpoint(float xp, float yp)
-{
-    if (totpts >= MAXNUMPTS/4) {
-	if (totpts == MAXNUMPTS/4) {
-	    put_msg("Too many points to fully display rotated ellipse. %d points max",
-		MAXNUMPTS);
-	    totpts++;
-	}
-	return;
-    }
-    x[i][j]=round(xp);
-    y[i][j]=round(yp);
-    nump[j]++;
-    totpts++;
-    if (++j > 3) {
-	j=0;
-	i++;
-    }
 }
 
 
@@ -620,6 +703,11 @@ void draw_line(F_line *line, int op)
     if (!overlapping(ZOOMX(xmin), ZOOMY(ymin), ZOOMX(xmax), ZOOMY(ymax),
 		     clip_xmin, clip_ymin, clip_xmax, clip_ymax))
 	return;
+    /* a small picture is shown as a filled box, as on an inactive layer */
+    if (draw_lod(xmin, ymin, xmax, ymax, op, line->depth, line->thickness,
+		line->type == T_PICTURE ? NUMSHADEPATS-1 : line->fill_style,
+		line->pen_color, line->fill_color))
+	return;
 
     /* is it an arcbox? */
     if (line->type == T_ARCBOX) {
@@ -832,6 +920,8 @@ void draw_pic_pixmap(F_line *box, int op)
 	box->pic->pix_flipped != box->pic->flipped)
 	    create_pic_pixmap(box, rotation, width, height, box->pic->flipped);
 
+    /* the picture is copied directly, draw any pending lines first */
+    flush_draw_batch();
     if (box->pic->mask) {
       /* mask is in rectangle (xmin,ymin)...(xmax,ymax)
          clip to rectangle (clip_xmin,clip_ymin)...(clip_xmax,clip_ymax) */
@@ -882,6 +972,86 @@ void draw_pic_pixmap(F_line *box, int op)
     XFlush(tool_d);
 }
 
+/*
+ * Return a bitmap that is half as wide and half as high as the w x h bitmap
+ * src. Take every second pixel of every second row, such that colormap
+ * indices, the transparent color and the bits of monochrome bitmaps keep
+ * their meaning. Only the rgb quadruples (bpp == 4) are averaged.
+ * A bpp of 0 denotes one bit per pixel, with rows padded to full bytes.
+ */
+
+static unsigned char *
+reduce_bitmap(unsigned char *src, int w, int h, int bpp)
+{
+    unsigned char  *dst, *s, *d;
+    int		    nw = w / 2, nh = h / 2;
+    int		    x, y, k;
+    size_t	    sbpl, dbpl;
+
+    if (bpp == 0) {
+	sbpl = (w + 7) / 8;
+	dbpl = (nw + 7) / 8;
+    } else {
+	sbpl = (size_t)w * bpp;
+	dbpl = (size_t)nw * bpp;
+    }
+    if ((dst = calloc(dbpl * nh, 1)) == NULL)
+	return NULL;
+
+    for (y = 0; y < nh; y++) {
+	s = src + 2 * y * sbpl;
+	d = dst + y * dbpl;
+	if (bpp == 0) {
+	    for (x = 0; x < nw; x++)
+		if (s[x / 4] & (1 << (7 - ((2 * x) & 7))))
+		    d[x / 8] |= 1 << (7 - (x & 7));
+	} else if (bpp == 4) {
+	    for (x = 0; x < nw; x++, s += 8, d += 4)
+		for (k = 0; k < 4; k++)
+		    d[k] = (s[k] + s[k + 4] + s[sbpl + k] + s[sbpl + k + 4]
+				    + 2) / 4;
+	} else {
+	    for (x = 0; x < nw; x++)
+		d[x] = s[2 * x];
+	}
+    }
+    return dst;
+}
+
+/*
+ * Return the smallest bitmap of the picture that still has at least
+ * sw columns and sh rows, and return its size in cwidth, cheight.
+ * The reduced bitmaps of the picture form a pyramid, each level half the
+ * size of the one above. Levels are only built when first needed, and all
+ * of them together take at most a third of the memory of the original.
+ */
+
+static unsigned char *
+pic_level(struct _pics *pics, int bpp, int sw, int sh, int *cwidth, int *cheight)
+{
+    unsigned char  *bitmap = pics->bitmap;
+    int		    w = pics->bit_size.x, h = pics->bit_size.y;
+    int		    i;
+
+    for (i = 0; i < PIC_LEVELS && w / 2 >= sw && h / 2 >= sh; i++) {
+	if (pics->level[i] == NULL) {
+	    if ((pics->level[i] = reduce_bitmap(bitmap, w, h, bpp)) == NULL)
+		break;
+	    pics->level_size[i].x = w / 2;
+	    pics->level_size[i].y = h / 2;
+	    if (appres.DEBUG)
+		fprintf(stderr, "Reduced picture %s to %dx%d pixels\n",
+				pics->file, w / 2, h / 2);
+	}
+	bitmap = pics->level[i];
+	w = pics->level_size[i].x;
+	h = pics->level_size[i].y;
+    }
+    *cwidth = w;
+    *cheight = h;
+    return bitmap;
+}
+
 /*
  * The input to this routine is the bitmap read from the source
  * image file. That input bitmap has an arbitrary number of rows
@@ -892,19 +1062,175 @@ void draw_pic_pixmap(F_line *box, int op)
 
 #define	ALLOC_PIC_ERR "Can't alloc memory for image: %s"
 
+/*
+ * Sampling a picture bitmap into the data of a pixmap. The rows of the
+ * pixmap are independent and are done in parallel, see parallel_rows().
+ * Pixel i in row j of the pixmap is taken from bitmap + yoff[j] + xoff[i],
+ * and is written right away to its place in the rotated or flipped pixmap.
+ */
+
+struct pic_scale {
+    unsigned char  *bitmap;		/* the source bitmap */
+    size_t	   *xoff, *yoff;	/* offsets of source columns and rows */
+    unsigned char  *xmask, *ymask;	/* monochrome, bit of the source pixel,
+					   per column or per row */
+    unsigned char  *data;		/* the pixmap */
+    size_t	    bpl;		/* bytes per line of the pixmap */
+    int		    width, height;
+    Boolean	    hswap, vswap;	/* mirror rows or columns */
+    int		    image_bpp;		/* bytes per pixel of the pixmap */
+    Boolean	    direct;		/* argb quadruples, no colormap */
+    Boolean	    endian;		/* big endian */
+    unsigned char  *mask;		/* transparency mask, or NULL */
+    int		    bwidth;		/* bytes per line of the mask */
+    unsigned char   transp;		/* transparent color */
+    unsigned char   lut[MAX_COLORMAP_SIZE][4];	/* pixel bytes per color */
+};
+
+static void
+scale_mono_rows(void *arg, int first, int last)
+{
+    struct pic_scale *s = arg;
+    unsigned char  *src, *dst, bit;
+    int		    i, j, col;
+
+    for (j = first; j < last; j++) {
+	src = s->bitmap + s->yoff[j];
+	dst = s->data + (s->vswap ? s->height - j - 1 : j) * s->bpl;
+	for (i = 0; i < s->width; i++) {
+	    bit = s->xmask ? s->xmask[i] : s->ymask[j];
+	    if (src[s->xoff[i]] & bit) {
+		col = s->hswap ? s->width - i - 1 : i;
+		dst[col / 8] |= 1 << (col & 7);
+	    }
+	}
+    }
+}
+
+static void
+scale_color_rows(void *arg, int first, int last)
+{
+    struct pic_scale *s = arg;
+    unsigned char  *src, *dst, *cpixel;
+    int		    i, j, row;
+    ptrdiff_t	    step;
+
+    for (j = first; j < last; j++) {
+	src = s->bitmap + s->yoff[j];
+	row = s->vswap ? s->height - j - 1 : j;
+	dst = s->data + row * s->bpl;
+	step = s->image_bpp;
+	if (s->hswap) {
+	    dst += (s->width - 1) * step;
+	    step = -step;
+	}
+
+	/* if this pixel is the transparent color then clear the mask pixel */
+	if (s->mask)
+	    for (i = 0; i < s->width; i++)
+		if (src[s->xoff[i]] == s->transp)
+		    clr_mask_bit(row, s->hswap ? s->width - i - 1 : i,
+				    s->bwidth, s->mask);
+
+	if (s->direct) {
+	    /* the bytes of the argb quadruple, swapped on big-endian machines */
+	    if (s->endian) {
+		for (i = 0; i < s->width; i++, dst += step) {
+		    cpixel = src + s->xoff[i];
+		    dst[0] = cpixel[3];
+		    dst[1] = cpixel[2];
+		    dst[2] = cpixel[1];
+		    dst[3] = cpixel[0];
+		}
+	    } else {
+		for (i = 0; i < s->width; i++, dst += step)
+		    memcpy(dst, src + s->xoff[i], 4);
+	    }
+	    continue;
+	}
+
+	/* constant sizes, such that memcpy() becomes a single move */
+	switch (s->image_bpp) {
+	case 4:
+	    for (i = 0; i < s->width; i++, dst += step)
+		memcpy(dst, s->lut[src[s->xoff[i]]], 4);
+	    break;
+	case 3:
+	    for (i = 0; i < s->width; i++, dst += step)
+		memcpy(dst, s->lut[src[s->xoff[i]]], 3);
+	    break;
+	case 2:
+	    for (i = 0; i < s->width; i++, dst += step)
+		memcpy(dst, s->lut[src[s->xoff[i]]], 2);
+	    break;
+	default:
+	    for (i = 0; i < s->width; i++, dst += step)
+		*dst = s->lut[src[s->xoff[i]]][0];
+	    break;
+	}
+    }
+}
+
+/*
+ * Fill lut with the bytes that go into the pixmap for each color of the
+ * colormap, in the order the X server expects them.
+ */
+
+static void
+fill_pixel_lut(struct pic_scale *s, struct Cmap *cmap)
+{
+    unsigned char  *l, *p, byte;
+    unsigned int    lpixel;
+    unsigned short  spixel;
+    int		    c;
+
+    for (c = 0; c < MAX_COLORMAP_SIZE; c++) {
+	l = s->lut[c];
+	if (s->image_bpp == 4) {
+	    lpixel = (unsigned int)cmap[c].pixel;
+	    memcpy(l, &lpixel, 4);
+	    /* swap the 4 bytes on big-endian machines */
+	    if (s->endian) {
+		byte = l[0]; l[0] = l[3]; l[3] = byte;
+		byte = l[1]; l[1] = l[2]; l[2] = byte;
+	    }
+	} else if (s->image_bpp == 3) {
+	    p = (unsigned char *)&(cmap[c].pixel);
+	    /* note which endian */
+	    if (s->endian) {
+		l[2] = p[0];
+		l[1] = p[1];
+		l[0] = p[2];
+	    } else {
+		l[0] = p[0];
+		l[1] = p[1];
+		l[2] = p[2];
+	    }
+	} else if (s->image_bpp == 2) {
+	    spixel = (unsigned short)cmap[c].pixel;
+	    memcpy(l, &spixel, 2);
+	    /* swap the 2 bytes on big-endian machines */
+	    if (s->endian) {
+		byte = l[0]; l[0] = l[1]; l[1] = byte;
+	    }
+	} else {
+	    l[0] = (unsigned char)cmap[c].pixel;
+	}
+    }
+}
+
 void create_pic_pixmap(F_line *box, int rotation, int width, int height, int flipped)
 {
-    int		    cwidth, cheight;
-    int		    i,j,k;
-    int		    bwidth;
-    unsigned char  *data, *tdata, *mask;
-    int		    bbytes;
-    int		    ibit, jbit;
-    int		    wbit;
+    struct _pics   *pics = box->pic->pic_cache;
+    struct pic_scale *s;
+    int		    cwidth, cheight, cbpp;
+    int		    i,j;
+    unsigned char  *bitmap, *data, *mask;
+    size_t	    bbytes, cbpl, ibit;
     int		    fg, bg;
-    size_t	    jnb, nbytes;
+    size_t	    nbytes;
     XImage	   *image;
-    Boolean	    type1,hswap,vswap;
+    Boolean	    type1;
 
     /* this could take a while */
     set_temp_cursor(wait_cursor);
@@ -916,8 +1242,47 @@ void create_pic_pixmap(F_line *box, int rotation, int width, int height, int fli
     if (appres.DEBUG)
 	fprintf(stderr,"Scaling pic pixmap to %dx%d pixels\n",width,height);
 
-    cwidth = box->pic->pic_cache->bit_size.x;	/* current width, height */
-    cheight = box->pic->pic_cache->bit_size.y;
+    /*
+     * See comments (around XPutPixel() ?) in
+     * http://gitlab.freedesktop.org/xorg/libX11/src/ImUtil.c,
+     * where it is assumed that all formats have bits_per_pixel <= 32,
+     * where bits_per_pixel is a field in struct XVisualInfo.
+     */
+    if (pics->numcols == 0)
+	    /* monochrome, one bit per pixel */
+	    cbpp = 0;
+    else if (tool_vclass == TrueColor && image_bpp == 4 && pics->numcols <= 0)
+	    /* no colormap, argb quadruples */
+	    cbpp = 4;
+    else
+	    cbpp = 1;
+
+    /* rows of the bitmap become rows (type1) or columns of the pixmap */
+    type1 = (!flipped && (rotation == 0 || rotation == 180)) ||
+		(flipped && !(rotation == 0 || rotation == 180));
+
+    /* a picture decoded at a reduced size may now be too small */
+    if (pics->reduced && (type1 ?
+		width > pics->bit_size.x || height > pics->bit_size.y :
+		height > pics->bit_size.x || width > pics->bit_size.y)) {
+	enlarge_picobj(box->pic, box->pen_color, type1 ? width : height,
+			type1 ? height : width);
+	if (pics->bitmap == NULL) {
+	    box->pic->pixmap = (Pixmap) 0;
+	    box->pic->mask = (Pixmap) 0;
+	    reset_cursor();
+	    return;
+	}
+	/* the new bitmap may come with its own colormap */
+	if (pics->numcols > 0)
+	    remap_imagecolors();
+    }
+
+    /* sample from the smallest reduced bitmap that is still large enough */
+    if (type1)
+	bitmap = pic_level(pics, cbpp, width, height, &cwidth, &cheight);
+    else
+	bitmap = pic_level(pics, cbpp, height, width, &cwidth, &cheight);
 
     box->pic->color = box->pen_color;
     box->pic->pix_rotation = rotation;
@@ -929,81 +1294,77 @@ void create_pic_pixmap(F_line *box, int rotation, int width, int height, int fli
 
     mask = (unsigned char *) 0;
 
+    if ((s = malloc(sizeof(struct pic_scale))) == NULL ||
+	    (s->xoff = malloc(width * sizeof(size_t))) == NULL) {
+	file_msg(ALLOC_PIC_ERR, pics->file);
+	free(s);
+	return;
+    }
+    if ((s->yoff = malloc(height * sizeof(size_t))) == NULL) {
+	file_msg(ALLOC_PIC_ERR, pics->file);
+	free(s->xoff);
+	free(s);
+	return;
+    }
+    s->bitmap = bitmap;
+    s->xmask = s->ymask = NULL;
+    s->width = width;
+    s->height = height;
+    s->mask = NULL;
+
     /* create a new bitmap at the specified size (requires interpolation) */
 
     /* MONOCHROME display OR XBM */
-    if (box->pic->pic_cache->numcols == 0) {
+    if (pics->numcols == 0) {
 	    nbytes = (width + 7) / 8;
 	    bbytes = (cwidth + 7) / 8;
-	    if ((data = (unsigned char *) malloc(nbytes * height)) == NULL) {
-		file_msg(ALLOC_PIC_ERR, box->pic->pic_cache->file);
-		return;
-	    }
-	    if ((tdata = (unsigned char *) malloc(nbytes)) == NULL) {
-		file_msg(ALLOC_PIC_ERR, box->pic->pic_cache->file);
+	    if ((data = (unsigned char *) calloc(nbytes, height)) == NULL ||
+		    (s->xmask = malloc(type1 ? width : height)) == NULL) {
+		file_msg(ALLOC_PIC_ERR, pics->file);
 		free(data);
+		free(s->yoff);
+		free(s->xoff);
+		free(s);
 		return;
 	    }
-	    memset(data, 0, nbytes * height);
-	    if ((!flipped && (rotation == 0 || rotation == 180)) ||
-		(flipped && !(rotation == 0 || rotation == 180))) {
-		for (j = 0; j < height; j++) {
-		    /* check if user pressed cancel button */
-		    if (check_cancel())
-			break;
-		    jbit = cheight * j / height * bbytes;
-		    for (i = 0; i < width; i++) {
-			ibit = cwidth * i / width;
-			wbit = (unsigned char) *(box->pic->pic_cache->bitmap + jbit + ibit / 8);
-			if (wbit & (1 << (7 - (ibit & 7))))
-			    *(data + j * nbytes + i / 8) += (1 << (i & 7));
-		    }
+	    if (type1) {
+		for (j = 0; j < height; j++)
+		    s->yoff[j] = (size_t)cheight * j / height * bbytes;
+		for (i = 0; i < width; i++) {
+		    ibit = (size_t)cwidth * i / width;
+		    s->xoff[i] = ibit / 8;
+		    s->xmask[i] = 1 << (7 - (ibit & 7));
 		}
 	    } else {
+		s->ymask = s->xmask;
+		s->xmask = NULL;
 		for (j = 0; j < height; j++) {
-		    /* check if user pressed cancel button */
-		    if (check_cancel())
-			break;
-		    ibit = cwidth * j / height;
-		    for (i = 0; i < width; i++) {
-			jbit = cheight * i / width * bbytes;
-			wbit = (unsigned char) *(box->pic->pic_cache->bitmap + jbit + ibit / 8);
-			if (wbit & (1 << (7 - (ibit & 7))))
-			    *(data + (height - j - 1) * nbytes + i / 8) += (1 << (i & 7));
-		    }
+		    ibit = (size_t)cwidth * j / height;
+		    s->yoff[j] = ibit / 8;
+		    s->ymask[j] = 1 << (7 - (ibit & 7));
 		}
+		for (i = 0; i < width; i++)
+		    s->xoff[i] = (size_t)cheight * i / width * bbytes;
 	    }
-
+	    s->data = data;
+	    s->bpl = nbytes;
 	    /* horizontal swap */
-	    if (rotation == 180 || rotation == 270)
-		for (j = 0; j < height; j++) {
-		    /* check if user pressed cancel button */
-		    if (check_cancel())
-			break;
-		    jnb = j*nbytes;
-		    memset(tdata, 0, nbytes);
-		    for (i = 0; i < width; i++)
-			if (*(data + jnb + (width - i - 1) / 8) & (1 << ((width - i - 1) & 7)))
-			    *(tdata + i / 8) += (1 << (i & 7));
-		    memcpy(data + j * nbytes, tdata, nbytes);
-		}
-
-	    /* vertical swap */
-	    if ((!flipped && (rotation == 180 || rotation == 270)) ||
-		(flipped && !(rotation == 180 || rotation == 270))) {
-		for (j = 0; j < (height + 1) / 2; j++) {
-		    jnb = j*nbytes;
-		    memcpy(tdata, data + jnb, nbytes);
-		    memmove(data + jnb, data + (height - j - 1) * nbytes, nbytes);
-		    memcpy(data + (height - j - 1) * nbytes, tdata, nbytes);
-		}
-	    }
-
-	    if (box->pic->pic_cache->subtype == T_PIC_XBM) {
+	    s->hswap = rotation == 180 || rotation == 270;
+	    /* vertical swap; the columns of the bitmap, rotated, are read
+	       into the pixmap from the bottom */
+	    s->vswap = (!flipped && (rotation == 180 || rotation == 270)) ||
+			(flipped && !(rotation == 180 || rotation == 270));
+	    if (!type1)
+		s->vswap = !s->vswap;
+
+	    /* if the user cancels, the remaining rows stay blank */
+	    (void) parallel_rows(scale_mono_rows, s, height);
+
+	    if (pics->subtype == T_PIC_XBM) {
 		fg = x_color(box->pen_color);		/* xbm, use object pen color */
 		bg = x_bg_color.pixel;
-	    } else if (box->pic->pic_cache->subtype == T_PIC_EPS ||
-			box->pic->pic_cache->subtype == T_PIC_PDF) {
+	    } else if (pics->subtype == T_PIC_EPS ||
+			pics->subtype == T_PIC_PDF) {
 		fg = black_color.pixel;			/* pbm from gs is inverted */
 		bg = white_color.pixel;
 	    } else {
@@ -1014,7 +1375,7 @@ void create_pic_pixmap(F_line *box, int rotation, int width, int height, int fli
 	    box->pic->pixmap = XCreatePixmapFromBitmapData(tool_d, canvas_win,
 					(char *)data, width, height, fg,bg, tool_dpth);
 	    free(data);
-	    free(tdata);
+	    free(s->xmask ? s->xmask : s->ymask);
 
       /* EPS, PCX, XPM, GIF, PNG or JPEG on *COLOR* display */
       /* It is important to note that the Cmap pixels are unsigned long. */
@@ -1022,200 +1383,68 @@ void create_pic_pixmap(F_line *box, int rotation, int width, int height, int fli
       /* bpl = bytes per line */
 
       } else {
-	    unsigned char	*pixel, *cpixel, *dst, *src, tmp;
-	    int			 bpl, cbpp, cbpl;
-	    unsigned int	*Lpixel;
-	    unsigned short	*Spixel;
 	    unsigned char	*Cpixel;
-	    struct Cmap		*cmap = box->pic->pic_cache->cmap;
-	    Boolean		 endian;
-	    unsigned char	 byte;
+	    int			 bpl;
 
 	    /* figure what endian machine this is (big=True or little=False) */
-	    endian = True;
+	    s->endian = True;
 	    bpl = 1;
 	    Cpixel = (unsigned char *) &bpl;
 	    /* look at first byte of integer */
 	    if (Cpixel[0] == 1)
-		endian = False;
-
-	    /*
-	     * See comments (around XPutPixel() ?) in
-	     * http://gitlab.freedesktop.org/xorg/libX11/src/ImUtil.c,
-	     * where it is assumed that all formats have bits_per_pixel <= 32,
-	     * where bits_per_pixel is a field in struct XVisualInfo.
-	     */
-	    if (tool_vclass == TrueColor && image_bpp == 4 &&
-			    box->pic->pic_cache->numcols <= 0)
-		    /* no colormap, argb quadruples */
-		    cbpp = 4;
-	    else
-		    cbpp = 1;
-	    cbpl = cwidth * cbpp;
+		s->endian = False;
+
+	    cbpl = (size_t)cwidth * cbpp;
 	    bpl = width * image_bpp;
-	    if ((data = malloc(bpl * height)) == NULL) {
-		file_msg(ALLOC_PIC_ERR,box->pic->pic_cache->file);
+	    if ((data = calloc(bpl, height)) == NULL) {
+		file_msg(ALLOC_PIC_ERR, pics->file);
+		free(s->yoff);
+		free(s->xoff);
+		free(s);
 		return;
 	    }
 	    /* allocate mask for any transparency information */
-	    if (box->pic->pic_cache->subtype == T_PIC_GIF &&
-	        box->pic->pic_cache->transp != TRANSP_NONE) {
+	    if (pics->subtype == T_PIC_GIF && pics->transp != TRANSP_NONE) {
 		    if ((mask = (unsigned char *) malloc((width+7)/8 * height)) == NULL) {
-			file_msg(ALLOC_PIC_ERR,box->pic->pic_cache->file);
+			file_msg(ALLOC_PIC_ERR, pics->file);
 			free(data);
+			free(s->yoff);
+			free(s->xoff);
+			free(s);
 			return;
 		    }
 		    /* set all bits in mask */
-		    for (i = (width+7)/8 * height - 1; i >= 0; i--)
-			*(mask+i)=  (unsigned char) 255;
+		    memset(mask, 255, (width+7)/8 * height);
+		    s->mask = mask;
+		    s->bwidth = (width+7)/8;
+		    s->transp = (unsigned char) pics->transp;
 	    }
-	    bwidth = (width+7)/8;
-	    memset(data, 0, bpl * height);
 
-	    type1 = False;
-	    hswap = False;
-	    vswap = False;
-
-	    if ((!flipped && (rotation == 0 || rotation == 180)) ||
-		(flipped && !(rotation == 0 || rotation == 180)))
-			type1 = True;
-	    /* horizontal swap */
-	    if (rotation == 180 || rotation == 270)
-		hswap = True;
-	    /* vertical swap */
-	    if ((!flipped && (rotation == 90 || rotation == 180)) ||
-		( flipped && (rotation == 90 || rotation == 180)))
-			vswap = True;
-
-	    for( j=0; j<height; j++ ) {
-		  /* check if user pressed cancel button */
-		  if (check_cancel())
-			break;
-
-		if (type1) {
-			src = box->pic->pic_cache->bitmap +
-				(j * cheight / height) * cbpl;
-			dst = data + (j * bpl);
-		} else {
-			src = box->pic->pic_cache->bitmap + (j * cwidth /
-					height) * cbpp;
-			dst = data + (j * bpl);
-		}
-
-		pixel = dst;
-		for( i=0; i<width; i++ ) {
-		    if (type1) {
-			    cpixel = src + (i * cwidth / width) * cbpp;
-		    } else {
-			    cpixel = src + (i * cheight / width * cwidth) * cbpp;
-		    }
-		    /* if this pixel is the transparent color then clear the mask pixel */
-		    if (box->pic->pic_cache->transp != TRANSP_NONE &&
-			(*cpixel==(unsigned char) box->pic->pic_cache->transp)) {
-			  if (type1) {
-			    if (hswap) {
-				if (vswap)
-				    clr_mask_bit(height-j-1,width-i-1,bwidth,mask);
-				else
-				    clr_mask_bit(j,width-i-1,bwidth,mask);
-			    } else {
-				if (vswap)
-				    clr_mask_bit(height-j-1,i,bwidth,mask);
-				else
-				    clr_mask_bit(j,i,bwidth,mask);
-			    }
-			  } else {
-			    if (!vswap) {
-				if (hswap)
-				    clr_mask_bit(j,width-i-1,bwidth,mask);
-				else
-				    clr_mask_bit(j,i,bwidth,mask);
-			    } else {
-				if (hswap)
-				    clr_mask_bit(height-j-1,width-i-1,bwidth,mask);
-				else
-				    clr_mask_bit(height-j-1,i,bwidth,mask);
-			    }
-			  } /* type */
-		    }
-		    if (image_bpp == 4) {
-			Lpixel = (unsigned int *) pixel;
-			if (box->pic->pic_cache->numcols <= 0)
-						/* && tool_v == TrueColor */
-				/* no colormap, rgb color */
-			    *Lpixel = *(unsigned int *)cpixel;
-			else
-			    *Lpixel = (unsigned int)cmap[*cpixel].pixel;
-			/* swap the 4 bytes on big-endian machines */
-			if (endian) {
-			    Cpixel = (unsigned char *) Lpixel;
-			    byte = Cpixel[0]; Cpixel[0] = Cpixel[3]; Cpixel[3] = byte;
-			    byte = Cpixel[1]; Cpixel[1] = Cpixel[2]; Cpixel[2] = byte;
-			}
-		    } else if (image_bpp == 3) {
-			unsigned char *p;
-			p = (unsigned char *)&(cmap[*cpixel].pixel);
-			/* note which endian */
-			if (endian) {
-			    Cpixel = (unsigned char *) pixel+2;
-			    *Cpixel-- = *p++;
-			    *Cpixel-- = *p++;
-			    *Cpixel = *p;
-			} else {
-			    Cpixel = (unsigned char *) pixel;
-			    *Cpixel++ = *p++;
-			    *Cpixel++ = *p++;
-			    *Cpixel = *p;
-			}
-		    } else if (image_bpp == 2) {
-			Spixel = (unsigned short *) pixel;
-			*Spixel = (unsigned short)cmap[*cpixel].pixel;
-			/* swap the 2 bytes on big-endian machines */
-			if (endian) {
-			    Cpixel = (unsigned char *) Lpixel;
-			    byte = Cpixel[0]; Cpixel[0] = Cpixel[1]; Cpixel[1] = byte;
-			}
-		    } else {
-			Cpixel = (unsigned char *) pixel;
-			*Cpixel = (unsigned char)cmap[*cpixel].pixel;
-		    }
-		    /* next pixel position */
-		    pixel += image_bpp;
-		}
+	    if (type1) {
+		for (j = 0; j < height; j++)
+		    s->yoff[j] = (size_t)j * cheight / height * cbpl;
+		for (i = 0; i < width; i++)
+		    s->xoff[i] = (size_t)i * cwidth / width * cbpp;
+	    } else {
+		for (j = 0; j < height; j++)
+		    s->yoff[j] = (size_t)j * cwidth / height * cbpp;
+		for (i = 0; i < width; i++)
+		    s->xoff[i] = (size_t)i * cheight / width * cwidth * cbpp;
 	    }
-
+	    s->data = data;
+	    s->bpl = bpl;
+	    s->image_bpp = image_bpp;
+	    /* no colormap, rgb color */
+	    s->direct = image_bpp == 4 && pics->numcols <= 0;
+	    if (!s->direct)
+		fill_pixel_lut(s, pics->cmap);
 	    /* horizontal swap */
-	    if (hswap) {
-		for( j=0; j<height; j++ ) {
-		  /* check if user pressed cancel button */
-		  if (check_cancel())
-			break;
-		  dst = data + (j * bpl);
-		  src = dst + ((width - 1) * image_bpp);
-		  for( i=0; i<width/2; i++, src -= 2*image_bpp ) {
-		    for( k=0; k<image_bpp; k++, dst++, src++ ) {
-		      tmp = *dst;
-		      *dst = *src;
-		      *src = tmp;
-		    }
-		  }
-		}
-	    }
-
+	    s->hswap = rotation == 180 || rotation == 270;
 	    /* vertical swap */
-	    if (vswap) {
-		for( i=0; i<width; i++ ) {
-		  dst = data + (i * image_bpp);
-		  src = dst + ((height - 1) * bpl);
-		  for( j=0; j<height/2; j++, dst += (width-1)*image_bpp, src -= (width+1)*image_bpp ) {
-		    for( k=0; k<image_bpp; k++, dst++, src++ ) {
-		      tmp = *dst;
-		      *dst = *src;
-		      *src = tmp;
-		    }
-		  }
-		}
-	    }
+	    s->vswap = rotation == 90 || rotation == 180;
+
+	    /* if the user cancels, the remaining rows stay blank */
+	    (void) parallel_rows(scale_color_rows, s, height);
 
 	    image = XCreateImage(tool_d, tool_v, tool_dpth,
 				ZPixmap, 0, (char *)data, width, height, 8, 0);
@@ -1238,6 +1467,9 @@ void create_pic_pixmap(F_line *box, int rotation, int width, int height, int fli
 		free(mask);
 	    }
     }
+    free(s->yoff);
+    free(s->xoff);
+    free(s);
     reset_cursor();
 }
 
@@ -1593,6 +1825,7 @@ void clip_arrows(F_line *obj, int objtype, int op, int skip)
     }
     /* now set the clipping region for the subsequent drawing of the object */
     if (obj->for_arrow || obj->back_arrow) {
+	flush_draw_batch();
 	/* install a temporary error handler to ignore any BadMatch error
 	   from the buggy R5 Xlib XSetRegion() */
 	XSetErrorHandler (tempXErrorHandler);
@@ -2059,7 +2292,7 @@ void redraw_images(F_compound *obj)
 
 void too_many_points(void)
 {
-    put_msg("Too many points, recompile with MAXNUMPTS > %d in w_drawprim.h", MAXNUMPTS);
+    put_msg("Not enough memory to draw all points of the object");
 }
 
 void debug_depth(int depth, int x, int y)
@@ -2081,6 +2314,111 @@ void debug_depth(int depth, int x, int y)
 /* include common spline routines */
 /**********************************/
 
+/*
+ * The points computed for a spline are kept with the spline, together with
+ * its type, a copy of its control points and shape factors and the
+ * precision, which depends on the zoom. On the next redraw, the points are
+ * taken from the cache if the type, control points, shape factors and
+ * precision are the same. The type changes in place, e.g., when an open
+ * spline is closed in toggle_open_closed_spline().
+ * Comparing the control points, instead of hooking all the functions that
+ * modify a spline, also keeps the cache right after undo, which swaps the
+ * contents of two splines.
+ */
+
+struct spline_ctl {
+    int		    x, y;
+    double	    s;
+};
+
+struct f_spline_cache {
+    int		    type;
+    float	    precision;
+    int		    nctl;
+    struct spline_ctl *ctl;
+    int		    npoints;
+    zXPoint	   *points;
+};
+
+void
+free_spline_cache(F_spline *spline)
+{
+    if (spline->cache == NULL)
+	return;
+    free(spline->cache->ctl);
+    free(spline->cache->points);
+    free(spline->cache);
+    spline->cache = NULL;
+}
+
+/* if the points of spline are in the cache, put them into points[] */
+static Boolean
+spline_cached(F_spline *spline, float precision)
+{
+    struct f_spline_cache *c = spline->cache;
+    struct spline_ctl *ctl;
+    F_point	   *p;
+    F_sfactor	   *s;
+    int		    i;
+
+    if (c == NULL || c->type != spline->type || c->precision != precision)
+	return False;
+    for (i = 0, ctl = c->ctl, p = spline->points, s = spline->sfactors;
+		p != NULL && s != NULL && i < c->nctl;
+		++i, ++ctl, p = p->next, s = s->next)
+	if (ctl->x != p->x || ctl->y != p->y || ctl->s != s->s)
+	    return False;
+    if (p != NULL || i != c->nctl)
+	return False;
+
+    init_point_array();
+    for (i = 0; i < c->npoints; ++i)
+	if (!add_point(c->points[i].x, c->points[i].y))
+	    return False;
+    return True;
+}
+
+/* store the points just computed for spline */
+static void
+cache_spline(F_spline *spline, float precision)
+{
+    struct f_spline_cache *c;
+    F_point	   *p;
+    F_sfactor	   *s;
+    int		    n;
+
+    if ((c = spline->cache) == NULL) {
+	if ((c = calloc(1, sizeof(struct f_spline_cache))) == NULL)
+	    return;
+	spline->cache = c;
+    }
+    for (n = 0, p = spline->points; p != NULL; p = p->next)
+	++n;
+    if (n != c->nctl) {
+	free(c->ctl);
+	c->ctl = malloc(n * sizeof(struct spline_ctl));
+    }
+    if (npoints != c->npoints) {
+	free(c->points);
+	c->points = malloc(npoints * sizeof(zXPoint));
+    }
+    if (c->ctl == NULL || c->points == NULL) {
+	free_spline_cache(spline);
+	return;
+    }
+    for (n = 0, p = spline->points, s = spline->sfactors;
+		p != NULL && s != NULL; ++n, p = p->next, s = s->next) {
+	c->ctl[n].x = p->x;
+	c->ctl[n].y = p->y;
+	c->ctl[n].s = s->s;
+    }
+    c->nctl = n;
+    memcpy(c->points, points, npoints * sizeof(zXPoint));
+    c->npoints = npoints;
+    c->type = spline->type;
+    c->precision = precision;
+}
+
 void
 draw_spline(F_spline *spline, int op)
 {
@@ -2094,6 +2432,9 @@ draw_spline(F_spline *spline, int op)
     if (!overlapping(ZOOMX(xmin), ZOOMY(ymin), ZOOMX(xmax), ZOOMY(ymax),
 		     clip_xmin, clip_ymin, clip_xmax, clip_ymax))
 	return;
+    if (draw_lod(xmin, ymin, xmax, ymax, op, spline->depth, spline->thickness,
+		spline->fill_style, spline->pen_color, spline->fill_color))
+	return;
 
     precision = (display_zoomscale < ZOOM_PRECISION) ? LOW_PRECISION
                                                      : HIGH_PRECISION;
@@ -2106,10 +2447,16 @@ draw_spline(F_spline *spline, int op)
 		roman_font, 0.0, bufx, RED, COLOR_NONE);
 	}
     }
-    if (open_spline(spline))
-	success = compute_open_spline(spline, precision);
-    else
-	success = compute_closed_spline(spline, precision);
+    if (spline_cached(spline, precision)) {
+	success = True;
+    } else {
+	if (open_spline(spline))
+	    success = compute_open_spline(spline, precision);
+	else
+	    success = compute_closed_spline(spline, precision);
+	if (success)
+	    cache_spline(spline, precision);
+    }
     if (success) {
 	/* setup clipping so that spline doesn't protrude beyond arrowhead */
 	/* also create the arrowheads */
@@ -37,6 +37,7 @@ void	draw_compoundelements(F_compound *c, int op);
 
 void	draw_spline(F_spline *spline, int op);
 void	quick_draw_spline(F_spline *spline, int operator);
+void	free_spline_cache(F_spline *spline);
 
 /* curve routine needed by arc() and show_boxradius() */
 
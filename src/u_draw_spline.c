@@ -19,6 +19,7 @@
 
 #include "u_draw.h"
 #include "u_list.h"
+#include "u_xspline.h"
 
 /********************* CURVES FOR SPLINES *****************************
 
@@ -39,85 +40,11 @@
 
 /***********************************************************************/
 
-#define Q(s)  (-(s))
 #define EQN_NUMERATOR(dim) \
   (A_blend[0]*p0->dim+A_blend[1]*p1->dim+A_blend[2]*p2->dim+A_blend[3]*p3->dim)
 
 
 
-static inline double
-f_blend(double numerator, double denominator)
-{
-  double p = 2 * denominator * denominator;
-  double u = numerator / denominator;
-  double u2 = u * u;
-
-  return (u * u2 * (10 - p + (2*p - 15)*u + (6 - p)*u2));
-}
-
-static inline double
-g_blend(double u, double q)             /* p equals 2 */
-
-{
-  return(u*(q + u*(2*q + u*(8 - 12*q + u*(14*q - 11 + u*(4 - 5*q))))));
-}
-
-static inline double
-h_blend(double u, double q)
-{
-  double u2=u*u;
-   return (u * (q + u * (2 * q + u2 * (-2*q - u*q))));
-}
-
-static inline
-void negative_s1_influence(double t, double s1, double *A0, double *A2)
-{
-  *A0 = h_blend(-t, Q(s1));
-  *A2 = g_blend(t, Q(s1));
-}
-
-static inline
-void negative_s2_influence(double t, double s2, double *A1, double *A3)
-{
-  *A1 = g_blend(1-t, Q(s2));
-  *A3 = h_blend(t-1, Q(s2));
-}
-
-static inline
-void positive_s1_influence(int k, double t, double s1, double *A0, double *A2)
-{
-  double Tk;
-
-  Tk = k+1+s1;
-  *A0 = (t+k+1<Tk) ? f_blend(t+k+1-Tk, k-Tk) : 0.0;
-
-  Tk = k+1-s1;
-  *A2 = f_blend(t+k+1-Tk, k+2-Tk);
-}
-
-static inline
-void positive_s2_influence(int k, double t, double s2, double *A1, double *A3)
-{
-  double Tk;
-
-  Tk = k+2+s2;
-  *A1 = f_blend(t+k+1-Tk, k+1-Tk);
-
-  Tk = k+2-s2;
-  *A3 = (t+k+1>Tk) ? f_blend(t+k+1-Tk, k+3-Tk) : 0.0;
-}
-
-static inline
-void point_adding(double *A_blend, F_point *p0, F_point *p1, F_point *p2, F_point *p3)
-{
-  double weights_sum;
-
-  weights_sum = A_blend[0] + A_blend[1] + A_blend[2] + A_blend[3];
-  if (!add_point(round(EQN_NUMERATOR(x) / (weights_sum)),
-		 round(EQN_NUMERATOR(y) / (weights_sum))))
-      too_many_points();
-}
-
 static inline
 void point_computing(double *A_blend, F_point *p0, F_point *p1, F_point *p2, F_point *p3, int *x, int *y)
 {
@@ -229,42 +156,29 @@ step_computing(int k, F_point *p0, F_point *p1, F_point *p2, F_point *p3, double
   return (step);
 }
 
+#define XSPLINE_BATCH	64
+
 static void
 spline_segment_computing(float step, int k, F_point *p0, F_point *p1, F_point *p2, F_point *p3, double s1, double s2)
 {
-  double A_blend[4];
-  double t;
-
-  if (s1<0) {
-     if (s2<0) {
-	 for (t=0.0 ; t<1 ; t+=step) {
-	     negative_s1_influence(t, s1, &A_blend[0], &A_blend[2]);
-	     negative_s2_influence(t, s2, &A_blend[1], &A_blend[3]);
-
-	     point_adding(A_blend, p0, p1, p2, p3);
-	 }
-     } else {
-	 for (t=0.0 ; t<1 ; t+=step) {
-	     negative_s1_influence(t, s1, &A_blend[0], &A_blend[2]);
-	     positive_s2_influence(k, t, s2, &A_blend[1], &A_blend[3]);
-
-	     point_adding(A_blend, p0, p1, p2, p3);
-	 }
-     }
-  } else if (s2<0) {
-      for (t=0.0 ; t<1 ; t+=step) {
-	     positive_s1_influence(k, t, s1, &A_blend[0], &A_blend[2]);
-	     negative_s2_influence(t, s2, &A_blend[1], &A_blend[3]);
-
-	     point_adding(A_blend, p0, p1, p2, p3);
-      }
-  } else {
-      for (t=0.0 ; t<1 ; t+=step) {
-	     positive_s1_influence(k, t, s1, &A_blend[0], &A_blend[2]);
-	     positive_s2_influence(k, t, s2, &A_blend[1], &A_blend[3]);
-
-	     point_adding(A_blend, p0, p1, p2, p3);
-      }
+  double t[XSPLINE_BATCH];
+  double tt;
+  int px[4], py[4];
+  int x[XSPLINE_BATCH], y[XSPLINE_BATCH];
+  int i, n;
+
+  px[0] = p0->x; px[1] = p1->x; px[2] = p2->x; px[3] = p3->x;
+  py[0] = p0->y; py[1] = p1->y; py[2] = p2->y; py[3] = p3->y;
+
+  /* evaluate the segment in batches, see u_xspline.c */
+  tt = 0.0;
+  while (tt < 1) {
+      for (n = 0; n < XSPLINE_BATCH && tt < 1; ++n, tt += step)
+	  t[n] = tt;
+      xspline_points(k, s1, s2, px, py, t, n, x, y);
+      for (i = 0; i < n; ++i)
+	  if (!add_point(x[i], y[i]))
+	      too_many_points();
   }
 }
 
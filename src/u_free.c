@@ -25,7 +25,9 @@
 #include <stdlib.h>
 
 #include "object.h"
+#include "f_picobj.h"		/* remove_picobj() */
 #include "u_fonts.h"
+#include "u_draw.h"
 #include "u_free.h"
 #include "w_drawprim.h"
 
@@ -135,6 +137,7 @@ void free_splinestorage(F_spline *s)
 	free((char *) s->back_arrow);
     if (s->comments)
 	free(s->comments);
+    free_spline_cache(s);
     free((char *) s);
 }
 
@@ -160,6 +163,20 @@ void free_linestorage(F_line *l)
     free((char *) l);
 }
 
+/* free the reduced bitmaps of a picture, e.g., before re-reading the file */
+
+void free_picture_levels(struct _pics *picture)
+{
+    int		    i;
+
+    for (i = 0; i < PIC_LEVELS; ++i) {
+	if (picture->level[i]) {
+	    free(picture->level[i]);
+	    picture->level[i] = NULL;
+	}
+    }
+}
+
 void free_picture_entry(struct _pics *picture)
 {
     if (!picture)
@@ -175,8 +192,10 @@ void free_picture_entry(struct _pics *picture)
 	if (appres.DEBUG)
 	    fprintf(stderr,"Delete picture %p %s, refcount = %d\n",
 			    (void *)picture, picture->file, picture->refcount);
+	remove_picobj(picture);
 	if (picture->bitmap)
 	    free((char *) picture->bitmap);
+	free_picture_levels(picture);
 	free(picture->file);
 	/* unlink from list */
 	if (picture->next)
@@ -184,8 +203,8 @@ void free_picture_entry(struct _pics *picture)
 	if (picture->prev)
 	    picture->prev->next = picture->next;
 	/* at the head of the list */
-	if (picture->prev == NULL)
-	    pictures = NULL;
+	else if (pictures == picture)
+	    pictures = picture->next;
 	free(picture);
     } else {
 	if (appres.DEBUG)
@@ -26,6 +26,7 @@ extern void	free_line(F_line **list);
 extern void	free_linestorage(F_line *l);
 extern void	free_linkinfo(F_linkinfo **list);
 extern void	free_picture_entry(struct _pics *picture);
+extern void	free_picture_levels(struct _pics *picture);
 extern void	free_points(F_point *first_point);
 extern void	free_sfactors(F_sfactor *sf);
 extern void	free_spline(F_spline **list);
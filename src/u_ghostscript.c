@@ -21,16 +21,34 @@
  * Autor: Thomas Loimer, 2020.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE		/* pipe2() */
+#endif
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>		/* includes stdint.h */
+#include <limits.h>		/* PATH_MAX */
 #include <math.h>
+#include <poll.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
 #include <X11/X.h>		/* TrueColor */
 
 #ifdef HAVE_GSLIB
@@ -39,19 +57,71 @@
 #include <ghostscript/iapi.h>
 #endif
 
+#include "u_ghostscript.h"
+
 #include "object.h"
 #include "resources.h"
 #include "f_util.h"		/* map_to_pattern(), map_to_mono() */
 #include "w_msgpanel.h"		/* file_msg() */
 
+#define BITMAP_PPI	160	/* the resolution for rendering bitmaps */
+#define GS_ERROR	(-2)
+
 /*
- * Exported functions: gs_mediabox(), gs_bitmap().
- * These are currently only used in f_readeps.c, hence
- * an extra header file is not provided.
+ * The functions below may be called from several threads, see read_eps() and
+ * read_pdf(). gs_lock protects the static state of this file, gslib_lock
+ * serializes calls into the ghostscript library.
  */
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t	gs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	worker_free = PTHREAD_COND_INITIALIZER;
+#ifdef HAVE_GSLIB
+static pthread_mutex_t	gslib_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+#endif
 
-#define BITMAP_PPI	160	/* the resolution for rendering bitmaps */
-#define GS_ERROR	(-2)
+static void
+lock_gs(void)
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&gs_lock);
+#endif
+}
+
+static void
+unlock_gs(void)
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&gs_lock);
+#endif
+}
+
+/*
+ * Read a box, "[llx lly urx ury]", as written by ghostscript, into bb.
+ * Ghostscript always uses full stops as decimal character, and these
+ * functions may run in a worker thread. Hence, use strtod_c().
+ * Return 0 on success, -1 on failure.
+ */
+static int
+parse_mediabox(const char *s, int bb[4])
+{
+	int	i;
+	char	*end;
+	double	val;
+
+	while (*s == ' ' || *s == '\t')
+		++s;
+	if (*s++ != '[')
+		return -1;
+	for (i = 0; i < 4; ++i) {
+		val = strtod_c(s, &end);
+		if (end == s)
+			return -1;
+		bb[i] = (int)(i < 2 ? floor(val) : ceil(val));
+		s = end;
+	}
+	return 0;
+}
 
 /*
  * Link into the ghostscript library.
@@ -112,21 +182,10 @@ static int
 stdout_mediabox(void *caller_handle, const char *str, int len)
 {
 	struct _callback_data	*data = (struct _callback_data *)caller_handle;
-	int	err;
-	double	fbb[4];
 
 	/* This rests on the assumption that ghostscript writes the required
 	   information all at once to str. Should use a buffer, instead. */
-
-	/* gs always uses full stops as decimal character. The locale is already
-	   set to C in read_pdf() */
-	err = sscanf(str, "[%lf %lf %lf %lf]", fbb, fbb+1, fbb+2, fbb+3);
-	if (err == 4) {
-		data->bb[0] = (int)floor(fbb[0]);
-		data->bb[1] = (int)floor(fbb[1]);
-		data->bb[2] = (int)ceil(fbb[2]);
-		data->bb[3] = (int)ceil(fbb[3]);
-	} else {
+	if (parse_mediabox(str, data->bb)) {
 		/* Either the pdf is corrupt, which yields a matching failure,
 		 * or a read error occured or EOF is reached.
 		 * Ghostscript returns with zero from a corrupt pdf, and writes
@@ -215,98 +274,105 @@ gslib(struct _callback_data *data, int (*gs_stdin)(void *, char*, int),
 }
 #endif /* HAVE_GSLIB */
 
+#define	GS_OLD	1	/* gs < 9.50 */
+#define	GS_NEW	2	/* gs >= 9.50 */
+
+static char	gs_revision[24] = "";	/* e.g., 9.50, set by gs_version() */
+
 /*
- * Call ghostscript.
- * Return an open file stream for reading,
- *   *out = popen({exenew, exeold}, "r");
- * The user must call pclose(out) after calling gsexe(&out,...).
- * Use exenew for gs > 9.49, exeold otherwise.
- * Return 0 for success, -1 on failure to call ghostscript.
+ * Call ghostscript to get its version, see gs_version().
  */
 static int
-gsexe(FILE **out, bool *isnew, char *exenew, char *exeold)
+query_version(void)
 {
-#define	old_version	1
-#define	new_version	2
-#define no_version	0
-	static int	version = no_version;
-	const int	failure = -1;
-	char		*exe;
+	int		version;
+	int		n;
+	int		stat;
+	int		major, minor;
+	size_t		len;
+	char		cmd_buf[128];
+	char		*cmd = cmd_buf;
+	const char	version_arg[] = " --version";
 	FILE		*fp;
 
+	if (appres.DEBUG)
+		fprintf(stderr, "Trying to call ghostscript executable %s...\n",
+				appres.ghostscript);
 
-	if (version == no_version) {
-		int		n;
-		int		stat;
-		size_t		len;
-		double		rev;
-		char		cmd_buf[128];
-		char		*cmd = cmd_buf;
-		const char	version_arg[] = " --version";
+	/* get the ghostscript version */
+	/* allocate the command buffer, if necessary */
+	len = strlen(appres.ghostscript) + sizeof version_arg;
+	if (len > sizeof cmd_buf) {
+		if ((cmd = malloc(len)) == NULL)
+			return -1;
+	}
 
-		if (appres.DEBUG)
-			fprintf(stderr,
-				"Trying to call ghostscript executable %s...\n",
-				appres.ghostscript);
+	/* write the command string */
+	sprintf(cmd, "%s%s", appres.ghostscript, version_arg);
+	fp = popen(cmd, "r");
+	if (cmd != cmd_buf)
+		free(cmd);
+	if (fp == NULL)
+		return -1;
 
-		/* get the ghostscript version */
-		/* allocate the command buffer, if necessary */
-		len = strlen(appres.ghostscript) + sizeof version_arg;
-		if (len > sizeof cmd_buf) {
-			if ((cmd = malloc(len)) == NULL)
-				return failure;
-		}
+	/* scan for the ghostscript version, e.g., 9.50 or 10.02.1; read
+	   integers, the locale need not be C */
+	n = fscanf(fp, "%d.%d", &major, &minor);
+	stat = pclose(fp);
+	if (n != 2 || stat != 0)
+		return -1;
 
-		/* write the command string */
-		sprintf(cmd, "%s%s", appres.ghostscript, version_arg);
-		fp = popen(cmd, "r");
-		if (cmd != cmd_buf)
-			free(cmd);
-		if (fp == NULL)
-			return failure;
+	version = major > 9 || (major == 9 && minor > 49) ? GS_NEW : GS_OLD;
+	sprintf(gs_revision, "%d.%02d", major, minor);
+	if (appres.DEBUG)
+		fprintf(stderr, "...version %d.%02d\n", major, minor);
 
-		/* scan for the ghostscript version */
-		/* Currently, gsexe() is only called from gsexe_mediabox(), and
-		 * the locale is already set to C in read_pdf. If this changes,
-		 * make sure to have here the C or POSIX locale. */
-		n = fscanf(fp, "%lf", &rev);
-		stat = pclose(fp);
-		if (n != 1 || stat != 0)
-			return failure;
+	return version;
+}
 
-		if (rev > 9.49) {
-			exe = exenew;
-			version = new_version;
-			*isnew = true;
-		} else {
-			exe = exeold;
-			version = old_version;
-			*isnew = false;
-		}
+/*
+ * Return the version of the ghostscript executable, GS_NEW or GS_OLD,
+ * or -1 if ghostscript cannot be called.
+ */
+static int
+gs_version(void)
+{
+	static int	version = 0;
+	int		ret;
+
+	lock_gs();
+	if (version <= 0)
+		version = query_version();
+	ret = version;
+	unlock_gs();
+	return ret;
+}
 
-		if (appres.DEBUG)
-			fprintf(stderr, "...version %.2f\nCommand line: %s\n",
-					rev, exe);
-	} else { /* version == no_version */
-		if (version == new_version) {
-			exe = exenew;
-			*isnew = true;
-		} else {
-			exe = exeold;
-			*isnew = false;
-		}
-#undef new_version
-#undef old_version
-#undef no_version
+/*
+ * Call ghostscript.
+ * Return an open file stream for reading,
+ *   *out = popen({exenew, exeold}, "r");
+ * The user must call pclose(out) after calling gsexe(&out,...).
+ * Use exenew for gs > 9.49, exeold otherwise.
+ * Return 0 for success, -1 on failure to call ghostscript.
+ */
+static int
+gsexe(FILE **out, bool *isnew, char *exenew, char *exeold)
+{
+	int	version;
+	char	*exe;
 
-		if (appres.DEBUG)
-			fprintf(stderr,
-				"Calling ghostscript.\nCommand line: %s\n",
-				exe);
-	}
+	if ((version = gs_version()) < 0)
+		return -1;
+
+	*isnew = version == GS_NEW;
+	exe = *isnew ? exenew : exeold;
+
+	if (appres.DEBUG)
+		fprintf(stderr, "Calling ghostscript.\nCommand line: %s\n", exe);
 
 	if ((*out = popen(exe, "r")) == NULL)
-		return failure;
+		return -1;
 
 	return 0;
 }
@@ -340,7 +406,8 @@ gsexe_mediabox(char *file, int *llx, int *lly, int *urx, int *ury)
 	char	exeold_buf[sizeof exenew_buf];
 	char	*exenew;
 	char	*exeold;
-	double	bb[4] = { 0.0, 0.0, -1.0, -1.0 };
+	char	line[256];
+	int	bb[4];
 	FILE	*gs_output;
 
 	if (*appres.ghostscript == '\0')
@@ -390,9 +457,9 @@ gsexe_mediabox(char *file, int *llx, int *lly, int *urx, int *ury)
 	}
 
 	/* scan the output */
-	n = fscanf(gs_output, "[%lf %lf %lf %lf]", bb, bb+1, bb+2, bb+3);
+	n = fgets(line, sizeof line, gs_output) ? parse_mediabox(line, bb) : -1;
 	stat = pclose(gs_output);
-	if (n != 4 || stat != 0) {
+	if (n != 0 || stat != 0) {
 		if (stat) {
 			file_msg("Error calling ghostscript. Command:\n%s",
 				isnew ? exenew : exeold);
@@ -402,10 +469,10 @@ gsexe_mediabox(char *file, int *llx, int *lly, int *urx, int *ury)
 		}
 	}
 
-	*llx = (int)floor(bb[0]);
-	*lly = (int)floor(bb[1]);
-	*urx = (int)ceil(bb[2]);
-	*ury = (int)ceil(bb[3]);
+	*llx = bb[0];
+	*lly = bb[1];
+	*urx = bb[2];
+	*ury = bb[3];
 
 	return 0;
 }
@@ -497,6 +564,970 @@ gslib_mediabox(char *file, int *llx, int *lly, int *urx, int *ury)
 }
 #endif /* HAVE_GSLIB */
 
+/*
+ * A ghostscript process that is kept running and is fed one job after the
+ * other, to avoid starting the interpreter for every picture. The worker reads
+ * PostScript from its standard input and writes the rendered pages, as raw
+ * bitmaps, to file descriptor 3. After each job, it writes a line
+ *	%%[xfig <job> ok]	or	%%[xfig <job> <errorname>]
+ * to its standard output. If the worker dies, the job is tried once more with
+ * a new worker. If a job fails, or ghostscript cannot be started, gs_mediabox()
+ * and gs_bitmap() fall back to calling ghostscript for this one picture.
+ * A job that takes longer than appres.gs_timeout seconds stops the worker, and
+ * fails without the fall back.
+ *
+ * Under -dSAFER, ghostscript since 9.50 only reads the files it is permitted
+ * to. The worker may read the files in its own, empty, directory. For each
+ * job, a symbolic link to the picture is put there, and removed afterwards.
+ * Thus, a picture can read itself, but no other file.
+ */
+struct gs_worker {
+	bool		busy;		/* taken by a thread, see take_worker() */
+	pid_t		pid;		/* zero, if not running */
+	FILE		*in;		/* the standard input of ghostscript */
+	int		out;		/* its standard output, non-blocking */
+	int		raster;		/* the rendered pages, non-blocking */
+	bool		mono;		/* renders to the bit device */
+	char		dir[PATH_MAX];	/* the files the worker may read */
+	unsigned long	job;		/* the number of the current job */
+	size_t		linepos;
+	char		line[256];	/* a line read from out */
+	char		reply[256];	/* the last line starting with '[' */
+};
+
+#define	WORKER_GIVE_UP	3	/* do not restart after so many failures */
+#define	MAX_WORKERS	16
+
+/* the pool of workers, protected by gs_lock */
+static struct gs_worker	workers[MAX_WORKERS];
+static int		nworkers = 0;		/* 0: not yet known */
+static int		worker_failures = 0;
+
+/*
+ * Return the number of workers. The resource "gs_jobs" gives the number,
+ * 0 means one per processor.
+ */
+static int
+worker_count(void)
+{
+	long	n = appres.gs_jobs;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	if (n <= 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (n < 1)
+		n = 1;
+	else if (n > MAX_WORKERS)
+		n = MAX_WORKERS;
+	return (int)n;
+}
+
+/*
+ * Take a worker out of the pool, waiting until one is free. Prefer a worker
+ * that is already running.
+ */
+static struct gs_worker *
+take_worker(void)
+{
+	int			i;
+	struct gs_worker	*w;
+
+	lock_gs();
+	if (nworkers == 0)
+		nworkers = worker_count();
+	for (;;) {
+		w = NULL;
+		for (i = 0; i < nworkers; ++i) {
+			if (workers[i].busy)
+				continue;
+			if (workers[i].pid != 0) {
+				w = workers + i;
+				break;
+			}
+			if (w == NULL)
+				w = workers + i;
+		}
+		if (w != NULL)
+			break;
+#ifdef HAVE_PTHREAD
+		pthread_cond_wait(&worker_free, &gs_lock);
+#endif
+	}
+	w->busy = true;
+	unlock_gs();
+	return w;
+}
+
+/* put a worker back into the pool */
+static void
+give_worker(struct gs_worker *w)
+{
+	lock_gs();
+	w->busy = false;
+#ifdef HAVE_PTHREAD
+	pthread_cond_signal(&worker_free);
+#endif
+	unlock_gs();
+}
+
+static void
+worker_stop(struct gs_worker *w)
+{
+	if (w->pid == 0)
+		return;
+	fclose(w->in);
+	close(w->out);
+	close(w->raster);
+	kill(w->pid, SIGTERM);
+	waitpid(w->pid, NULL, 0);
+	w->pid = 0;
+	rmdir(w->dir);
+}
+
+/*
+ * Stop the workers, and remove their directories, when xfig exits. A worker
+ * that is busy is left alone; it ends when xfig exits and its input closes.
+ */
+void
+gs_stop_workers(void)
+{
+	int	i;
+
+	lock_gs();
+	for (i = 0; i < nworkers; ++i)
+		if (!workers[i].busy)
+			worker_stop(workers + i);
+	unlock_gs();
+}
+
+/*
+ * Create a pipe with both ends closed on exec. Other threads may start
+ * processes at any time, these must not inherit the pipes of a worker.
+ */
+static int
+open_pipe(int fd[2])
+{
+#ifdef HAVE_PIPE2
+	return pipe2(fd, O_CLOEXEC);
+#else
+	int	stat;
+
+	/* not atomic, but fork() and exec() in the other threads are rare */
+	if ((stat = pipe(fd)) == 0) {
+		fcntl(fd[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fd[1], F_SETFD, FD_CLOEXEC);
+	}
+	return stat;
+#endif
+}
+
+/*
+ * Start ghostscript, with the pipes set up as described above.
+ * Return 0 on success, -1 on failure.
+ */
+static int
+worker_start(struct gs_worker *w)
+{
+	int		version;
+	int		stat;
+	int		in[2], out[2], raster[2];
+	pid_t		pid;
+	char		cmd[512 + PATH_MAX];
+
+	lock_gs();
+	stat = worker_failures;
+	unlock_gs();
+	if (*appres.ghostscript == '\0' || stat >= WORKER_GIVE_UP)
+		return -1;
+	if ((version = gs_version()) < 0)
+		return -1;
+
+	if ((size_t)snprintf(w->dir, sizeof w->dir, "%s/xfig-gsXXXXXX",
+				TMPDIR) >= sizeof w->dir ||
+			mkdtemp(w->dir) == NULL)
+		return -1;
+
+	/*
+	 * Since gs 9.50, -dSAFER also restricts reading files, permit only
+	 * the files in w->dir, see above. The output file must be given on
+	 * the command line, gs < 9.50 does not allow to change it under
+	 * -dSAFER.
+	 */
+	w->mono = tool_cells <= 2 || appres.monochrome;
+	if ((size_t)snprintf(cmd, sizeof cmd, "exec %s -q -dSAFER -dNOPAUSE "
+			"-dBATCH %s%s%s%s -r%d -sOutputFile=/dev/fd/3 -",
+			appres.ghostscript, w->mono ? "-sDEVICE=bit" :
+				"-sDEVICE=bitrgb -dBlueValues=256",
+			version == GS_NEW ? " \"--permit-file-read=" : "",
+			version == GS_NEW ? w->dir : "",
+			version == GS_NEW ? "/*\"" : "",
+			BITMAP_PPI) >= sizeof cmd) {
+		rmdir(w->dir);
+		return -1;
+	}
+
+	if (open_pipe(in)) {
+		rmdir(w->dir);
+		return -1;
+	}
+	if (open_pipe(out)) {
+		close(in[0]);
+		close(in[1]);
+		rmdir(w->dir);
+		return -1;
+	}
+	if (open_pipe(raster)) {
+		close(in[0]);
+		close(in[1]);
+		close(out[0]);
+		close(out[1]);
+		rmdir(w->dir);
+		return -1;
+	}
+
+	if (appres.DEBUG)
+		fprintf(stderr, "Starting ghostscript worker: %s\n", cmd + 5);
+
+	pid = fork();
+	if (pid == 0) {
+		/* 0, 1 and 2 are open, the pipes are at descriptor 3 or above;
+		   dup2() clears close-on-exec */
+		dup2(in[0], 0);
+		dup2(out[1], 1);
+		if (raster[1] != 3)
+			dup2(raster[1], 3);
+		else
+			fcntl(3, F_SETFD, 0);
+		close(in[1]);
+		close(out[0]);
+		close(raster[0]);
+		if (in[0] > 3)
+			close(in[0]);
+		if (out[1] > 3)
+			close(out[1]);
+		if (raster[1] > 3)
+			close(raster[1]);
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		_exit(127);
+	}
+
+	close(in[0]);
+	close(out[1]);
+	close(raster[1]);
+	if (pid < 0 || (w->in = fdopen(in[1], "w")) == NULL) {
+		close(in[1]);
+		close(out[0]);
+		close(raster[0]);
+		if (pid > 0) {
+			kill(pid, SIGTERM);
+			waitpid(pid, NULL, 0);
+		}
+		rmdir(w->dir);
+		return -1;
+	}
+	fcntl(out[0], F_SETFL, fcntl(out[0], F_GETFL) | O_NONBLOCK);
+	fcntl(raster[0], F_SETFL, fcntl(raster[0], F_GETFL) | O_NONBLOCK);
+
+	w->pid = pid;
+	w->out = out[0];
+	w->raster = raster[0];
+	w->linepos = 0;
+	return 0;
+}
+
+/*
+ * Read the rendered page, as far as available. Store at most size bytes in
+ * buf, count all bytes in *received.
+ * Return 0, or -1 if the worker died.
+ */
+static int
+worker_raster(struct gs_worker *w, unsigned char *buf, size_t size,
+		size_t *received)
+{
+	ssize_t		n;
+	unsigned char	discard[BUFSIZ];
+
+	for (;;) {
+		if (*received < size)
+			n = read(w->raster, buf + *received, size - *received);
+		else
+			n = read(w->raster, discard, sizeof discard);
+		if (n > 0)
+			*received += (size_t)n;
+		else if (n == 0)
+			return -1;
+		else if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return 0;
+		else if (errno != EINTR)
+			return -1;
+	}
+}
+
+/*
+ * Read the standard output of the worker, as far as available, and look for
+ * the line marking the end of the current job.
+ * Return 0 if the job succeeded, 1 if it failed, 2 if the job is not finished,
+ * or -1 if the worker died.
+ */
+static int
+worker_lines(struct gs_worker *w)
+{
+	ssize_t	n;
+	size_t	len;
+	char	*nl;
+	char	marker[32];
+
+	len = (size_t)sprintf(marker, "%%%%[xfig %lu ", w->job);
+	for (;;) {
+		n = read(w->out, w->line + w->linepos,
+				sizeof w->line - 1 - w->linepos);
+		if (n == 0)
+			return -1;
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 2;
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		w->linepos += (size_t)n;
+
+		while ((nl = memchr(w->line, '\n', w->linepos))) {
+			*nl = '\0';
+			if (!strncmp(w->line, marker, len)) {
+				w->linepos = 0;
+				if (!strcmp(w->line + len, "ok]"))
+					return 0;
+				if (appres.DEBUG)
+					fprintf(stderr, "Ghostscript worker, "
+						"error %s\n", w->line + len);
+				return 1;
+			}
+			if (appres.DEBUG)
+				fprintf(stderr, "Ghostscript worker: %s\n",
+						w->line);
+			if (w->line[0] == '[')
+				strcpy(w->reply, w->line);
+			w->linepos -= (size_t)(nl + 1 - w->line);
+			memmove(w->line, nl + 1, w->linepos);
+		}
+		/* discard a line that is too long */
+		if (w->linepos == sizeof w->line - 1)
+			w->linepos = 0;
+	}
+}
+
+/* write the characters of s into a PostScript string */
+static void
+put_pschars(FILE *fp, const char *s)
+{
+	for (; *s; ++s) {
+		if (*s == '(' || *s == ')' || *s == '\\')
+			fprintf(fp, "\\%c", *s);
+		else if ((unsigned char)*s < 32 || (unsigned char)*s > 126)
+			fprintf(fp, "\\%03o", (unsigned int)(unsigned char)*s);
+		else
+			putc(*s, fp);
+	}
+}
+
+/*
+ * Run a job on the worker, restarting the worker once if it died. With page
+ * given as {llx, lly, width, height}, render file to a bitmap of width x
+ * height pixels, and store it in buf. Otherwise, print the /MediaBox of the
+ * pdf file to w->reply. The number of bytes of the bitmap received is
+ * returned in *received.
+ * The job is enclosed in save ... restore, and cleans up the operand and
+ * dictionary stacks. Return 0 on success, -1 on failure, or GS_ERROR if the
+ * job took too long.
+ */
+static int
+worker_job(struct gs_worker *w, const char *file, const int page[4],
+		unsigned char *buf, size_t size, size_t *received)
+{
+	int		tries;
+	int		stat;
+	int		timeout;
+	time_t		deadline;
+	char		link[PATH_MAX];
+	struct pollfd	fds[2];
+
+	if (w->pid != 0 && w->mono != (tool_cells <= 2 || appres.monochrome))
+		worker_stop(w);
+
+	/* the worker does not follow the current directory of xfig, and
+	   read_picture() already resolved the name in the main thread */
+	if (*file != '/') {
+		if (appres.DEBUG)
+			fprintf(stderr, "Ghostscript worker: %s is not an "
+					"absolute path.\n", file);
+		return -1;
+	}
+
+	for (tries = 0; tries < 2; ++tries) {
+		if (w->pid == 0 && worker_start(w))
+			return -1;
+
+		++w->job;
+		*received = 0;
+		w->reply[0] = '\0';
+
+		/* the only file the worker may read, see above */
+		if ((size_t)snprintf(link, sizeof link, "%s/%lu", w->dir,
+					w->job) >= sizeof link ||
+				symlink(file, link))
+			return -1;
+
+		if (page)
+			fprintf(w->in, "<< /PageSize [%d 72 mul %d div %d 72 mul"
+					" %d div] >> setpagedevice\n", page[2],
+					BITMAP_PPI, page[3], BITMAP_PPI);
+		fputs("save countdictstack mark\n"
+			"userdict /showpage {stop} put\n"
+			"userdict /setpagedevice {pop} put\n"
+			"userdict /quit {stop} put\n{ ", w->in);
+		if (page)
+			fprintf(w->in, "%d %d translate ", -page[0], -page[1]);
+		putc('(', w->in);
+		put_pschars(w->in, link);
+		if (page)
+			fputs(") run", w->in);
+		else
+			fputs(") (r) file runpdfbegin 1 pdfgetpage /MediaBox "
+					"pget pop ==", w->in);
+		fputs(" } stopped\n"
+			"{ $error /newerror get { $error /errorname get "
+			"$error /newerror false put } { /ok } ifelse }\n"
+			"{ /ok } ifelse\n"
+			"counttomark 2 add 1 roll cleartomark\n"
+			"countdictstack exch sub { end } repeat exch restore\n",
+			w->in);
+		if (page)
+			fputs("dup /ok eq { showpage } if\n", w->in);
+		fprintf(w->in, "(%%%%[xfig %lu ) print 64 string cvs print "
+				"(]) = flush\n", w->job);
+
+		stat = fflush(w->in) ? -1 : 2;
+		fds[0].fd = w->out;
+		fds[0].events = POLLIN;
+		fds[1].fd = w->raster;
+		fds[1].events = POLLIN;
+		deadline = time(NULL) + appres.gs_timeout;
+		while (stat == 2) {
+			timeout = -1;
+			if (appres.gs_timeout > 0) {
+				time_t	left = deadline - time(NULL);
+
+				if (left <= 0) {
+					stat = 3;
+					break;
+				}
+				timeout = left > INT_MAX / 1000 ? INT_MAX :
+							(int)left * 1000;
+			}
+			if (poll(fds, 2, timeout) < 0) {
+				if (errno != EINTR)
+					stat = -1;
+				continue;
+			}
+			if (fds[1].revents && worker_raster(w, buf, size,
+								received))
+				stat = -1;
+			else if (fds[0].revents)
+				stat = worker_lines(w);
+		}
+		/* the page is written before the marker, collect the rest */
+		if ((stat == 0 || stat == 1) &&
+				worker_raster(w, buf, size, received))
+			stat = -1;
+		unlink(link);
+
+		if (stat == 3) {
+			/* e.g., the picture loops forever; do not try again */
+			file_msg("Ghostscript took longer than %d seconds "
+					"for %s, stopped it.", appres.gs_timeout,
+					file);
+			worker_stop(w);
+			lock_gs();
+			++worker_failures;
+			unlock_gs();
+			return GS_ERROR;
+		}
+		if (stat >= 0) {
+			lock_gs();
+			worker_failures = 0;
+			unlock_gs();
+			return stat == 0 ? 0 : -1;
+		}
+		worker_stop(w);
+		lock_gs();
+		stat = ++worker_failures;
+		unlock_gs();
+		if (stat >= WORKER_GIVE_UP) {
+			if (appres.DEBUG)
+				fputs("Ghostscript worker keeps failing, "
+						"not restarting it.\n", stderr);
+			return -1;
+		}
+		if (appres.DEBUG)
+			fputs("Ghostscript worker died, restarting it.\n",
+					stderr);
+	}
+	return -1;
+}
+
+/*
+ * Store the raw bitmap written by the bit or bitrgb device in pic, in the
+ * format expected by xfig. Takes over raw.
+ * Return 0 on success, -1 on failure.
+ */
+static int
+store_raster(F_pic *pic, unsigned char *raw, int w, int h, const char *file)
+{
+	size_t		n = (size_t)w * (size_t)h;
+	unsigned char	*src, *dst;
+	struct _pics	*pics = pic->pic_cache;
+
+	pics->bit_size.x = w;
+	pics->bit_size.y = h;
+
+	if (tool_cells <= 2 || appres.monochrome) {
+		pics->bitmap = raw;
+		pics->numcols = 0;
+
+	} else if (tool_vclass == TrueColor && image_bpp == 4) {
+		if ((pics->bitmap = malloc(n * image_bpp)) == NULL) {
+			free(raw);
+			file_msg("Out of memory.\nCannot create pixmap for %s.",
+					file);
+			return -1;
+		}
+		/* this should take care of endian-ness */
+		for (src = raw, dst = pics->bitmap; src < raw + 3 * n;
+				src += 3, dst += image_bpp)
+			*(unsigned int *)dst = ((unsigned int)src[0] << 16) +
+				((unsigned int)src[1] << 8) + (unsigned int)src[2];
+		free(raw);
+		pics->numcols = -1;	/* no colormap */
+
+	} else {
+		/* map_to_palette() expects BGR triples, swap the RGB triples */
+		for (src = raw; src < raw + 3 * n; src += 3) {
+			unsigned char	c = src[0];
+			src[0] = src[2];
+			src[2] = c;
+		}
+		pics->bitmap = raw;
+		if (!map_to_palette(pic)) {
+			file_msg("Cannot create colormapped image for %s.",
+					file);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * A cache of rendered pictures on disk, in $XDG_CACHE_HOME/xfig or
+ * ~/.cache/xfig. An entry is keyed by a hash of the content of the picture
+ * file, the ghostscript version and the parameters of the job, e.g., the
+ * resolution and bounding box. The file name of an entry is a hash of the
+ * key, the file starts with the magic line and the key, followed by the raw
+ * data, e.g., the page as written by the bit or bitrgb device. Entries are
+ * touched when used; if the cache grows beyond appres.gs_cache kilobytes, the
+ * entries used least recently are removed. The size of the cache is counted
+ * in cache_total, the directory is only read again when the size exceeds the
+ * limit.
+ */
+#define	CACHE_LIMIT	((off_t)appres.gs_cache * 1024)	/* bytes */
+#define	CACHE_MAGIC	"xfig ghostscript cache 1\n"
+#define	CACHE_SUFFIX	".gsc"
+#define	CACHE_TMP	"tmp"		/* tmpXXXXXX, see cache_put() */
+#define	CACHE_TMP_AGE	3600		/* seconds to keep an unused tmp file */
+
+/* the size of the cache, protected by gs_lock; -1 if not yet known */
+static off_t	cache_total = -1;
+
+/* FNV-1a, 64 bit */
+#define	FNV_OFFSET	UINT64_C(14695981039346656037)
+#define	FNV_PRIME	UINT64_C(1099511628211)
+
+static uint64_t
+fnv_hash(uint64_t h, const unsigned char *s, size_t len)
+{
+	const unsigned char	*end = s + len;
+
+	while (s < end) {
+		h ^= *s++;
+		h *= FNV_PRIME;
+	}
+	return h;
+}
+
+/* write the name of the cache directory to dir, and create it */
+static int
+make_cache_dir(char *dir, size_t size)
+{
+	char		*base;
+	char		*cp;
+
+	if ((base = getenv("XDG_CACHE_HOME")) && *base == '/') {
+		if ((size_t)snprintf(dir, size, "%s/xfig", base) >= size)
+			return -1;
+	} else if ((base = getenv("HOME")) && *base != '\0') {
+		if ((size_t)snprintf(dir, size, "%s/.cache/xfig", base) >= size)
+			return -1;
+	} else {
+		return -1;
+	}
+
+	/* mkdir -p, the leading component exists */
+	for (cp = strchr(dir + 1, '/'); ; cp = strchr(cp + 1, '/')) {
+		if (cp)
+			*cp = '\0';
+		if (mkdir(dir, 0700) && errno != EEXIST) {
+			if (appres.DEBUG)
+				fprintf(stderr, "Cannot create cache directory "
+						"%s: %s\n", dir, strerror(errno));
+			return -1;
+		}
+		if (cp == NULL)
+			break;
+		*cp = '/';
+	}
+	return 0;
+}
+
+/*
+ * Return the cache directory, creating it if necessary,
+ * or NULL if there is none.
+ */
+static const char *
+cache_dir(void)
+{
+	static int	state = 0;	/* 0 not yet tried, -1 none, 1 ok */
+	static char	dir[PATH_MAX];
+	int		ret;
+
+	lock_gs();
+	if (state == 0)
+		state = make_cache_dir(dir, sizeof dir) ? -1 : 1;
+	ret = state;
+	unlock_gs();
+	return ret > 0 ? dir : NULL;
+}
+
+/*
+ * Write the cache key for the content of file and the job given in params
+ * into key. Return 0 on success, -1 on failure. A relative name is not
+ * cached; it would be relative to the current directory of xfig at the
+ * time the file is hashed, not when the picture was requested.
+ */
+static int
+cache_key(char *key, size_t len, const char *file, const char *params)
+{
+	size_t		n;
+	off_t		size = 0;
+	uint64_t	h = FNV_OFFSET;
+	unsigned char	buf[BUFSIZ * 8];
+	FILE		*fp;
+
+	if (*file != '/' || appres.gs_cache <= 0 || cache_dir() == NULL ||
+			gs_version() < 0)
+		return -1;
+	if ((fp = fopen(file, "rb")) == NULL)
+		return -1;
+	while ((n = fread(buf, 1, sizeof buf, fp)) > 0) {
+		h = fnv_hash(h, buf, n);
+		size += (off_t)n;
+	}
+	n = ferror(fp);
+	fclose(fp);
+	if (n)
+		return -1;
+
+	if ((size_t)snprintf(key, len, "%016" PRIx64 " %lld gs-%s %s", h,
+			(long long)size, gs_revision, params) >= len)
+		return -1;
+	return 0;
+}
+
+/* write the file name of the cache entry for key into path */
+static int
+cache_path(char *path, size_t len, const char *key)
+{
+	uint64_t	h = fnv_hash(FNV_OFFSET, (const unsigned char *)key,
+						strlen(key));
+
+	if ((size_t)snprintf(path, len, "%s/%016" PRIx64 CACHE_SUFFIX,
+				cache_dir(), h) >= len)
+		return -1;
+	return 0;
+}
+
+/*
+ * Read the data of the cache entry for key, exactly size bytes, into buf.
+ * Return 0 on success, -1 if there is no such entry.
+ */
+static int
+cache_get(const char *key, void *buf, size_t size)
+{
+	bool	ok;
+	size_t	len = sizeof CACHE_MAGIC - 1 + strlen(key) + 1;
+	char	path[PATH_MAX];
+	char	head[sizeof CACHE_MAGIC + 256];
+	FILE	*fp;
+
+	if (len > sizeof head || cache_path(path, sizeof path, key))
+		return -1;
+	if ((fp = fopen(path, "rb")) == NULL)
+		return -1;
+
+	ok = fread(head, 1, len, fp) == len &&
+		!strncmp(head, CACHE_MAGIC, sizeof CACHE_MAGIC - 1) &&
+		!strncmp(head + sizeof CACHE_MAGIC - 1, key, strlen(key)) &&
+		head[len - 1] == '\n' &&
+		fread(buf, 1, size, fp) == size && getc(fp) == EOF;
+	fclose(fp);
+
+	if (!ok)
+		return -1;
+	/* the modification time tells when the entry was last used */
+	utime(path, NULL);
+	if (appres.DEBUG)
+		fprintf(stderr, "Found %s in the cache, %s\n", key, path);
+	return 0;
+}
+
+struct cache_entry {
+	time_t	used;
+	off_t	size;
+	char	name[24];
+};
+
+static int
+cache_older(const void *a, const void *b)
+{
+	const struct cache_entry	*ea = a;
+	const struct cache_entry	*eb = b;
+
+	return ea->used < eb->used ? -1 : ea->used > eb->used;
+}
+
+/*
+ * Remove the entries used least recently, if the cache is too large. Also
+ * remove temporary files left over, e.g., by a crash, during cache_put().
+ */
+static void
+cache_trim(void)
+{
+	size_t			n = 0;
+	size_t			alloc = 0;
+	size_t			i;
+	off_t			total = 0;
+	char			path[PATH_MAX];
+	const char		*dir = cache_dir();
+	struct cache_entry	*entries = NULL;
+	struct dirent		*d;
+	struct stat		st;
+	DIR			*dp;
+
+	if ((dp = opendir(dir)) == NULL)
+		return;
+	while ((d = readdir(dp))) {
+		size_t	len = strlen(d->d_name);
+
+		if (len == sizeof CACHE_TMP - 1 + 6 &&
+				!strncmp(d->d_name, CACHE_TMP,
+					sizeof CACHE_TMP - 1)) {
+			snprintf(path, sizeof path, "%s/%s", dir, d->d_name);
+			/* not a file still being written */
+			if (stat(path, &st) == 0 && st.st_mtime <
+					time(NULL) - CACHE_TMP_AGE &&
+					unlink(path) == 0 && appres.DEBUG)
+				fprintf(stderr, "Removed %s from the cache.\n",
+						path);
+			continue;
+		}
+		if (len <= sizeof CACHE_SUFFIX - 1 || len >=
+				sizeof entries->name || strcmp(d->d_name + len -
+				(sizeof CACHE_SUFFIX - 1), CACHE_SUFFIX))
+			continue;
+		snprintf(path, sizeof path, "%s/%s", dir, d->d_name);
+		if (stat(path, &st))
+			continue;
+		if (n == alloc) {
+			struct cache_entry	*e;
+
+			alloc = alloc ? 2 * alloc : 64;
+			if ((e = realloc(entries, alloc * sizeof *e)) == NULL)
+				break;
+			entries = e;
+		}
+		entries[n].used = st.st_mtime;
+		entries[n].size = st.st_size;
+		strcpy(entries[n].name, d->d_name);
+		total += st.st_size;
+		++n;
+	}
+	closedir(dp);
+
+	if (total > CACHE_LIMIT) {
+		qsort(entries, n, sizeof *entries, cache_older);
+		/* make some room, do not trim on every new entry */
+		for (i = 0; i < n && total > CACHE_LIMIT / 4 * 3; ++i) {
+			snprintf(path, sizeof path, "%s/%s", dir,
+					entries[i].name);
+			if (unlink(path) == 0)
+				total -= entries[i].size;
+		}
+		if (appres.DEBUG)
+			fprintf(stderr, "Removed %zu entries from the cache.\n",
+					i);
+	}
+	free(entries);
+
+	lock_gs();
+	cache_total = total;
+	unlock_gs();
+}
+
+/* store size bytes of data under key */
+static void
+cache_put(const char *key, const void *data, size_t size)
+{
+	int	fd;
+	bool	ok;
+	bool	trim;
+	char	path[PATH_MAX];
+	char	tmp[PATH_MAX];
+	FILE	*fp;
+
+	if (cache_path(path, sizeof path, key) ||
+			(size_t)snprintf(tmp, sizeof tmp, "%s/" CACHE_TMP
+				"XXXXXX", cache_dir()) >= sizeof tmp)
+		return;
+
+	/* write to a temporary file, and rename it to the entry */
+	if ((fd = mkstemp(tmp)) < 0)
+		return;
+	if ((fp = fdopen(fd, "wb")) == NULL) {
+		close(fd);
+		unlink(tmp);
+		return;
+	}
+	ok = fprintf(fp, "%s%s\n", CACHE_MAGIC, key) > 0 &&
+		fwrite(data, 1, size, fp) == size;
+	if (fclose(fp) || !ok || rename(tmp, path)) {
+		unlink(tmp);
+		return;
+	}
+	if (appres.DEBUG)
+		fprintf(stderr, "Stored %s in the cache, %s\n", key, path);
+
+	/* only read the directory if the cache may be too large */
+	lock_gs();
+	if (cache_total >= 0)
+		cache_total += (off_t)(sizeof CACHE_MAGIC + strlen(key) + size);
+	trim = cache_total < 0 || cache_total > CACHE_LIMIT;
+	unlock_gs();
+	if (trim)
+		cache_trim();
+}
+
+/*
+ * Get the /MediaBox of a pdf file from the cache or the ghostscript worker.
+ * Return 0 on success, -1 on failure, or GS_ERROR if ghostscript took too long.
+ */
+static int
+worker_mediabox(char *file, int *llx, int *lly, int *urx, int *ury)
+{
+	bool	cached;
+	int	bb[4];
+	size_t	received;
+	char	key[256];
+	struct gs_worker	*w;
+
+	cached = cache_key(key, sizeof key, file, "mediabox") == 0;
+	if (!cached || cache_get(key, bb, sizeof bb)) {
+		int	stat;
+
+		w = take_worker();
+		stat = worker_job(w, file, NULL, NULL, (size_t)0, &received);
+		if (stat == 0)
+			stat = parse_mediabox(w->reply, bb);
+		give_worker(w);
+		if (stat)
+			return stat == GS_ERROR ? GS_ERROR : -1;
+		if (cached)
+			cache_put(key, bb, sizeof bb);
+	}
+
+	*llx = bb[0];
+	*lly = bb[1];
+	*urx = bb[2];
+	*ury = bb[3];
+	return 0;
+}
+
+/*
+ * Render a ps/eps/pdf file to a bitmap with the ghostscript worker, or get
+ * the bitmap from the cache. Return 0 on success, -1 on failure, or GS_ERROR
+ * if ghostscript took too long.
+ */
+static int
+worker_bitmap(char *file, F_pic *pic, int llx, int lly, int urx, int ury)
+{
+	bool		cached;
+	int		stat;
+	int		page[4];
+	size_t		size;
+	size_t		received;
+	unsigned char	*raw;
+	char		params[96];
+	char		key[256];
+	struct gs_worker	*w;
+
+	/* the same size as in gsexe_bitmap() */
+	page[0] = llx;
+	page[1] = lly;
+	page[2] = (urx - llx) * BITMAP_PPI / 72 + 1;
+	page[3] = (ury - lly) * BITMAP_PPI / 72 + 1;
+	if (tool_cells <= 2 || appres.monochrome)
+		size = (size_t)((page[2] + 7) / 8) * (size_t)page[3];
+	else
+		size = (size_t)page[2] * (size_t)page[3] * 3;
+
+	if ((raw = malloc(size)) == NULL)
+		return -1;
+
+	sprintf(params, "%s %d ppi, %d %d %d %d", tool_cells <= 2 ||
+			appres.monochrome ? "bit" : "bitrgb", BITMAP_PPI,
+			llx, lly, urx, ury);
+	cached = cache_key(key, sizeof key, file, params) == 0;
+	if (cached && cache_get(key, raw, size) == 0)
+		return store_raster(pic, raw, page[2], page[3], file);
+
+	w = take_worker();
+	stat = worker_job(w, file, page, raw, size, &received);
+	give_worker(w);
+	if (stat) {
+		free(raw);
+		return stat == GS_ERROR ? GS_ERROR : -1;
+	}
+	if (received != size) {
+		if (appres.DEBUG)
+			fprintf(stderr, "Ghostscript worker rendered %zu bytes "
+				"for %s, expected %zu.\n", received, file, size);
+		free(raw);
+		return -1;
+	}
+	if (cached)
+		cache_put(key, raw, size);
+	return store_raster(pic, raw, page[2], page[3], file);
+}
+
 /*
  * Call ghostscript to extract the /MediaBox from the pdf given in file.
  * Return 0 on success, -1 on failure, GS_ERROR (-2) for a ghostscript error.
@@ -506,10 +1537,19 @@ gs_mediabox(char *file, int *llx, int *lly, int *urx, int *ury)
 {
 	int	stat;
 
+	stat = worker_mediabox(file, llx, lly, urx, ury);
 #ifdef HAVE_GSLIB
-	stat = gslib_mediabox(file, llx, lly, urx, ury);
-	if (stat == -1)
+	if (stat == -1) {
+#ifdef HAVE_PTHREAD
+		pthread_mutex_lock(&gslib_lock);
+#endif
+		stat = gslib_mediabox(file, llx, lly, urx, ury);
+#ifdef HAVE_PTHREAD
+		pthread_mutex_unlock(&gslib_lock);
 #endif
+	}
+#endif
+	if (stat == -1)
 		stat = gsexe_mediabox(file, llx, lly, urx, ury);
 	if (stat == GS_ERROR) {
 		file_msg("Could not parse file '%s' with ghostscript.", file);
@@ -1119,11 +2159,20 @@ gs_bitmap(char *file, F_pic *pic, int llx, int lly, int urx, int ury)
 {
 	int	stat;
 
+	stat = worker_bitmap(file, pic, llx, lly, urx, ury);
+	if (stat == -1) {
 #ifdef HAVE_GSLIB
-	stat = gslib_bitmap(file, pic, llx, lly, urx, ury);
+#ifdef HAVE_PTHREAD
+		pthread_mutex_lock(&gslib_lock);
+#endif
+		stat = gslib_bitmap(file, pic, llx, lly, urx, ury);
+#ifdef HAVE_PTHREAD
+		pthread_mutex_unlock(&gslib_lock);
+#endif
 #else
-	stat = gsexe_bitmap(file, pic, llx, lly, urx, ury);
+		stat = gsexe_bitmap(file, pic, llx, lly, urx, ury);
 #endif
+	}
 	if (stat == GS_ERROR) {
 		file_msg("Could not create pixmap from '%s' with ghostscript.",
 				file);
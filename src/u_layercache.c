@@ -0,0 +1,421 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2015 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+/*
+ * Off-screen pixmaps of the depths of the figure.
+ *
+ * If the resource layer_cache is set to a size in kilobytes, each depth of
+ * the figure is rendered into a pixmap of the size of the canvas, together
+ * with a mask of the pixels covered by its objects. The canvas is then
+ * composed by copying the pixmaps through their masks, deepest first.
+ * Showing, hiding or graying a depth in the depth manager only re-renders
+ * that depth, if at all; panning only renders the uncovered strips. An
+ * editing action re-renders all depths, see objects_modified(), since not
+ * all code that changes objects tells which objects it changed.
+ *
+ * The mask is found without reading back any pixels: the depth is drawn
+ * twice, on a background of all zeros and on a background of all ones.
+ * The pixels where the two drawings differ are the background. The xor of
+ * the two drawings is all ones on the background and zero elsewhere, hence
+ * its lowest plane is the inverted mask.
+ *
+ * If the pixmaps of all depths do not fit into the given size, the canvas
+ * is drawn directly, as without the cache.
+ */
+
+#include "fig.h"
+#include "resources.h"
+#include "object.h"
+#include "u_depth.h"
+#include "u_layercache.h"
+#include "u_redraw.h"
+#include "w_canvas.h"
+#include "w_drawprim.h"
+#include "w_layers.h"
+#include "w_setup.h"
+#include "w_zoom.h"
+
+struct layer {
+	Pixmap		pix;		/* the objects, zero elsewhere */
+	Pixmap		mask;		/* the pixels covered by objects */
+	Boolean		valid;
+	Boolean		active;		/* active_layer() when rendered */
+	XRectangle	dirty;		/* out of date part, if valid */
+};
+
+static struct layer	layers[MAX_DEPTH + 1];
+static Pixmap		scratch = (Pixmap)0;
+static GC		copy_gc, xor_gc, plane_gc, comp_gc;
+static Boolean		gcs_made = False;
+
+/* the state for which the pixmaps were rendered */
+static int		pix_wd = 0, pix_ht = 0;
+static float		cache_zoomscale;
+static int		cache_xoff, cache_yoff;
+static Boolean		cache_shownums;
+static F_compound	heads;
+
+static void
+free_layers(void)
+{
+	int	i;
+
+	for (i = 0; i <= MAX_DEPTH; ++i) {
+		if (layers[i].pix) {
+			XFreePixmap(tool_d, layers[i].pix);
+			XFreePixmap(tool_d, layers[i].mask);
+		}
+		layers[i].pix = layers[i].mask = (Pixmap)0;
+		layers[i].valid = False;
+	}
+	if (scratch)
+		XFreePixmap(tool_d, scratch);
+	scratch = (Pixmap)0;
+}
+
+/* a depth, or all depths if depth < 0, must be rendered again */
+void
+invalidate_layer_cache(int depth)
+{
+	int	i;
+
+	if (depth > MAX_DEPTH)
+		depth = MAX_DEPTH;
+	if (depth >= 0) {
+		layers[depth].valid = False;
+		return;
+	}
+	for (i = 0; i <= MAX_DEPTH; ++i)
+		layers[i].valid = False;
+}
+
+/* obj was changed; render the depths of its objects again */
+void
+layer_cache_changed(int type, void *obj)
+{
+	F_compound	*c;
+	F_arc		*a;
+	F_ellipse	*e;
+	F_line		*l;
+	F_spline	*s;
+	F_text		*t;
+
+	switch (type) {
+	case O_ARC:
+		invalidate_layer_cache(((F_arc *)obj)->depth);
+		break;
+	case O_ELLIPSE:
+		invalidate_layer_cache(((F_ellipse *)obj)->depth);
+		break;
+	case O_POLYLINE:
+		invalidate_layer_cache(((F_line *)obj)->depth);
+		break;
+	case O_SPLINE:
+		invalidate_layer_cache(((F_spline *)obj)->depth);
+		break;
+	case O_TXT:
+		invalidate_layer_cache(((F_text *)obj)->depth);
+		break;
+	case O_COMPOUND:
+		c = (F_compound *)obj;
+		for (a = c->arcs; a != NULL; a = a->next)
+			invalidate_layer_cache(a->depth);
+		for (e = c->ellipses; e != NULL; e = e->next)
+			invalidate_layer_cache(e->depth);
+		for (l = c->lines; l != NULL; l = l->next)
+			invalidate_layer_cache(l->depth);
+		for (s = c->splines; s != NULL; s = s->next)
+			invalidate_layer_cache(s->depth);
+		for (t = c->texts; t != NULL; t = t->next)
+			invalidate_layer_cache(t->depth);
+		for (c = c->compounds; c != NULL; c = c->next)
+			layer_cache_changed(O_COMPOUND, c);
+		break;
+	}
+}
+
+/* bitmap is any pixmap of depth one */
+static void
+make_gcs(Drawable bitmap)
+{
+	XGCValues	gcv;
+
+	gcv.graphics_exposures = False;
+	copy_gc = XCreateGC(tool_d, main_canvas, GCGraphicsExposures, &gcv);
+	gcv.function = GXxor;
+	xor_gc = XCreateGC(tool_d, main_canvas,
+			GCFunction | GCGraphicsExposures, &gcv);
+	gcv.function = GXcopy;
+	comp_gc = XCreateGC(tool_d, main_canvas,
+			GCFunction | GCGraphicsExposures, &gcv);
+	/* where the xor is one, i.e., on the background, the mask is zero */
+	gcv.foreground = 0;
+	gcv.background = 1;
+	plane_gc = XCreateGC(tool_d, bitmap,
+			GCForeground | GCBackground | GCGraphicsExposures, &gcv);
+	gcs_made = True;
+}
+
+/*
+ * Check that the pixmaps are for the current figure and view,
+ * and that the occupied depths fit into the size given by the user.
+ */
+static Boolean
+check_cache(int mindepth, int maxdepth)
+{
+	long	bytes, limit;
+	int	bpp, n, d;
+
+	if (CANVAS_WD != pix_wd || CANVAS_HT != pix_ht) {
+		free_layers();
+		pix_wd = CANVAS_WD;
+		pix_ht = CANVAS_HT;
+	}
+	if (cache_zoomscale != zoomscale || cache_xoff != zoomxoff ||
+			cache_yoff != zoomyoff ||
+			cache_shownums != appres.shownums ||
+			heads.arcs != objects.arcs ||
+			heads.compounds != objects.compounds ||
+			heads.ellipses != objects.ellipses ||
+			heads.lines != objects.lines ||
+			heads.splines != objects.splines ||
+			heads.texts != objects.texts ||
+			heads.parent != objects.parent) {
+		invalidate_layer_cache(-1);
+		cache_zoomscale = zoomscale;
+		cache_xoff = zoomxoff;
+		cache_yoff = zoomyoff;
+		cache_shownums = appres.shownums;
+		heads = objects;
+	}
+
+	bpp = tool_dpth > 16 ? 4 : (tool_dpth > 8 ? 2 : 1);
+	bytes = (long)pix_wd * pix_ht * bpp + (long)(pix_wd + 7) / 8 * pix_ht;
+	limit = (long)appres.layer_cache * 1024;
+	/* one scratch pixmap, plus one pixmap and mask for each depth */
+	for (n = 0, d = mindepth; d <= maxdepth; ++d) {
+		F_depth_bucket	*b = depth_bucket(&objects, d);
+
+		if (b && b->num > 0)
+			++n;
+	}
+	if (((long)n + 1) * bytes > limit) {
+		if (appres.DEBUG)
+			fprintf(stderr, "layer cache: %d depths exceed %d kB, "
+				"drawing directly\n", n, appres.layer_cache);
+		free_layers();
+		return False;
+	}
+	return True;
+}
+
+/* extend the rectangle r to include x, y, w, h */
+static void
+add_rect(XRectangle *r, int x, int y, int w, int h)
+{
+	int	x1, y1;
+
+	if (w <= 0 || h <= 0)
+		return;
+	if (r->width == 0) {
+		r->x = x;
+		r->y = y;
+		r->width = w;
+		r->height = h;
+		return;
+	}
+	x1 = max2(r->x + r->width, x + w);
+	y1 = max2(r->y + r->height, y + h);
+	r->x = min2(r->x, x);
+	r->y = min2(r->y, y);
+	r->width = x1 - r->x;
+	r->height = y1 - r->y;
+}
+
+/*
+ * The canvas was panned from old_xoff, old_yoff and its contents moved by
+ * dx, dy pixels. Move the pixmaps as well, then only the uncovered strips
+ * need to be rendered.
+ */
+void
+layer_cache_scroll(int old_xoff, int old_yoff, int dx, int dy)
+{
+	struct layer	*l;
+	int		i, x, y, w, h;
+
+	if (appres.layer_cache <= 0 || !gcs_made || cache_xoff != old_xoff ||
+			cache_yoff != old_yoff || cache_zoomscale != zoomscale ||
+			pix_wd != CANVAS_WD || pix_ht != CANVAS_HT)
+		return;
+	if (abs(dx) >= pix_wd || abs(dy) >= pix_ht) {
+		invalidate_layer_cache(-1);
+		return;
+	}
+
+	/* the part that remains visible */
+	x = max2(0, -dx);
+	y = max2(0, -dy);
+	w = pix_wd - abs(dx);
+	h = pix_ht - abs(dy);
+	for (i = 0; i <= MAX_DEPTH; ++i) {
+		l = &layers[i];
+		if (!l->valid)
+			continue;
+		XCopyArea(tool_d, l->pix, l->pix, copy_gc, x, y, w, h,
+				x + dx, y + dy);
+		XCopyArea(tool_d, l->mask, l->mask, plane_gc, x, y, w, h,
+				x + dx, y + dy);
+		if (l->dirty.width)
+			l->dirty.x += dx, l->dirty.y += dy;
+		if (dx > 0)
+			add_rect(&l->dirty, 0, 0, dx, pix_ht);
+		else if (dx < 0)
+			add_rect(&l->dirty, pix_wd + dx, 0, -dx, pix_ht);
+		if (dy > 0)
+			add_rect(&l->dirty, 0, 0, pix_wd, dy);
+		else if (dy < 0)
+			add_rect(&l->dirty, 0, pix_ht + dy, pix_wd, -dy);
+	}
+	cache_xoff = zoomxoff;
+	cache_yoff = zoomyoff;
+}
+
+static Boolean
+render_layer(int depth)
+{
+	struct layer	*l = &layers[depth];
+	Window		save_win;
+	int		x, y, w, h;
+
+	if (!l->pix) {
+		l->pix = XCreatePixmap(tool_d, main_canvas, pix_wd, pix_ht,
+					tool_dpth);
+		l->mask = XCreatePixmap(tool_d, main_canvas, pix_wd, pix_ht, 1);
+		if (!l->pix || !l->mask)
+			return False;
+	}
+	if (!scratch && !(scratch = XCreatePixmap(tool_d, main_canvas,
+					pix_wd, pix_ht, tool_dpth)))
+		return False;
+	if (!gcs_made)
+		make_gcs(l->mask);
+
+	/* render only the out of date part, if the depth did not change */
+	if (l->valid && l->active == active_layer(depth)) {
+		x = l->dirty.x;
+		y = l->dirty.y;
+		w = l->dirty.width;
+		h = l->dirty.height;
+	} else {
+		x = y = 0;
+		w = pix_wd;
+		h = pix_ht;
+	}
+	set_clip_window(x, y, x + w - 1, y + h - 1);
+
+	save_win = canvas_win;
+	XSetForeground(tool_d, copy_gc, 0);
+	XFillRectangle(tool_d, l->pix, copy_gc, x, y, w, h);
+	canvas_win = (Window)l->pix;
+	redisplay_depth_region(depth, x, y, x + w - 1, y + h - 1);
+
+	XSetForeground(tool_d, copy_gc, AllPlanes);
+	XFillRectangle(tool_d, scratch, copy_gc, x, y, w, h);
+	canvas_win = (Window)scratch;
+	redisplay_depth_region(depth, x, y, x + w - 1, y + h - 1);
+	canvas_win = save_win;
+
+	flush_draw_batch();
+	XCopyArea(tool_d, l->pix, scratch, xor_gc, x, y, w, h, x, y);
+	XCopyPlane(tool_d, scratch, l->mask, plane_gc, x, y, w, h, x, y, 1L);
+
+	l->valid = True;
+	l->active = active_layer(depth);
+	l->dirty.width = l->dirty.height = 0;
+	return True;
+}
+
+static void
+compose_layer(int depth, int x, int y, int w, int h)
+{
+	XSetClipMask(tool_d, comp_gc, layers[depth].mask);
+	XCopyArea(tool_d, layers[depth].pix, canvas_win, comp_gc,
+			x, y, w, h, x, y);
+}
+
+/*
+ * Draw the objects of the figure within the given region from the pixmaps
+ * of their depths, rendering the depths that are out of date. The region
+ * must have been cleared. Return False, if the cache is not used.
+ */
+Boolean
+layer_cache_redisplay(int xmin, int ymin, int xmax, int ymax)
+{
+	int	mindepth, maxdepth, d, x, y, w, h;
+	int	clip[4];
+
+	if (appres.layer_cache <= 0 || canvas_win != main_canvas)
+		return False;
+	if (objects.parent != NULL && objects.draw_parent)
+		return False;
+	if (!depth_range(&objects, &mindepth, &maxdepth))
+		return True;
+	if (!check_cache(mindepth, maxdepth))
+		return False;
+
+	draw_parent_gray = False;
+	/* render the out-of-date depths */
+	clip[0] = clip_xmin;
+	clip[1] = clip_ymin;
+	clip[2] = clip_xmax;
+	clip[3] = clip_ymax;
+	for (d = maxdepth; d >= mindepth; --d) {
+		F_depth_bucket	*b;
+
+		if (!gray_layers && !active_layer(d))
+			continue;
+		if (layers[d].valid && layers[d].active == active_layer(d) &&
+				layers[d].dirty.width == 0)
+			continue;
+		if ((b = depth_bucket(&objects, d)) == NULL || b->num == 0)
+			continue;
+		if (!render_layer(d)) {
+			set_clip_window(clip[0], clip[1], clip[2], clip[3]);
+			free_layers();
+			return False;
+		}
+	}
+	set_clip_window(clip[0], clip[1], clip[2], clip[3]);
+
+	x = max2(xmin, 0);
+	y = max2(ymin, 0);
+	w = min2(xmax, pix_wd - 1) - x + 1;
+	h = min2(ymax, pix_ht - 1) - y + 1;
+	if (w <= 0 || h <= 0)
+		return True;
+
+	/* inactive depths first, as in redisplay_objects() */
+	if (gray_layers)
+		for (d = maxdepth; d >= mindepth; --d)
+			if (!active_layer(d) && layers[d].valid)
+				compose_layer(d, x, y, w, h);
+	for (d = maxdepth; d >= mindepth; --d)
+		if (active_layer(d) && layers[d].valid)
+			compose_layer(d, x, y, w, h);
+	return True;
+}
@@ -0,0 +1,27 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2015 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+#ifndef U_LAYERCACHE_H
+#define U_LAYERCACHE_H
+
+extern void	invalidate_layer_cache(int depth);
+extern void	layer_cache_changed(int type, void *obj);
+extern void	layer_cache_scroll(int old_xoff, int old_yoff, int dx, int dy);
+extern Boolean	layer_cache_redisplay(int xmin, int ymin, int xmax, int ymax);
+
+#endif /* U_LAYERCACHE_H */
@@ -23,6 +23,9 @@
 #include "paintop.h"
 #include "f_read.h"
 #include "u_create.h"
+#include "u_depth.h"
+#include "u_layercache.h"
+#include "u_rtree.h"
 #include "u_list.h"
 #include "u_elastic.h"
 #include "u_redraw.h"
@@ -41,6 +44,14 @@
 int point_on_perim (F_point *p, int llx, int lly, int urx, int ury);
 int point_on_inside (F_point *p, int llx, int lly, int urx, int ury);
 
+/*
+ * Set while a list routine adds or removes the depths of an object. Any
+ * other call of add_depth() or remove_depth() means that objects were moved
+ * into or out of the figure without the list routines, and the spatial
+ * index must be rebuilt.
+ */
+static int	in_list_op = 0;
+
 void
 list_delete_arc(F_arc **arc_list, F_arc *arc)
 {
@@ -51,8 +62,12 @@ list_delete_arc(F_arc **arc_list, F_arc *arc)
     if (arc == NULL)
 	return;
 
-    if (arc_list == &objects.arcs)
+    invalidate_depth_index();
+    if (arc_list == &objects.arcs) {
+	++in_list_op;
 	remove_depth(O_ARC, arc->depth);
+	--in_list_op;
+    }
     for (a = aa = *arc_list; aa != NULL; a = aa, aa = aa->next) {
 	if (aa == arc) {
 	    if (aa == *arc_list)
@@ -63,6 +78,8 @@ list_delete_arc(F_arc **arc_list, F_arc *arc)
 	}
     }
     arc->next = NULL;
+    if (arc_list == &objects.arcs)
+	spatial_delete(arc);
 }
 
 void
@@ -75,8 +92,12 @@ list_delete_ellipse(F_ellipse **ellipse_list, F_ellipse *ellipse)
     if (ellipse == NULL)
 	return;
 
-    if (ellipse_list == &objects.ellipses)
+    invalidate_depth_index();
+    if (ellipse_list == &objects.ellipses) {
+	++in_list_op;
 	remove_depth(O_ELLIPSE, ellipse->depth);
+	--in_list_op;
+    }
     for (q = r = *ellipse_list; r != NULL; q = r, r = r->next) {
 	if (r == ellipse) {
 	    if (r == *ellipse_list)
@@ -87,6 +108,8 @@ list_delete_ellipse(F_ellipse **ellipse_list, F_ellipse *ellipse)
 	}
     }
     ellipse->next = NULL;
+    if (ellipse_list == &objects.ellipses)
+	spatial_delete(ellipse);
 }
 
 void
@@ -99,8 +122,12 @@ list_delete_line(F_line **line_list, F_line *line)
     if (line == NULL)
 	return;
 
-    if (line_list == &objects.lines)
+    invalidate_depth_index();
+    if (line_list == &objects.lines) {
+	++in_list_op;
 	remove_depth(O_POLYLINE, line->depth);
+	--in_list_op;
+    }
     for (q = r = *line_list; r != NULL; q = r, r = r->next) {
 	if (r == line) {
 	    if (r == *line_list)
@@ -111,6 +138,8 @@ list_delete_line(F_line **line_list, F_line *line)
 	}
     }
     line->next = NULL;
+    if (line_list == &objects.lines)
+	spatial_delete(line);
 }
 
 void
@@ -123,8 +152,12 @@ list_delete_spline(F_spline **spline_list, F_spline *spline)
     if (spline == NULL)
 	return;
 
-    if (spline_list == &objects.splines)
+    invalidate_depth_index();
+    if (spline_list == &objects.splines) {
+	++in_list_op;
 	remove_depth(O_SPLINE, spline->depth);
+	--in_list_op;
+    }
     for (q = r = *spline_list; r != NULL; q = r, r = r->next) {
 	if (r == spline) {
 	    if (r == *spline_list)
@@ -135,6 +168,8 @@ list_delete_spline(F_spline **spline_list, F_spline *spline)
 	}
     }
     spline->next = NULL;
+    if (spline_list == &objects.splines)
+	spatial_delete(spline);
 }
 
 void
@@ -147,8 +182,12 @@ list_delete_text(F_text **text_list, F_text *text)
     if (text == NULL)
 	return;
 
-    if (text_list == &objects.texts)
+    invalidate_depth_index();
+    if (text_list == &objects.texts) {
+	++in_list_op;
 	remove_depth(O_TXT, text->depth);
+	--in_list_op;
+    }
     for (q = r = *text_list; r != NULL; q = r, r = r->next)
 	if (r == text) {
 	    if (r == *text_list)
@@ -158,6 +197,8 @@ list_delete_text(F_text **text_list, F_text *text)
 	    break;
 	}
     text->next = NULL;
+    if (text_list == &objects.texts)
+	spatial_delete(text);
 }
 
 void
@@ -170,8 +211,12 @@ list_delete_compound(F_compound **list, F_compound *compound)
     if (compound == NULL)
 	return;
 
-    if (list == &objects.compounds)
+    invalidate_depth_index();
+    if (list == &objects.compounds) {
+	++in_list_op;
 	remove_compound_depth(compound);
+	--in_list_op;
+    }
 
     for (cc = c = *list; c != NULL; cc = c, c = c->next) {
 	if (c == compound) {
@@ -183,6 +228,8 @@ list_delete_compound(F_compound **list, F_compound *compound)
 	}
     }
     compound->next = NULL;
+    if (list == &objects.compounds)
+	spatial_delete(compound);
 }
 
 void
@@ -191,6 +238,10 @@ remove_depth(int type, int depth)
     int		    i;
 
     object_depths[depth]--;
+    invalidate_depth_index();
+    invalidate_layer_cache(depth);
+    if (!in_list_op)
+	invalidate_spatial_index();
     if (appres.DEBUG)
 	fprintf(stderr,"remove depth %d, count=%d\n",depth,object_depths[depth]);
     /* now subtract one from the counter for this object type */
@@ -291,16 +342,21 @@ list_add_arc(F_arc **list, F_arc *a)
 {
     F_arc	   *aa;
 
+    invalidate_depth_index();
     a->next = NULL;
     if ((aa = last_arc(*list)) == NULL)
 	*list = a;
     else
 	aa->next = a;
-    if (list == &objects.arcs)
+    if (list == &objects.arcs) {
+	spatial_add(O_ARC, a);
+	++in_list_op;
 	while (a) {
 	    add_depth(O_ARC, a->depth);
 	    a = a->next;
 	}
+	--in_list_op;
+    }
 }
 
 void
@@ -308,16 +364,21 @@ list_add_ellipse(F_ellipse **list, F_ellipse *e)
 {
     F_ellipse	   *ee;
 
+    invalidate_depth_index();
     e->next = NULL;
     if ((ee = last_ellipse(*list)) == NULL)
 	*list = e;
     else
 	ee->next = e;
-    if (list == &objects.ellipses)
+    if (list == &objects.ellipses) {
+	spatial_add(O_ELLIPSE, e);
+	++in_list_op;
 	while (e) {
 	    add_depth(O_ELLIPSE, e->depth);
 	    e = e->next;
 	}
+	--in_list_op;
+    }
 }
 
 void
@@ -325,16 +386,21 @@ list_add_line(F_line **list, F_line *l)
 {
     F_line	   *ll;
 
+    invalidate_depth_index();
     l->next = NULL;
     if ((ll = last_line(*list)) == NULL)
 	*list = l;
     else
 	ll->next = l;
-    if (list == &objects.lines)
+    if (list == &objects.lines) {
+	spatial_add(O_POLYLINE, l);
+	++in_list_op;
 	while (l) {
 	    add_depth(O_POLYLINE, l->depth);
 	    l = l->next;
 	}
+	--in_list_op;
+    }
 }
 
 void
@@ -342,16 +408,21 @@ list_add_spline(F_spline **list, F_spline *s)
 {
     F_spline	   *ss;
 
+    invalidate_depth_index();
     s->next = NULL;
     if ((ss = last_spline(*list)) == NULL)
 	*list = s;
     else
 	ss->next = s;
-    if (list == &objects.splines)
+    if (list == &objects.splines) {
+	spatial_add(O_SPLINE, s);
+	++in_list_op;
 	while (s) {
 	    add_depth(O_SPLINE, s->depth);
 	    s = s->next;
 	}
+	--in_list_op;
+    }
 }
 
 void
@@ -359,16 +430,21 @@ list_add_text(F_text **list, F_text *t)
 {
     F_text	   *tt;
 
+    invalidate_depth_index();
     t->next = NULL;
     if ((tt = last_text(*list)) == NULL)
 	*list = t;
     else
 	tt->next = t;
-    if (list == &objects.texts)
+    if (list == &objects.texts) {
+	spatial_add(O_TXT, t);
+	++in_list_op;
 	while (t) {
 	    add_depth(O_TXT, t->depth);
 	    t = t->next;
 	}
+	--in_list_op;
+    }
 }
 
 void
@@ -376,6 +452,7 @@ list_add_compound(F_compound **list, F_compound *c)
 {
     F_compound	   *cc;
 
+    invalidate_depth_index();
     c->next = NULL;
     if ((cc = last_compound(*list)) == NULL)
 	*list = c;
@@ -383,10 +460,13 @@ list_add_compound(F_compound **list, F_compound *c)
 	cc->next = c;
 
     if (list == &objects.compounds) {
+	spatial_add(O_COMPOUND, c);
+	++in_list_op;
 	while (c) {
 	    add_compound_depth(c);
 	    c = c->next;
 	}
+	--in_list_op;
     }
 }
 
@@ -399,6 +479,10 @@ add_depth(int type, int depth)
     int		    i;
 
     object_depths[depth]++;
+    invalidate_depth_index();
+    invalidate_layer_cache(depth);
+    if (!in_list_op)
+	invalidate_spatial_index();
 
     if (appres.DEBUG)
 	fprintf(stderr,"add depth %d, count=%d\n",depth,object_depths[depth]);
@@ -21,15 +21,23 @@
 #include "mode.h"
 #include "paintop.h"
 #include "u_markers.h"
+#include "u_redraw.h"
 #include "w_drawprim.h"
 #include "w_layers.h"
 #include "w_zoom.h"
 
 #include <limits.h>	/* INT_MIN */
 
+/*
+ * The markers are drawn with xor. Draw the regions that wait to be redrawn
+ * first, else the redraw would later paint over, or invert, the markers.
+ * Within redraw_region(), which draws the markers itself, redisplay_damage()
+ * leaves the regions to the work procedure.
+ */
 #define set_marker(win,x,y,w,h) \
-	XDrawRectangle(tool_d,(win),gccache[INV_PAINT], \
-	     ZOOMX(x)-((w-1)/2),ZOOMY(y)-((w-1)/2),(w),(h))
+	(redisplay_damage(), \
+	 XDrawRectangle(tool_d,(win),gccache[INV_PAINT], \
+	     ZOOMX(x)-((w-1)/2),ZOOMY(y)-((w-1)/2),(w),(h)))
 
 #define CHANGED_MASK(msk) \
     ((oldmask & msk) != (newmask & msk))
@@ -39,6 +47,7 @@
 void center_marker(int x, int y)
 {
 
+    redisplay_damage();
     pw_vector(canvas_win, x, y - (int)(CENTER_MARK/zoomscale),
 	      x, y + (int)(CENTER_MARK/zoomscale), INV_PAINT, 1,
 	      RUBBER_LINE, 0.0, DEFAULT);
@@ -26,56 +26,139 @@
  */
 #include "resources.h"
 #include "mode.h"
+#include "object.h"
 #include "w_zoom.h"
 
+#include "u_layercache.h"
+#include "u_redraw.h"
 #include "w_canvas.h"
+#include "w_file.h"
 #include "w_grid.h"
 #include "w_rulers.h"
+#include "w_setup.h"
 
 
 #define	PAN_OFFSET	((int)(posn_rnd[cur_gridunit][P_GRID3] / \
 				appres.userscale / display_zoomscale * \
 				(shift ? 5.0 : 1.0)))
 
+/*
+ * The canvas was panned from old_xoff, old_yoff to zoomxoff, zoomyoff.
+ * If the contents move by whole pixels, shift them with XCopyArea and only
+ * redraw the strips that came into view. Otherwise, set up the grid, which
+ * redraws the whole canvas.
+ */
+void pan_canvas(int old_xoff, int old_yoff)
+{
+    static GC	    pan_gc = (GC)0;
+    XGCValues	    gcv;
+    XEvent	    ev;
+    float	    fx, fy;
+    int		    dx, dy;
+    int		    xmin, ymin, xmax, ymax;
+
+    if (old_xoff == zoomxoff && old_yoff == zoomyoff)
+	return;
+
+    fx = zoomscale * (old_xoff - zoomxoff);
+    fy = zoomscale * (old_yoff - zoomyoff);
+    dx = (int) round(fx);
+    dy = (int) round(fy);
+    if (fabs(fx - dx) > 0.001 || fabs(fy - dy) > 0.001 ||
+		abs(dx) >= CANVAS_WD || abs(dy) >= CANVAS_HT ||
+		canvas_win != main_canvas || preview_in_progress ||
+		splash_onscreen || !pan_grid()) {
+	setup_grid();
+	return;
+    }
+
+    if (pan_gc == (GC)0) {
+	gcv.graphics_exposures = True;
+	pan_gc = XCreateGC(tool_d, main_canvas, GCGraphicsExposures, &gcv);
+    }
+    XCopyArea(tool_d, main_canvas, main_canvas, pan_gc,
+		max2(0, -dx), max2(0, -dy),
+		CANVAS_WD - abs(dx), CANVAS_HT - abs(dy),
+		max2(0, dx), max2(0, dy));
+    layer_cache_scroll(old_xoff, old_yoff, dx, dy);
+
+    /* the strips that came into view */
+    if (dx > 0)
+	redisplay_region(0, 0, dx, CANVAS_HT);
+    else if (dx < 0)
+	redisplay_region(CANVAS_WD + dx, 0, CANVAS_WD, CANVAS_HT);
+    if (dy > 0)
+	redisplay_region(0, 0, CANVAS_WD, dy);
+    else if (dy < 0)
+	redisplay_region(0, CANVAS_HT + dy, CANVAS_WD, CANVAS_HT);
+
+    /*
+     * Parts of the canvas that were obscured could not be copied.
+     * Redraw them now, their position refers to the new offsets.
+     */
+    XSync(tool_d, False);
+    xmin = ymin = 9999;
+    xmax = ymax = -9999;
+    while (XCheckTypedWindowEvent(tool_d, main_canvas, GraphicsExpose, &ev)) {
+	xmin = min2(xmin, ev.xgraphicsexpose.x);
+	ymin = min2(ymin, ev.xgraphicsexpose.y);
+	xmax = max2(xmax, ev.xgraphicsexpose.x + ev.xgraphicsexpose.width);
+	ymax = max2(ymax, ev.xgraphicsexpose.y + ev.xgraphicsexpose.height);
+    }
+    (void)XCheckTypedWindowEvent(tool_d, main_canvas, NoExpose, &ev);
+    if (xmin <= xmax)
+	redisplay_region(xmin, ymin, xmax, ymax);
+}
+
 void pan_left(int shift)
 {
+    int		    old_xoff = zoomxoff;
+
     zoomxoff += PAN_OFFSET;
     reset_topruler();
     redisplay_topruler();
-    setup_grid();
+    pan_canvas(old_xoff, zoomyoff);
 }
 
 void pan_right(int shift)
 {
+    int		    old_xoff = zoomxoff;
+
     zoomxoff -= PAN_OFFSET;
     if (!appres.allownegcoords && (zoomxoff < 0))
 	zoomxoff = 0;
     reset_topruler();
     redisplay_topruler();
-    setup_grid();
+    pan_canvas(old_xoff, zoomyoff);
 }
 
 void pan_up(int shift)
 {
+    int		    old_yoff = zoomyoff;
+
     zoomyoff += PAN_OFFSET;
     reset_sideruler();
     redisplay_sideruler();
-    setup_grid();
+    pan_canvas(zoomxoff, old_yoff);
 }
 
 void pan_down(int shift)
 {
+    int		    old_yoff = zoomyoff;
+
     zoomyoff -= PAN_OFFSET;
     if (!appres.allownegcoords && (zoomyoff < 0))
 	zoomyoff = 0;
     reset_sideruler();
     redisplay_sideruler();
-    setup_grid();
+    pan_canvas(zoomxoff, old_yoff);
 }
 
 void
 pan_origin(void)
 {
+    int		    old_xoff = zoomxoff, old_yoff = zoomyoff;
+
     /* turn off Compose key LED */
     setCompLED(0);
 
@@ -91,5 +174,5 @@ pan_origin(void)
 	reset_topruler();
 	redisplay_topruler();
     }
-    setup_grid();
+    pan_canvas(old_xoff, old_yoff);
 }
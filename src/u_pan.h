@@ -17,6 +17,7 @@
  */
 
 extern void	pan_origin(void);
+extern void	pan_canvas(int old_xoff, int old_yoff);
 extern int pan_down (int shift);
 extern int pan_left (int shift);
 extern int pan_right (int shift);
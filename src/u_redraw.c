@@ -36,7 +36,10 @@
 
 #include "d_text.h"
 #include "u_bound.h"
+#include "u_depth.h"
+#include "u_rtree.h"
 #include "u_elastic.h"
+#include "u_layercache.h"
 #include "u_markers.h"
 #include "w_cursor.h"
 #include "w_rulers.h"
@@ -52,9 +55,7 @@ Boolean	request_redraw = False;
  * data structures that will percolate throughout program.
  *
  * One ``counts'' structure for each object type at each nesting depth from 0
- * to MAX_DEPTH - 1.  We track both the number of objects per type per depth,
- * as well as the number of objects drawn so far per type per depth to cut
- * down on search loop overhead.
+ * to MAX_DEPTH - 1.  We track the number of objects per type per depth.
  */
 
 /*
@@ -64,20 +65,22 @@ Boolean	request_redraw = False;
 
 struct counts	counts[MAX_DEPTH + 1], saved_counts[MAX_DEPTH + 1];
 
+void redraw_pageborder (void);
+void draw_pb (int x, int y, int w, int h);
+
+static void	draw_depth_obj(F_depth_obj *d);
+static void	redisplay_markers(F_compound *active_objects);
+static Boolean	redisplay_indexed(int xmin, int ymin, int xmax, int ymax);
+static void	redraw_region(int xmin, int ymin, int xmax, int ymax);
+static void	discard_damage(void);
+static void	zoomed_region(int xmin, int ymin, int xmax, int ymax);
+static void	regions(int xmin1, int ymin1, int xmax1, int ymax1,
+			int xmin2, int ymin2, int xmax2, int ymax2);
+
 /*
  * Function to clear the array of object counts with file load or new command.
  */
 
-
-void redisplay_arcobject (F_arc *arcs, int depth);
-void redisplay_compoundobject (F_compound *compounds, int depth);
-void redisplay_ellipseobject (F_ellipse *ellipses, int depth);
-void redisplay_lineobject (F_line *lines, int depth);
-void redisplay_splineobject (F_spline *splines, int depth);
-void redisplay_textobject (F_text *texts, int depth);
-void redraw_pageborder (void);
-void draw_pb (int x, int y, int w, int h);
-
 void
 clearallcounts(void)
 {
@@ -90,30 +93,11 @@ clearallcounts(void)
 	cp->num_splines = 0;
 	cp->num_texts = 0;
     }
-    clearcounts();
-}
-
-/*
- * Clear count of objects drawn at each depth
- */
-
-void
-clearcounts(void)
-{
-    register struct counts *cp;
-
-    for (cp = &counts[0]; cp <= &counts[MAX_DEPTH]; ++cp) {
-	cp->cnt_arcs = 0;
-	cp->cnt_lines = 0;
-	cp->cnt_ellipses = 0;
-	cp->cnt_splines = 0;
-	cp->cnt_texts = 0;
-    }
 }
 
 void redisplay_objects(F_compound *active_objects)
 {
-    int		    depth;
+    int		    depth, mindepth, maxdepth;
     F_compound	   *objects, *save_objects;
 
     objects = active_objects;
@@ -138,42 +122,26 @@ void redisplay_objects(F_compound *active_objects)
 	draw_parent_gray = True;
     }
 
-    clearcounts();
-
     /* if user wants gray inactive layers, draw them first */
-    /* remove_depth() in u_list.c sets min_depth = -1 if there are no objects */
-    if ((gray_layers || draw_parent_gray) && min_depth > -1) {
-	for (depth = max_depth; depth >= min_depth; --depth) {
-	    if (!active_layer(depth) || draw_parent_gray) {
-		redisplay_arcobject(objects->arcs, depth);
-		redisplay_compoundobject(objects->compounds, depth);
-		redisplay_ellipseobject(objects->ellipses, depth);
-		redisplay_lineobject(objects->lines, depth);
-		redisplay_splineobject(objects->splines, depth);
-		redisplay_textobject(objects->texts, depth);
-	    }
+    if ((gray_layers || draw_parent_gray) &&
+		depth_range(objects, &mindepth, &maxdepth)) {
+	for (depth = maxdepth; depth >= mindepth; --depth) {
+	    if (!active_layer(depth) || draw_parent_gray)
+		redisplay_depth(objects, depth);
 	}
     }
 
     if (draw_parent_gray) {
 	/* now point to just the open compound and (re)draw it */
-	clearcounts();
 	objects = save_objects;
 	draw_parent_gray = False;
     }
 
     /* now draw the active layers in their normal colors */
-    if (min_depth > -1) { /* if there are no objects, remove_depth() in
-			     u_list.c sets min_depth = -1 */
-	for (depth = max_depth; depth >= min_depth; --depth) {
-	    if (active_layer(depth)) {
-		redisplay_arcobject(objects->arcs, depth);
-		redisplay_compoundobject(objects->compounds, depth);
-		redisplay_ellipseobject(objects->ellipses, depth);
-		redisplay_lineobject(objects->lines, depth);
-		redisplay_splineobject(objects->splines, depth);
-		redisplay_textobject(objects->texts, depth);
-	    }
+    if (depth_range(objects, &mindepth, &maxdepth)) {
+	for (depth = maxdepth; depth >= mindepth; --depth) {
+	    if (active_layer(depth))
+		redisplay_depth(objects, depth);
 	}
     }
 
@@ -181,7 +149,14 @@ void redisplay_objects(F_compound *active_objects)
      * Point markers and compounds, not being ``real objects'', are handled
      * outside the depth loop.
      */
+    redisplay_markers(active_objects);
+}
 
+static void
+redisplay_markers(F_compound *active_objects)
+{
+    /* the markers are drawn directly, in XOR mode, on top of the objects */
+    flush_draw_batch();
     /* show the markers if they are on */
     toggle_markers_in_compound(active_objects);
     /* mark any center if requested */
@@ -193,149 +168,108 @@ void redisplay_objects(F_compound *active_objects)
 }
 
 /*
- * Redisplay a list of arcs.  Only display arcs of the correct depth.
- * For each arc drawn, update the count for the appropriate depth in
- * the counts array.
- */
-
-void redisplay_arcobject(F_arc *arcs, int depth)
-{
-    F_arc	   *arc;
-    struct counts  *cp;
-
-    if (arcs == NULL)
-	return;
-    cp = &counts[min2(depth, MAX_DEPTH)];
-
-    arc = arcs;
-    while (arc != NULL && cp->cnt_arcs < cp->num_arcs) {
-	if (depth == arc->depth) {
-		draw_arc(arc, PAINT);
-		++cp->cnt_arcs;
-	    }
-	arc = arc->next;
-    }
-}
-
-/*
- * Redisplay a list of ellipses.  Only display ellipses of the correct depth
- * For each ellipse drawn, update the count for the
- * appropriate depth in the counts array.
+ * Redisplay only the objects of the figure that overlap the region given in
+ * screen coordinates, taken from the spatial index. The markers are not
+ * drawn. Return False, if the index cannot be used, e.g., if the parent of
+ * an open compound is shown.
  */
 
-void redisplay_ellipseobject(F_ellipse *ellipses, int depth)
+static Boolean
+redisplay_indexed(int xmin, int ymin, int xmax, int ymax)
 {
-    F_ellipse	   *ep;
-    struct counts  *cp;
-
-    if (ellipses == NULL)
-	return;
-    cp = &counts[min2(depth, MAX_DEPTH)];
+    F_depth_obj	   *objs, *d, *end;
+    int		    num;
 
+    if (objects.parent != NULL && objects.draw_parent)
+	return False;
+    if (!spatial_query(&objects, BACKX(xmin), BACKY(ymin),
+				BACKX(xmax), BACKY(ymax), &objs, &num))
+	return False;
 
-    ep = ellipses;
-    while (ep != NULL && cp->cnt_ellipses < cp->num_ellipses) {
-	if (depth == ep->depth) {
-		draw_ellipse(ep, PAINT);
-		++cp->cnt_ellipses;
-	    }
-	ep = ep->next;
-    }
+    draw_parent_gray = False;
+    end = objs + num;
+    /* objs are sorted by decreasing depth, as in redisplay_objects() */
+    if (gray_layers)
+	for (d = objs; d < end; ++d)
+	    if (!active_layer(d->depth))
+		draw_depth_obj(d);
+    for (d = objs; d < end; ++d)
+	if (active_layer(d->depth))
+	    draw_depth_obj(d);
+    return True;
 }
 
 /*
- * Redisplay a list of lines.  Only display lines of the correct depth.
- * For each line drawn, update the count for the appropriate
- * depth in the counts array.
+ * Redisplay all objects at the given depth within the compound objects,
+ * taken from the depth index.
  */
 
-void redisplay_lineobject(F_line *lines, int depth)
+void redisplay_depth(F_compound *objects, int depth)
 {
-    F_line	   *lp;
-    struct counts  *cp;
+    F_depth_bucket *b;
+    F_depth_obj	   *d, *end;
 
-    if (lines == NULL)
+    if ((b = depth_bucket(objects, depth)) == NULL)
 	return;
-    cp = &counts[min2(depth, MAX_DEPTH)];
-
 
-    lp = lines;
-    while (lp != NULL && cp->cnt_lines < cp->num_lines) {
-	if (depth == lp->depth) {
-		draw_line(lp, PAINT);
-		++cp->cnt_lines;
-	    }
-	lp = lp->next;
-    }
+    for (d = b->objs, end = b->objs + b->num; d < end; ++d)
+	draw_depth_obj(d);
 }
 
 /*
- * Redisplay a list of splines.	 Only display splines of the correct depth
- * For each spline drawn, update the count for the
- * appropriate depth in the counts array.
+ * Redisplay the objects of the figure at the given depth that overlap the
+ * region given in screen coordinates, using the spatial index if possible.
  */
 
-void redisplay_splineobject(F_spline *splines, int depth)
+void redisplay_depth_region(int depth, int xmin, int ymin, int xmax, int ymax)
 {
-    F_spline	   *spline;
-    struct counts  *cp;
+    F_depth_obj	   *objs, *d, *end;
+    int		    num;
 
-    if (splines == NULL)
+    /* some margin, as in redisplay_region() */
+    if (!spatial_query(&objects, BACKX(xmin - 10), BACKY(ymin - 10),
+			BACKX(xmax + 10), BACKY(ymax + 10), &objs, &num)) {
+	redisplay_depth(&objects, depth);
 	return;
-    cp = &counts[min2(depth, MAX_DEPTH)];
-
-    spline = splines;
-    while (spline != NULL && cp->cnt_splines < cp->num_splines) {
-	if (depth == spline->depth) {
-		draw_spline(spline, PAINT);
-		++cp->cnt_splines;
-	    }
-	spline = spline->next;
     }
+    for (d = objs, end = objs + num; d < end; ++d)
+	if (d->depth == depth)
+	    draw_depth_obj(d);
 }
 
-/*
- * Redisplay a list of texts.  Only display texts of the correct depth.	 For
- * each text drawn, update the count for the appropriate depth in the counts
- * array.
- */
-
-void redisplay_textobject(F_text *texts, int depth)
+static void
+draw_depth_obj(F_depth_obj *d)
 {
-    F_text	   *text;
-    struct counts  *cp;
-
-    if (texts == NULL)
-	return;
-    cp = &counts[min2(depth, MAX_DEPTH)];
-
-    text = texts;
-    while (text != NULL && cp->cnt_texts < cp->num_texts) {
-	if (depth == text->depth) {
-	    draw_text(text, PAINT);
-	    ++cp->cnt_texts;
-	}
-	text = text->next;
+    switch (d->type) {
+    case O_ARC:
+	draw_arc((F_arc *)d->obj, PAINT);
+	break;
+    case O_ELLIPSE:
+	draw_ellipse((F_ellipse *)d->obj, PAINT);
+	break;
+    case O_POLYLINE:
+	draw_line((F_line *)d->obj, PAINT);
+	break;
+    case O_SPLINE:
+	draw_spline((F_spline *)d->obj, PAINT);
+	break;
+    case O_TXT:
+	draw_text((F_text *)d->obj, PAINT);
+	break;
     }
 }
 
 /*
- * Redisplay a list of compounds at a current depth.  Basically just farm the
- * work out to the objects contained in the compound.
+ * Objects of the figure may have been moved or changed in place, e.g., by
+ * align, which translates the objects without the redisplay_<object>()
+ * functions. Called from set_modifiedflag() and undo(), so that not every
+ * caller needs to keep the spatial index and the layer cache up to date.
  */
-
-void redisplay_compoundobject(F_compound *compounds, int depth)
+void
+objects_modified(void)
 {
-    F_compound	   *c;
-
-    for (c = compounds; c != NULL; c = c->next) {
-	redisplay_arcobject(c->arcs, depth);
-	redisplay_compoundobject(c->compounds, depth);
-	redisplay_ellipseobject(c->ellipses, depth);
-	redisplay_lineobject(c->lines, depth);
-	redisplay_splineobject(c->splines, depth);
-	redisplay_textobject(c->texts, depth);
-    }
+    spatial_modified();
+    invalidate_layer_cache(-1);
 }
 
 /*
@@ -347,10 +281,24 @@ redisplay_canvas(void)
     /* turn off Compose key LED */
     setCompLED(0);
 
+    /* the figure may have been changed in any way */
+    objects_modified();
+    /* the whole canvas is drawn, forget the pending regions */
+    discard_damage();
     redisplay_region(0, 0, CANVAS_WD, CANVAS_HT);
     reset_rulers();
 }
 
+/*
+ * Redisplay the canvas after depths were shown, hidden or grayed out in the
+ * depth manager. The objects themselves did not change.
+ */
+void
+redisplay_layers(void)
+{
+    redisplay_region(0, 0, CANVAS_WD, CANVAS_HT);
+}
+
 /* redisplay the object currently being created by the user (if any) */
 
 void redisplay_curobj(void)
@@ -458,16 +406,142 @@ void redisplay_region(int xmin, int ymin, int xmax, int ymax)
     }
 
     set_temp_cursor(wait_cursor);
+    redraw_region(xmin, ymin, xmax, ymax);
+    reset_cursor();
+}
+
+/* true while a region is drawn; set_marker() may ask for the damage then */
+static Boolean	in_redraw = False;
+
+static void
+redraw_region(int xmin, int ymin, int xmax, int ymax)
+{
+    in_redraw = True;
     /* kludge so that markers are redrawn */
     xmin -= 10;
     ymin -= 10;
     xmax += 10;
     ymax += 10;
+    begin_draw_batch();
     set_clip_window(xmin, ymin, xmax, ymax);
     clear_canvas();
-    redisplay_objects(&objects);
+    if (layer_cache_redisplay(xmin, ymin, xmax, ymax) ||
+		redisplay_indexed(xmin, ymin, xmax, ymax))
+	redisplay_markers(&objects);
+    else
+	redisplay_objects(&objects);
+    end_draw_batch();
     redisplay_curobj();
     reset_clip_window();
+    in_redraw = False;
+}
+
+/*
+ * Regions of the figure that need to be redrawn. The redisplay_<object>()
+ * functions are often called several times for one user action, e.g., to
+ * align many objects. The regions are collected here, overlapping regions
+ * are merged, and all are drawn at once, either from a work procedure or
+ * before the next event is dispatched, whatever happens first.
+ */
+
+#define MAX_DAMAGE	32
+
+struct damage {
+    int		    xmin, ymin, xmax, ymax;	/* in figure coordinates */
+};
+
+static struct damage damage[MAX_DAMAGE];
+static int	num_damage = 0;
+static XtWorkProcId damage_proc = 0;
+
+static Boolean
+damage_workproc(XtPointer client_data)
+{
+    (void)client_data;
+
+    damage_proc = 0;
+    redisplay_damage();
+    return True;
+}
+
+static void
+add_damage(int xmin, int ymin, int xmax, int ymax)
+{
+    int		    i;
+
+    /* merge with all regions that overlap the new one */
+    for (i = 0; i < num_damage; ) {
+	struct damage *d = &damage[i];
+
+	if (overlapping(xmin, ymin, xmax, ymax,
+			d->xmin, d->ymin, d->xmax, d->ymax)) {
+	    xmin = min2(xmin, d->xmin);
+	    ymin = min2(ymin, d->ymin);
+	    xmax = max2(xmax, d->xmax);
+	    ymax = max2(ymax, d->ymax);
+	    damage[i] = damage[--num_damage];
+	    i = 0;
+	} else {
+	    ++i;
+	}
+    }
+    /* too many regions, draw their bounding box */
+    if (num_damage == MAX_DAMAGE) {
+	for (i = 0; i < num_damage; ++i) {
+	    xmin = min2(xmin, damage[i].xmin);
+	    ymin = min2(ymin, damage[i].ymin);
+	    xmax = max2(xmax, damage[i].xmax);
+	    ymax = max2(ymax, damage[i].ymax);
+	}
+	num_damage = 0;
+    }
+    damage[num_damage].xmin = xmin;
+    damage[num_damage].ymin = ymin;
+    damage[num_damage].xmax = xmax;
+    damage[num_damage].ymax = ymax;
+    ++num_damage;
+
+    if (!damage_proc)
+	damage_proc = XtAppAddWorkProc(tool_app, damage_workproc, NULL);
+}
+
+static void
+discard_damage(void)
+{
+    num_damage = 0;
+    if (damage_proc) {
+	XtRemoveWorkProc(damage_proc);
+	damage_proc = 0;
+    }
+}
+
+/* draw the pending regions now */
+void
+redisplay_damage(void)
+{
+    int		    i, n;
+
+    /* the regions are on the main canvas, wait until we draw there again */
+    if (num_damage == 0 || canvas_win != main_canvas)
+	return;
+    /* not from within redraw_region(), that would lose its clip window;
+       leave the regions to the work procedure */
+    if (in_redraw) {
+	if (!damage_proc)
+	    damage_proc = XtAppAddWorkProc(tool_app, damage_workproc, NULL);
+	return;
+    }
+    n = num_damage;
+    discard_damage();
+
+    if (preview_in_progress) {
+	request_redraw = True;
+	return;
+    }
+    set_temp_cursor(wait_cursor);
+    for (i = 0; i < n; ++i)
+	redraw_region(ZOOMX(damage[i].xmin), ZOOMY(damage[i].ymin),
+		      ZOOMX(damage[i].xmax), ZOOMY(damage[i].ymax));
     reset_cursor();
 }
 
@@ -577,17 +651,37 @@ void draw_pb(int x, int y, int w, int h)
 	zXDrawLine(tool_d, canvas_win, border_gc, x,   y+h, x,   y);
 }
 
+/*
+ * The objects in the region, given in figure coordinates, may have been
+ * changed in an unknown way. The redisplay_<object>() functions below
+ * update the spatial index and the layer cache only for their objects and
+ * call zoomed_region() and regions() directly.
+ */
+
 void redisplay_zoomed_region(int xmin, int ymin, int xmax, int ymax)
 {
-    redisplay_region(ZOOMX(xmin), ZOOMY(ymin), ZOOMX(xmax), ZOOMY(ymax));
+    spatial_modified();
+    invalidate_layer_cache(-1);
+    zoomed_region(xmin, ymin, xmax, ymax);
+}
+
+static void
+zoomed_region(int xmin, int ymin, int xmax, int ymax)
+{
+    if (canvas_win == main_canvas)
+	add_damage(xmin, ymin, xmax, ymax);
+    else
+	redisplay_region(ZOOMX(xmin), ZOOMY(ymin), ZOOMX(xmax), ZOOMY(ymax));
 }
 
 void redisplay_ellipse(F_ellipse *e)
 {
     int		    xmin, ymin, xmax, ymax;
 
+    spatial_update(O_ELLIPSE, e);
+    layer_cache_changed(O_ELLIPSE, e);
     ellipse_bound(e, &xmin, &ymin, &xmax, &ymax);
-    redisplay_zoomed_region(xmin, ymin, xmax, ymax);
+    zoomed_region(xmin, ymin, xmax, ymax);
 }
 
 void redisplay_ellipses(F_ellipse *e1, F_ellipse *e2)
@@ -595,9 +689,13 @@ void redisplay_ellipses(F_ellipse *e1, F_ellipse *e2)
     int		    xmin1, ymin1, xmax1, ymax1;
     int		    xmin2, ymin2, xmax2, ymax2;
 
+    spatial_update(O_ELLIPSE, e1);
+    layer_cache_changed(O_ELLIPSE, e1);
+    spatial_update(O_ELLIPSE, e2);
+    layer_cache_changed(O_ELLIPSE, e2);
     ellipse_bound(e1, &xmin1, &ymin1, &xmax1, &ymax1);
     ellipse_bound(e2, &xmin2, &ymin2, &xmax2, &ymax2);
-    redisplay_regions(xmin1, ymin1, xmax1, ymax1, xmin2, ymin2, xmax2, ymax2);
+    regions(xmin1, ymin1, xmax1, ymax1, xmin2, ymin2, xmax2, ymax2);
 }
 
 void redisplay_arc(F_arc *a)
@@ -605,6 +703,8 @@ void redisplay_arc(F_arc *a)
     int		    xmin, ymin, xmax, ymax;
     int		    cx, cy;
 
+    spatial_update(O_ARC, a);
+    layer_cache_changed(O_ARC, a);
     arc_bound(a, &xmin, &ymin, &xmax, &ymax);
     /* if vertices (and center point) are shown, make sure to include them in the clip area */
     if (appres.shownums) {
@@ -626,7 +726,7 @@ void redisplay_arc(F_arc *a)
 	if (cy > ymax-80)
 	    ymax = cy;
     }
-    redisplay_zoomed_region(xmin, ymin, xmax, ymax);
+    zoomed_region(xmin, ymin, xmax, ymax);
 }
 
 void redisplay_arcs(F_arc *a1, F_arc *a2)
@@ -634,17 +734,23 @@ void redisplay_arcs(F_arc *a1, F_arc *a2)
     int		    xmin1, ymin1, xmax1, ymax1;
     int		    xmin2, ymin2, xmax2, ymax2;
 
+    spatial_update(O_ARC, a1);
+    layer_cache_changed(O_ARC, a1);
+    spatial_update(O_ARC, a2);
+    layer_cache_changed(O_ARC, a2);
     arc_bound(a1, &xmin1, &ymin1, &xmax1, &ymax1);
     arc_bound(a2, &xmin2, &ymin2, &xmax2, &ymax2);
-    redisplay_regions(xmin1, ymin1, xmax1, ymax1, xmin2, ymin2, xmax2, ymax2);
+    regions(xmin1, ymin1, xmax1, ymax1, xmin2, ymin2, xmax2, ymax2);
 }
 
 void redisplay_spline(F_spline *s)
 {
     int		    xmin, ymin, xmax, ymax;
 
+    spatial_update(O_SPLINE, s);
+    layer_cache_changed(O_SPLINE, s);
     spline_bound(s, &xmin, &ymin, &xmax, &ymax);
-    redisplay_zoomed_region(xmin, ymin, xmax, ymax);
+    zoomed_region(xmin, ymin, xmax, ymax);
 }
 
 void redisplay_splines(F_spline *s1, F_spline *s2)
@@ -652,17 +758,23 @@ void redisplay_splines(F_spline *s1, F_spline *s2)
     int		    xmin1, ymin1, xmax1, ymax1;
     int		    xmin2, ymin2, xmax2, ymax2;
 
+    spatial_update(O_SPLINE, s1);
+    layer_cache_changed(O_SPLINE, s1);
+    spatial_update(O_SPLINE, s2);
+    layer_cache_changed(O_SPLINE, s2);
     spline_bound(s1, &xmin1, &ymin1, &xmax1, &ymax1);
     spline_bound(s2, &xmin2, &ymin2, &xmax2, &ymax2);
-    redisplay_regions(xmin1, ymin1, xmax1, ymax1, xmin2, ymin2, xmax2, ymax2);
+    regions(xmin1, ymin1, xmax1, ymax1, xmin2, ymin2, xmax2, ymax2);
 }
 
 void redisplay_line(F_line *l)
 {
     int		    xmin, ymin, xmax, ymax;
 
+    spatial_update(O_POLYLINE, l);
+    layer_cache_changed(O_POLYLINE, l);
     line_bound(l, &xmin, &ymin, &xmax, &ymax);
-    redisplay_zoomed_region(xmin, ymin, xmax, ymax);
+    zoomed_region(xmin, ymin, xmax, ymax);
 }
 
 void redisplay_lines(F_line *l1, F_line *l2)
@@ -670,23 +782,33 @@ void redisplay_lines(F_line *l1, F_line *l2)
     int		    xmin1, ymin1, xmax1, ymax1;
     int		    xmin2, ymin2, xmax2, ymax2;
 
+    spatial_update(O_POLYLINE, l1);
+    layer_cache_changed(O_POLYLINE, l1);
+    spatial_update(O_POLYLINE, l2);
+    layer_cache_changed(O_POLYLINE, l2);
     line_bound(l1, &xmin1, &ymin1, &xmax1, &ymax1);
     line_bound(l2, &xmin2, &ymin2, &xmax2, &ymax2);
-    redisplay_regions(xmin1, ymin1, xmax1, ymax1, xmin2, ymin2, xmax2, ymax2);
+    regions(xmin1, ymin1, xmax1, ymax1, xmin2, ymin2, xmax2, ymax2);
 }
 
 void redisplay_compound(F_compound *c)
 {
-    redisplay_zoomed_region(c->nwcorner.x, c->nwcorner.y,
-			    c->secorner.x, c->secorner.y);
+    spatial_update(O_COMPOUND, c);
+    layer_cache_changed(O_COMPOUND, c);
+    zoomed_region(c->nwcorner.x, c->nwcorner.y,
+		  c->secorner.x, c->secorner.y);
 }
 
 void redisplay_compounds(F_compound *c1, F_compound *c2)
 {
-    redisplay_regions(c1->nwcorner.x, c1->nwcorner.y,
-		      c1->secorner.x, c1->secorner.y,
-		      c2->nwcorner.x, c2->nwcorner.y,
-		      c2->secorner.x, c2->secorner.y);
+    spatial_update(O_COMPOUND, c1);
+    layer_cache_changed(O_COMPOUND, c1);
+    spatial_update(O_COMPOUND, c2);
+    layer_cache_changed(O_COMPOUND, c2);
+    regions(c1->nwcorner.x, c1->nwcorner.y,
+	    c1->secorner.x, c1->secorner.y,
+	    c2->nwcorner.x, c2->nwcorner.y,
+	    c2->secorner.x, c2->secorner.y);
 }
 
 void redisplay_text(F_text *t)
@@ -694,9 +816,11 @@ void redisplay_text(F_text *t)
     int		    xmin, ymin, xmax, ymax;
     int		    dum;
 
+    spatial_update(O_TXT, t);
+    layer_cache_changed(O_TXT, t);
     text_bound(t, &xmin, &ymin, &xmax, &ymax,
 		&dum,&dum,&dum,&dum,&dum,&dum,&dum,&dum);
-    redisplay_zoomed_region(xmin, ymin, xmax, ymax);
+    zoomed_region(xmin, ymin, xmax, ymax);
 }
 
 void redisplay_texts(F_text *t1, F_text *t2)
@@ -705,27 +829,40 @@ void redisplay_texts(F_text *t1, F_text *t2)
     int		    xmin2, ymin2, xmax2, ymax2;
     int		    dum;
 
+    spatial_update(O_TXT, t1);
+    layer_cache_changed(O_TXT, t1);
+    spatial_update(O_TXT, t2);
+    layer_cache_changed(O_TXT, t2);
     text_bound(t1, &xmin1, &ymin1, &xmax1, &ymax1,
 		&dum,&dum,&dum,&dum,&dum,&dum,&dum,&dum);
     text_bound(t2, &xmin2, &ymin2, &xmax2, &ymax2,
 		&dum,&dum,&dum,&dum,&dum,&dum,&dum,&dum);
-    redisplay_regions(xmin1, ymin1, xmax1, ymax1,
-		      xmin2, ymin2, xmax2, ymax2);
+    regions(xmin1, ymin1, xmax1, ymax1,
+	    xmin2, ymin2, xmax2, ymax2);
 }
 
 void redisplay_regions(int xmin1, int ymin1, int xmax1, int ymax1, int xmin2, int ymin2, int xmax2, int ymax2)
+{
+    spatial_modified();
+    invalidate_layer_cache(-1);
+    regions(xmin1, ymin1, xmax1, ymax1, xmin2, ymin2, xmax2, ymax2);
+}
+
+static void
+regions(int xmin1, int ymin1, int xmax1, int ymax1,
+	int xmin2, int ymin2, int xmax2, int ymax2)
 {
     if (xmin1 == xmin2 && ymin1 == ymin2 && xmax1 == xmax2 && ymax1 == ymax2) {
-	redisplay_zoomed_region(xmin1, ymin1, xmax1, ymax1);
+	zoomed_region(xmin1, ymin1, xmax1, ymax1);
 	return;
     }
     /* below is easier than sending clip rectangle array to X */
     if (overlapping(xmin1, ymin1, xmax1, ymax1, xmin2, ymin2, xmax2, ymax2)) {
-	redisplay_zoomed_region(min2(xmin1, xmin2), min2(ymin1, ymin2),
-				max2(xmax1, xmax2), max2(ymax1, ymax2));
+	zoomed_region(min2(xmin1, xmin2), min2(ymin1, ymin2),
+		      max2(xmax1, xmax2), max2(ymax1, ymax2));
     } else {
-	redisplay_zoomed_region(xmin1, ymin1, xmax1, ymax1);
-	redisplay_zoomed_region(xmin2, ymin2, xmax2, ymax2);
+	zoomed_region(xmin1, ymin1, xmax1, ymax1);
+	zoomed_region(xmin2, ymin2, xmax2, ymax2);
     }
 }
 
@@ -16,9 +16,11 @@
  */
 
 extern void	redisplay_canvas(void);
+extern void	objects_modified(void);
+extern void	redisplay_layers(void);
+extern void	redisplay_damage(void);
 extern Boolean	request_redraw;		/* set in redisplay_region if called when
 					   preview_in_progress is true */
-extern void	clearcounts(void);		/* clear object counters for each depth */
 extern void	clearallcounts(void);	/* clear all object counters for each depth */
 
 /*
@@ -27,9 +29,7 @@ extern void	clearallcounts(void);	/* clear all object counters for each depth */
  * data structures that will percolate throughout program.
  *
  * One ``counts'' structure for each object type at each nesting depth from 0
- * to MAX_DEPTH - 1.  We track both the number of objects per type per depth,
- * as well as the number of objects drawn so far per type per depth to cut
- * down on search loop overhead.
+ * to MAX_DEPTH - 1.  We track the number of objects per type per depth.
  */
 
 struct counts {
@@ -38,19 +38,15 @@ struct counts {
     unsigned	    num_ellipses;	/* # ellipses at this depth */
     unsigned	    num_splines;	/* # splines at this depth */
     unsigned	    num_texts;		/* # texts at this depth */
-    unsigned	    cnt_arcs;		/* count of arcs drawn at this depth */
-    unsigned	    cnt_lines;		/* count of lines drawn at this depth */
-    unsigned	    cnt_ellipses;	/* count of ellipses drawn at this
-					 * depth */
-    unsigned	    cnt_splines;	/* count of splines drawn at this depth */
-    unsigned	    cnt_texts;		/* count of texts drawn at this depth */
 };
 
 extern struct counts	counts[], saved_counts[];
 extern void redisplay_arc (F_arc *a);
 extern void redisplay_arcs (F_arc *a1, F_arc *a2);
 extern void redisplay_compound (F_compound *c);
-extern void redisplay_compoundobject (F_compound *compounds, int depth);
+extern void redisplay_depth (F_compound *objects, int depth);
+extern void redisplay_depth_region (int depth, int xmin, int ymin,
+				int xmax, int ymax);
 extern void redisplay_compounds (F_compound *c1, F_compound *c2);
 extern void redisplay_ellipse (F_ellipse *e);
 extern void redisplay_ellipses (F_ellipse *e1, F_ellipse *e2);
@@ -0,0 +1,941 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2015 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+/*
+ * Spatial index of the top-level objects of the figure.
+ *
+ * An R-tree (Guttman, quadratic split) over the bounding boxes of the
+ * objects and compounds in the object lists of the figure, used by
+ * redisplay_region() to draw only the objects that overlap the region.
+ *
+ * The index is updated incrementally,
+ *  - by list_add_*() and list_delete_*() on the lists of the figure,
+ *  - by the redisplay_<object>() functions, which are called after an
+ *    object was moved or edited.
+ * If the figure was changed in an unknown way, e.g., by a call to
+ * redisplay_zoomed_region() from outside u_redraw.c, or by any action that
+ * ends in set_modifiedflag() or undo(), spatial_modified() is called and all
+ * bounding boxes are re-computed before the next query.
+ * Only the entries whose bounding box changed are moved in the tree.
+ * If objects were moved between lists without the list routines, the index
+ * is invalidated by invalidate_spatial_index() and rebuilt on the next query.
+ */
+
+#include "fig.h"
+#include "resources.h"
+#include "object.h"
+#include "u_bound.h"
+#include "u_depth.h"
+#include "u_rtree.h"
+#include "w_msgpanel.h"
+
+#define RT_MAX		16	/* maximum number of entries in a node */
+#define RT_MIN		6	/* minimum number of entries in a node */
+
+typedef struct rt_rect {
+	int	xmin, ymin, xmax, ymax;
+} rt_rect;
+
+struct rt_item {
+	int		type;		/* O_ARC, O_COMPOUND, ... */
+	void		*obj;
+	unsigned	seq;		/* position within its object list */
+	rt_rect		r;
+	struct rt_node	*leaf;
+	struct rt_item	*hnext;		/* hash chain */
+};
+
+struct rt_node {
+	struct rt_node	*parent;
+	Boolean		leaf;		/* entries are items, not nodes */
+	int		n;
+	rt_rect		r;
+	void		*e[RT_MAX + 1];	/* one extra slot to allow a split */
+};
+
+static struct rt_node	*root = NULL;
+static Boolean		index_valid = False;
+static Boolean		index_modified = False;
+static unsigned		next_seq = 0;
+
+/* the list heads of the figure, when the index was last synchronized */
+static F_compound	heads;
+
+/* the items, hashed by the address of their objects */
+static struct rt_item	**htab = NULL;
+static int		hsize = 0;
+static int		hcount = 0;
+
+/* scratch space for queries */
+static struct rt_item	**found = NULL;
+static int		num_found, max_found = 0;
+static F_depth_obj	*prims = NULL, *sorted = NULL;
+static int		num_prims, max_prims = 0;
+
+static Boolean	build_index(void);
+static void	insert_item(struct rt_item *item);
+static void	remove_item(struct rt_item *item);
+
+/* rectangle helpers */
+
+#define	rect_entry(node, i)	((node)->leaf ? \
+		&((struct rt_item *)(node)->e[i])->r : \
+		&((struct rt_node *)(node)->e[i])->r)
+
+static double
+rect_area(rt_rect *r)
+{
+	return ((double)r->xmax - r->xmin) * ((double)r->ymax - r->ymin);
+}
+
+static void
+rect_combine(rt_rect *r, rt_rect *s)
+{
+	if (s->xmin < r->xmin) r->xmin = s->xmin;
+	if (s->ymin < r->ymin) r->ymin = s->ymin;
+	if (s->xmax > r->xmax) r->xmax = s->xmax;
+	if (s->ymax > r->ymax) r->ymax = s->ymax;
+}
+
+static double
+rect_enlargement(rt_rect *r, rt_rect *s)
+{
+	rt_rect	u = *r;
+
+	rect_combine(&u, s);
+	return rect_area(&u) - rect_area(r);
+}
+
+static Boolean
+rect_overlap(rt_rect *r, rt_rect *s)
+{
+	return r->xmin <= s->xmax && s->xmin <= r->xmax &&
+		r->ymin <= s->ymax && s->ymin <= r->ymax;
+}
+
+static void
+node_refit(struct rt_node *node)
+{
+	int	i;
+
+	if (node->n == 0) {
+		node->r.xmin = node->r.ymin = node->r.xmax = node->r.ymax = 0;
+		return;
+	}
+	node->r = *rect_entry(node, 0);
+	for (i = 1; i < node->n; ++i)
+		rect_combine(&node->r, rect_entry(node, i));
+}
+
+static struct rt_node *
+new_node(Boolean leaf)
+{
+	struct rt_node	*node;
+
+	if ((node = malloc(sizeof(struct rt_node))) == NULL)
+		return NULL;
+	node->parent = NULL;
+	node->leaf = leaf;
+	node->n = 0;
+	return node;
+}
+
+static void
+set_entry(struct rt_node *node, int i, void *e)
+{
+	node->e[i] = e;
+	if (node->leaf)
+		((struct rt_item *)e)->leaf = node;
+	else
+		((struct rt_node *)e)->parent = node;
+}
+
+/* the hash table of items */
+
+static unsigned
+hash_obj(void *obj)
+{
+	return (unsigned)(((uintptr_t)obj >> 4) * 2654435761u);
+}
+
+static struct rt_item *
+lookup_item(void *obj)
+{
+	struct rt_item	*item;
+
+	if (hsize == 0)
+		return NULL;
+	for (item = htab[hash_obj(obj) & (hsize - 1)]; item; item = item->hnext)
+		if (item->obj == obj)
+			return item;
+	return NULL;
+}
+
+static Boolean
+hash_item(struct rt_item *item)
+{
+	unsigned	h;
+
+	if (hcount >= hsize) {
+		int		i, n = hsize ? 2 * hsize : 1024;
+		struct rt_item	**t, *it, *next;
+
+		if ((t = calloc(n, sizeof(struct rt_item *))) == NULL)
+			return False;
+		for (i = 0; i < hsize; ++i)
+			for (it = htab[i]; it; it = next) {
+				next = it->hnext;
+				h = hash_obj(it->obj) & (n - 1);
+				it->hnext = t[h];
+				t[h] = it;
+			}
+		free(htab);
+		htab = t;
+		hsize = n;
+	}
+	h = hash_obj(item->obj) & (hsize - 1);
+	item->hnext = htab[h];
+	htab[h] = item;
+	++hcount;
+	return True;
+}
+
+static void
+unhash_item(struct rt_item *item)
+{
+	struct rt_item	**p;
+
+	for (p = &htab[hash_obj(item->obj) & (hsize - 1)]; *p; p = &(*p)->hnext)
+		if (*p == item) {
+			*p = item->hnext;
+			--hcount;
+			return;
+		}
+}
+
+/* the R-tree */
+
+/*
+ * Quadratic split of node, which holds RT_MAX + 1 entries.
+ * Return the new sibling, or NULL if out of memory.
+ */
+static struct rt_node *
+split_node(struct rt_node *node)
+{
+	void		*e[RT_MAX + 1];
+	Boolean		assigned[RT_MAX + 1];
+	struct rt_node	*sib;
+	rt_rect		r1, r2;
+	double		d, worst;
+	int		n, i, j, s1 = 0, s2 = 1, remaining;
+
+	if ((sib = new_node(node->leaf)) == NULL)
+		return NULL;
+
+	n = node->n;
+	for (i = 0; i < n; ++i) {
+		e[i] = node->e[i];
+		assigned[i] = False;
+	}
+
+	/* pick the two seeds that would waste the most area */
+	worst = -1.0;
+	for (i = 0; i < n - 1; ++i)
+		for (j = i + 1; j < n; ++j) {
+			rt_rect	u = *rect_entry(node, i);
+
+			rect_combine(&u, rect_entry(node, j));
+			d = rect_area(&u) - rect_area(rect_entry(node, i)) -
+				rect_area(rect_entry(node, j));
+			if (d > worst) {
+				worst = d;
+				s1 = i;
+				s2 = j;
+			}
+		}
+	r1 = *rect_entry(node, s1);
+	r2 = *rect_entry(node, s2);
+	node->n = 0;
+	set_entry(node, node->n++, e[s1]);
+	set_entry(sib, sib->n++, e[s2]);
+	assigned[s1] = assigned[s2] = True;
+
+	for (remaining = n - 2; remaining > 0; --remaining) {
+		int	next = -1;
+		double	d1 = 0.0, d2 = 0.0, diff = -1.0;
+
+		/* one group must take all the rest to have RT_MIN entries */
+		if (node->n + remaining <= RT_MIN || sib->n + remaining <= RT_MIN) {
+			struct rt_node	*g = node->n < sib->n ? node : sib;
+
+			for (i = 0; i < n; ++i)
+				if (!assigned[i]) {
+					set_entry(g, g->n++, e[i]);
+					assigned[i] = True;
+				}
+			break;
+		}
+		/* pick the entry with the greatest preference for one group */
+		for (i = 0; i < n; ++i) {
+			rt_rect	*r;
+			double	a1, a2;
+
+			if (assigned[i])
+				continue;
+			r = node->leaf ? &((struct rt_item *)e[i])->r :
+					&((struct rt_node *)e[i])->r;
+			a1 = rect_enlargement(&r1, r);
+			a2 = rect_enlargement(&r2, r);
+			if (fabs(a1 - a2) > diff) {
+				diff = fabs(a1 - a2);
+				next = i;
+				d1 = a1;
+				d2 = a2;
+			}
+		}
+		assigned[next] = True;
+		if (d1 < d2 || (d1 == d2 && node->n <= sib->n)) {
+			set_entry(node, node->n, e[next]);
+			rect_combine(&r1, rect_entry(node, node->n));
+			++node->n;
+		} else {
+			set_entry(sib, sib->n, e[next]);
+			rect_combine(&r2, rect_entry(sib, sib->n));
+			++sib->n;
+		}
+	}
+	node_refit(node);
+	node_refit(sib);
+	return sib;
+}
+
+/*
+ * Add the entry e to node. Split nodes up to the root as necessary and
+ * adjust the bounding rectangles.
+ */
+static Boolean
+add_entry(struct rt_node *node, void *e)
+{
+	struct rt_node	*sib, *p;
+
+	set_entry(node, node->n++, e);
+	while (node) {
+		p = node->parent;
+		if (node->n <= RT_MAX) {
+			node_refit(node);
+			node = p;
+			continue;
+		}
+		if ((sib = split_node(node)) == NULL) {
+			/* out of memory, leave the tree as it is */
+			--node->n;
+			node_refit(node);
+			return False;
+		}
+		if (p == NULL) {
+			/* grow a new root */
+			if ((p = new_node(False)) == NULL) {
+				free(sib);
+				return False;
+			}
+			set_entry(p, p->n++, node);
+			root = p;
+		}
+		set_entry(p, p->n++, sib);
+		node = p;
+	}
+	return True;
+}
+
+static void
+insert_item(struct rt_item *item)
+{
+	struct rt_node	*node = root;
+	int		i, best;
+	double		d, dmin, area, amin;
+
+	while (!node->leaf) {
+		best = 0;
+		dmin = amin = -1.0;
+		for (i = 0; i < node->n; ++i) {
+			rt_rect	*r = rect_entry(node, i);
+
+			d = rect_enlargement(r, &item->r);
+			area = rect_area(r);
+			if (dmin < 0.0 || d < dmin || (d == dmin && area < amin)) {
+				dmin = d;
+				amin = area;
+				best = i;
+			}
+		}
+		node = node->e[best];
+	}
+	if (!add_entry(node, item))
+		index_valid = False;
+}
+
+/* put all items below node into found[], and free the nodes */
+static void
+collect_items(struct rt_node *node)
+{
+	int	i;
+
+	for (i = 0; i < node->n; ++i) {
+		if (node->leaf) {
+			if (num_found >= max_found) {
+				struct rt_item	**tmp;
+				int		n = max_found ? 2 * max_found : 256;
+
+				if ((tmp = realloc(found,
+					    n * sizeof(struct rt_item *))) == NULL) {
+					index_valid = False;
+					continue;
+				}
+				found = tmp;
+				max_found = n;
+			}
+			found[num_found++] = node->e[i];
+		} else {
+			collect_items(node->e[i]);
+		}
+	}
+	free(node);
+}
+
+static void
+remove_item(struct rt_item *item)
+{
+	struct rt_node	*node = item->leaf, *p;
+	int		i, num_orphans = 0;
+
+	for (i = 0; i < node->n; ++i)
+		if (node->e[i] == item) {
+			node->e[i] = node->e[--node->n];
+			break;
+		}
+
+	/* condense the tree, collect the entries of underfull nodes */
+	num_found = 0;
+	while ((p = node->parent) != NULL) {
+		if (node->n < RT_MIN) {
+			for (i = 0; i < p->n; ++i)
+				if (p->e[i] == node) {
+					p->e[i] = p->e[--p->n];
+					break;
+				}
+			collect_items(node);
+		} else {
+			node_refit(node);
+		}
+		node = p;
+	}
+	node_refit(root);
+
+	/* shorten the tree */
+	while (!root->leaf && root->n == 1) {
+		p = root->e[0];
+		free(root);
+		root = p;
+		root->parent = NULL;
+	}
+	if (!root->leaf && root->n == 0) {
+		root->leaf = True;
+		node_refit(root);
+	}
+
+	/* re-insert the orphans; found[] may be reused by insert_item() */
+	num_orphans = num_found;
+	for (i = 0; i < num_orphans && index_valid; ++i)
+		insert_item(found[i]);
+}
+
+static void
+search_tree(struct rt_node *node, rt_rect *r)
+{
+	int	i;
+
+	for (i = 0; i < node->n; ++i) {
+		if (!rect_overlap(rect_entry(node, i), r))
+			continue;
+		if (!node->leaf) {
+			search_tree(node->e[i], r);
+			continue;
+		}
+		if (num_found >= max_found) {
+			struct rt_item	**tmp;
+			int		n = max_found ? 2 * max_found : 256;
+
+			if ((tmp = realloc(found, n * sizeof(struct rt_item *)))
+					== NULL) {
+				index_valid = False;
+				return;
+			}
+			found = tmp;
+			max_found = n;
+		}
+		found[num_found++] = node->e[i];
+	}
+}
+
+static void
+free_tree(struct rt_node *node)
+{
+	int	i;
+
+	for (i = 0; i < node->n; ++i) {
+		if (node->leaf)
+			free(node->e[i]);
+		else
+			free_tree(node->e[i]);
+	}
+	free(node);
+}
+
+/* the figure */
+
+/*
+ * arrow_bound() returns the points of the arrowheads; their outline reaches
+ * half the arrow thickness further out.
+ */
+static int
+arrow_pad(F_arrow *for_arrow, F_arrow *back_arrow)
+{
+	float	t = 0.0;
+
+	if (for_arrow)
+		t = for_arrow->thickness;
+	if (back_arrow && back_arrow->thickness > t)
+		t = back_arrow->thickness;
+	return t > 0.0 ? (int)(t * ZOOM_FACTOR / 2.0) + 1 : 0;
+}
+
+static int
+compound_arrow_pad(F_compound *c)
+{
+	int		pad = 0, p;
+	F_compound	*cc;
+	F_line		*l;
+	F_spline	*s;
+
+	for (l = c->lines; l != NULL; l = l->next)
+		if ((p = arrow_pad(l->for_arrow, l->back_arrow)) > pad)
+			pad = p;
+	for (s = c->splines; s != NULL; s = s->next)
+		if ((p = arrow_pad(s->for_arrow, s->back_arrow)) > pad)
+			pad = p;
+	for (cc = c->compounds; cc != NULL; cc = cc->next)
+		if ((p = compound_arrow_pad(cc)) > pad)
+			pad = p;
+	return pad;
+}
+
+static void
+object_rect(int type, void *obj, rt_rect *r)
+{
+	int	dum;
+	int	pad = 0;
+
+	switch (type) {
+	case O_ARC:
+		arc_bound(obj, &r->xmin, &r->ymin, &r->xmax, &r->ymax);
+		break;
+	case O_COMPOUND:
+		compound_bound(obj, &r->xmin, &r->ymin, &r->xmax, &r->ymax);
+		pad = compound_arrow_pad(obj);
+		break;
+	case O_ELLIPSE:
+		ellipse_bound(obj, &r->xmin, &r->ymin, &r->xmax, &r->ymax);
+		break;
+	case O_POLYLINE:
+		line_bound(obj, &r->xmin, &r->ymin, &r->xmax, &r->ymax);
+		pad = arrow_pad(((F_line *)obj)->for_arrow,
+				((F_line *)obj)->back_arrow);
+		break;
+	case O_SPLINE:
+		spline_bound(obj, &r->xmin, &r->ymin, &r->xmax, &r->ymax);
+		pad = arrow_pad(((F_spline *)obj)->for_arrow,
+				((F_spline *)obj)->back_arrow);
+		break;
+	case O_TXT:
+		text_bound(obj, &r->xmin, &r->ymin, &r->xmax, &r->ymax,
+				&dum, &dum, &dum, &dum, &dum, &dum, &dum, &dum);
+		break;
+	}
+	r->xmin -= pad;
+	r->ymin -= pad;
+	r->xmax += pad;
+	r->ymax += pad;
+}
+
+static void
+save_heads(void)
+{
+	heads.arcs = objects.arcs;
+	heads.compounds = objects.compounds;
+	heads.ellipses = objects.ellipses;
+	heads.lines = objects.lines;
+	heads.splines = objects.splines;
+	heads.texts = objects.texts;
+	heads.parent = objects.parent;
+}
+
+/* compare the list heads, except the head of the list of type */
+static Boolean
+heads_changed(int type)
+{
+	return (type != O_ARC && heads.arcs != objects.arcs) ||
+		(type != O_COMPOUND && heads.compounds != objects.compounds) ||
+		(type != O_ELLIPSE && heads.ellipses != objects.ellipses) ||
+		(type != O_POLYLINE && heads.lines != objects.lines) ||
+		(type != O_SPLINE && heads.splines != objects.splines) ||
+		(type != O_TXT && heads.texts != objects.texts) ||
+		heads.parent != objects.parent;
+}
+
+static void
+free_index(void)
+{
+	if (root)
+		free_tree(root);
+	root = NULL;
+	if (htab)
+		memset(htab, 0, hsize * sizeof(struct rt_item *));
+	hcount = 0;
+	index_valid = False;
+}
+
+static Boolean
+add_object(int type, void *obj)
+{
+	struct rt_item	*item;
+
+	if ((item = malloc(sizeof(struct rt_item))) == NULL)
+		return False;
+	item->type = type;
+	item->obj = obj;
+	item->seq = next_seq++;
+	object_rect(type, obj, &item->r);
+	if (!hash_item(item)) {
+		free(item);
+		return False;
+	}
+	insert_item(item);
+	return index_valid;
+}
+
+static Boolean
+build_index(void)
+{
+	F_arc		*a;
+	F_compound	*c;
+	F_ellipse	*e;
+	F_line		*l;
+	F_spline	*s;
+	F_text		*t;
+
+	free_index();
+	if ((root = new_node(True)) == NULL)
+		return False;
+	index_valid = True;
+	index_modified = False;
+	next_seq = 0;
+	for (a = objects.arcs; a && index_valid; a = a->next)
+		add_object(O_ARC, a);
+	for (c = objects.compounds; c && index_valid; c = c->next)
+		add_object(O_COMPOUND, c);
+	for (e = objects.ellipses; e && index_valid; e = e->next)
+		add_object(O_ELLIPSE, e);
+	for (l = objects.lines; l && index_valid; l = l->next)
+		add_object(O_POLYLINE, l);
+	for (s = objects.splines; s && index_valid; s = s->next)
+		add_object(O_SPLINE, s);
+	for (t = objects.texts; t && index_valid; t = t->next)
+		add_object(O_TXT, t);
+	if (!index_valid) {
+		put_msg("Running out of memory.");
+		free_index();
+		return False;
+	}
+	save_heads();
+	if (appres.DEBUG)
+		fprintf(stderr, "spatial index rebuilt, %d objects\n", hcount);
+	return True;
+}
+
+/* re-compute all bounding boxes, move the entries that changed */
+static void
+refit_index(void)
+{
+	struct rt_item	*item, **items;
+	rt_rect		r;
+	int		i, n = 0;
+
+	index_modified = False;
+	if (hcount == 0)
+		return;
+	if ((items = malloc(hcount * sizeof(struct rt_item *))) == NULL) {
+		free_index();
+		return;
+	}
+	for (i = 0; i < hsize; ++i)
+		for (item = htab[i]; item; item = item->hnext)
+			items[n++] = item;
+	for (i = 0; i < n && index_valid; ++i) {
+		item = items[i];
+		object_rect(item->type, item->obj, &r);
+		if (r.xmin == item->r.xmin && r.ymin == item->r.ymin &&
+				r.xmax == item->r.xmax && r.ymax == item->r.ymax)
+			continue;
+		remove_item(item);
+		item->r = r;
+		insert_item(item);
+	}
+	free(items);
+}
+
+/*
+ * The object lists of the figure were changed such that the index cannot
+ * follow; rebuild it before the next query.
+ */
+void
+invalidate_spatial_index(void)
+{
+	index_valid = False;
+}
+
+/* objects of the figure may have been moved or changed */
+void
+spatial_modified(void)
+{
+	index_modified = True;
+}
+
+/* obj was appended to its list in the figure */
+void
+spatial_add(int type, void *obj)
+{
+	if (!index_valid)
+		return;
+	if (heads_changed(type) || !add_object(type, obj)) {
+		free_index();
+		return;
+	}
+	save_heads();
+}
+
+/* obj was removed from its list in the figure */
+void
+spatial_delete(void *obj)
+{
+	struct rt_item	*item;
+
+	if (!index_valid)
+		return;
+	if ((item = lookup_item(obj)) == NULL || heads_changed(item->type)) {
+		free_index();
+		return;
+	}
+	unhash_item(item);
+	remove_item(item);
+	free(item);
+	if (index_valid)
+		save_heads();
+}
+
+/* obj was moved or changed; nothing happens, if obj is not in the index */
+void
+spatial_update(int type, void *obj)
+{
+	struct rt_item	*item;
+	rt_rect		r;
+
+	if (!index_valid || (item = lookup_item(obj)) == NULL)
+		return;
+	object_rect(type, obj, &r);
+	if (r.xmin == item->r.xmin && r.ymin == item->r.ymin &&
+			r.xmax == item->r.xmax && r.ymax == item->r.ymax)
+		return;
+	remove_item(item);
+	item->r = r;
+	insert_item(item);
+}
+
+/* drawing order of the object lists, see index_compound() in u_depth.c */
+static int
+list_rank(int type)
+{
+	switch (type) {
+	case O_ARC:		return 0;
+	case O_COMPOUND:	return 1;
+	case O_ELLIPSE:		return 2;
+	case O_POLYLINE:	return 3;
+	case O_SPLINE:		return 4;
+	default:		return 5;	/* O_TXT */
+	}
+}
+
+static int
+cmp_items(const void *a, const void *b)
+{
+	const struct rt_item	*i = *(struct rt_item * const *)a;
+	const struct rt_item	*j = *(struct rt_item * const *)b;
+	int			d = list_rank(i->type) - list_rank(j->type);
+
+	if (d)
+		return d;
+	return i->seq < j->seq ? -1 : i->seq > j->seq;
+}
+
+static void
+add_prim(int type, int depth, void *obj)
+{
+	if (num_prims >= max_prims) {
+		int		n = max_prims ? 2 * max_prims : 256;
+		F_depth_obj	*tmp;
+
+		if ((tmp = realloc(prims, n * sizeof(F_depth_obj))) == NULL) {
+			index_valid = False;
+			return;
+		}
+		prims = tmp;
+		max_prims = n;
+	}
+	if (depth < 0)
+		depth = 0;
+	else if (depth > MAX_DEPTH)
+		depth = MAX_DEPTH;
+	prims[num_prims].type = type;
+	prims[num_prims].depth = depth;
+	prims[num_prims].obj = obj;
+	++num_prims;
+}
+
+static void
+add_prims(F_compound *c)
+{
+	F_arc		*a;
+	F_compound	*cc;
+	F_ellipse	*e;
+	F_line		*l;
+	F_spline	*s;
+	F_text		*t;
+
+	for (a = c->arcs; a != NULL; a = a->next)
+		add_prim(O_ARC, a->depth, a);
+	for (cc = c->compounds; cc != NULL; cc = cc->next)
+		add_prims(cc);
+	for (e = c->ellipses; e != NULL; e = e->next)
+		add_prim(O_ELLIPSE, e->depth, e);
+	for (l = c->lines; l != NULL; l = l->next)
+		add_prim(O_POLYLINE, l->depth, l);
+	for (s = c->splines; s != NULL; s = s->next)
+		add_prim(O_SPLINE, s->depth, s);
+	for (t = c->texts; t != NULL; t = t->next)
+		add_prim(O_TXT, t->depth, t);
+}
+
+/*
+ * Return in objs the primitive objects within root that may overlap the
+ * rectangle given in figure coordinates, sorted by decreasing depth. Within
+ * one depth, the objects are in the same order as in the depth index.
+ * Return False, if the index cannot be used; then, the caller must draw
+ * all objects.
+ */
+Boolean
+spatial_query(F_compound *root_c, int xmin, int ymin, int xmax, int ymax,
+		F_depth_obj **objs, int *num)
+{
+	static int	start[MAX_DEPTH + 2];
+	rt_rect		r;
+	F_depth_obj	*tmp;
+	int		i, d;
+
+	if (root_c != &objects)
+		return False;
+	if (!index_valid || heads_changed(-1)) {
+		if (!build_index())
+			return False;
+	} else if (index_modified) {
+		refit_index();
+		if (!index_valid && !build_index())
+			return False;
+	}
+
+	r.xmin = xmin;
+	r.ymin = ymin;
+	r.xmax = xmax;
+	r.ymax = ymax;
+	/* the region covers all objects, nothing to gain */
+	if (root->n == 0 || (r.xmin <= root->r.xmin && r.ymin <= root->r.ymin &&
+			r.xmax >= root->r.xmax && r.ymax >= root->r.ymax))
+		return False;
+
+	num_found = 0;
+	search_tree(root, &r);
+	if (!index_valid)
+		return False;
+	qsort(found, num_found, sizeof(struct rt_item *), cmp_items);
+
+	num_prims = 0;
+	for (i = 0; i < num_found; ++i) {
+		struct rt_item	*item = found[i];
+
+		switch (item->type) {
+		case O_COMPOUND:
+			add_prims(item->obj);
+			break;
+		case O_ARC:
+			add_prim(O_ARC, ((F_arc *)item->obj)->depth, item->obj);
+			break;
+		case O_ELLIPSE:
+			add_prim(O_ELLIPSE, ((F_ellipse *)item->obj)->depth,
+					item->obj);
+			break;
+		case O_POLYLINE:
+			add_prim(O_POLYLINE, ((F_line *)item->obj)->depth,
+					item->obj);
+			break;
+		case O_SPLINE:
+			add_prim(O_SPLINE, ((F_spline *)item->obj)->depth,
+					item->obj);
+			break;
+		case O_TXT:
+			add_prim(O_TXT, ((F_text *)item->obj)->depth,
+					item->obj);
+			break;
+		}
+	}
+	if (!index_valid)
+		return False;
+
+	/* stable counting sort, by decreasing depth */
+	if ((tmp = realloc(sorted, max_prims * sizeof(F_depth_obj))) == NULL)
+		return False;
+	sorted = tmp;
+	memset(start, 0, sizeof(start));
+	for (i = 0; i < num_prims; ++i)
+		++start[MAX_DEPTH - prims[i].depth + 1];
+	for (d = 1; d <= MAX_DEPTH + 1; ++d)
+		start[d] += start[d - 1];
+	for (i = 0; i < num_prims; ++i)
+		sorted[start[MAX_DEPTH - prims[i].depth]++] = prims[i];
+
+	*objs = sorted;
+	*num = num_prims;
+	return True;
+}
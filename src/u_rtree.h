@@ -0,0 +1,32 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2015 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+#ifndef U_RTREE_H
+#define U_RTREE_H
+
+/* requires u_depth.h */
+
+extern void	invalidate_spatial_index(void);
+extern void	spatial_modified(void);
+extern void	spatial_add(int type, void *obj);
+extern void	spatial_delete(void *obj);
+extern void	spatial_update(int type, void *obj);
+extern Boolean	spatial_query(F_compound *root, int xmin, int ymin,
+			int xmax, int ymax, F_depth_obj **objs, int *num);
+
+#endif /* U_RTREE_H */
@@ -0,0 +1,442 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2015 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+/*
+ * Run loops over rows in parallel, and run jobs in the background.
+ *
+ * parallel_rows() cuts the rows into bands of ROWS_PER_BAND rows. The
+ * calling thread and the workers take bands until all rows are done.
+ * Between two bands, the calling thread checks whether the user pressed
+ * the cancel button. The workers are started on first use and then wait
+ * for the next job. Without pthreads, the calling thread does all bands.
+ *
+ * background_job() queues a job for other worker threads. When the job is
+ * done, the event loop of the main thread learns about it through a pipe,
+ * and calls the done() function of the job. Messages from the workers,
+ * see file_msg(), are passed the same way. Without pthreads, jobs are run
+ * by a work procedure, whenever xfig is idle.
+ */
+
+#include "fig.h"
+#include "resources.h"
+#include "u_threads.h"
+#include "w_file.h"		/* check_cancel() */
+#include "w_msgpanel.h"		/* file_msg() */
+
+#ifdef HAVE_PTHREAD
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#define ROWS_PER_BAND	16
+#define MAX_THREADS	16
+
+/*
+ * Return the number of threads to use, including the calling thread.
+ * The resource "threads" gives the number, 0 means one per processor.
+ */
+int
+thread_count(void)
+{
+#ifdef HAVE_PTHREAD
+	long	n = appres.threads;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	if (n <= 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (n < 1)
+		n = 1;
+	else if (n > MAX_THREADS)
+		n = MAX_THREADS;
+	return (int)n;
+#else
+	return 1;
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+
+static pthread_mutex_t	lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	done_cond = PTHREAD_COND_INITIALIZER;
+static int		nworkers = -1;		/* -1: not started yet */
+static pthread_t	main_thread;
+static Boolean		main_known = False;
+
+/* the current job, protected by lock */
+static struct {
+	void		(*rows)(void *arg, int first, int last);
+	void		*arg;
+	int		nrows;
+	int		next;		/* first row not yet taken */
+	int		busy;		/* workers inside the job */
+	unsigned	generation;	/* incremented for each job */
+} job;
+
+/* the worker threads are busy with job, see parallel_rows() */
+static Boolean		job_active = False;
+
+/* take the next band, with lock held; return False if there is none */
+static Boolean
+take_band(int *first, int *last)
+{
+	if (job.next >= job.nrows)
+		return False;
+	*first = job.next;
+	*last = min2(job.next + ROWS_PER_BAND, job.nrows);
+	job.next = *last;
+	return True;
+}
+
+static void *
+worker(void *unused)
+{
+	unsigned	seen = 0;
+	int		first, last;
+
+	(void)unused;
+	pthread_mutex_lock(&lock);
+	for (;;) {
+		while (job.generation == seen)
+			pthread_cond_wait(&work_cond, &lock);
+		seen = job.generation;
+		++job.busy;
+		while (take_band(&first, &last)) {
+			pthread_mutex_unlock(&lock);
+			job.rows(job.arg, first, last);
+			pthread_mutex_lock(&lock);
+		}
+		if (--job.busy == 0)
+			pthread_cond_signal(&done_cond);
+	}
+	/* NOTREACHED */
+	return NULL;
+}
+
+static void
+start_workers(void)
+{
+	pthread_t	thread;
+	sigset_t	all, old;
+	int		i, n;
+
+	nworkers = 0;
+	main_thread = pthread_self();
+	main_known = True;
+	n = thread_count() - 1;
+	/* signals are for the main thread, the workers inherit this mask */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	for (i = 0; i < n; ++i) {
+		if (pthread_create(&thread, NULL, worker, NULL) != 0)
+			break;
+		pthread_detach(thread);
+		++nworkers;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (appres.DEBUG)
+		fprintf(stderr, "Started %d worker threads\n", nworkers);
+}
+
+#endif /* HAVE_PTHREAD */
+
+/*
+ * Call rows(arg, first, last) for consecutive ranges of the rows 0 to
+ * nrows - 1, in this and in the worker threads. Return False if the user
+ * cancelled, then some rows may not be done.
+ * No events are processed while the worker threads take part, an event
+ * handler could start another job. A nested call does its rows here.
+ */
+Boolean
+parallel_rows(void (*rows)(void *arg, int first, int last), void *arg,
+		int nrows)
+{
+	int	first, last;
+
+#ifdef HAVE_PTHREAD
+	if (nworkers < 0)
+		start_workers();
+
+	if (nworkers > 0 && nrows > ROWS_PER_BAND && !job_active) {
+		job_active = True;
+		pthread_mutex_lock(&lock);
+		job.rows = rows;
+		job.arg = arg;
+		job.nrows = nrows;
+		job.next = 0;
+		++job.generation;
+		pthread_cond_broadcast(&work_cond);
+		while (take_band(&first, &last)) {
+			pthread_mutex_unlock(&lock);
+			rows(arg, first, last);
+			pthread_mutex_lock(&lock);
+		}
+		/* workers that join late find no band left */
+		while (job.busy > 0)
+			pthread_cond_wait(&done_cond, &lock);
+		pthread_mutex_unlock(&lock);
+		job_active = False;
+		/* now, events may be processed */
+		return !check_cancel();
+	}
+#endif
+
+	for (first = 0; first < nrows; first = last) {
+		last = min2(first + ROWS_PER_BAND, nrows);
+		rows(arg, first, last);
+		if (check_cancel())
+			return False;
+	}
+	return True;
+}
+
+/*
+ * Background jobs. The lists todo and finished are kept in the order of
+ * the calls to background_job(). Messages are put on the finished list.
+ */
+
+struct job {
+	void		(*work)(void *arg);
+	void		(*done)(void *arg);
+	void		*arg;
+	char		*msg;		/* a message instead of a job */
+	struct job	*next;
+};
+
+static struct job	*todo = NULL, *todo_last = NULL;
+
+static void
+append(struct job **first, struct job **last, struct job *job)
+{
+	job->next = NULL;
+	if (*last)
+		(*last)->next = job;
+	else
+		*first = job;
+	*last = job;
+}
+
+static struct job *
+take(struct job **first, struct job **last)
+{
+	struct job	*job = *first;
+
+	if (job) {
+		*first = job->next;
+		if (*first == NULL)
+			*last = NULL;
+	}
+	return job;
+}
+
+static void
+finish(struct job *job)
+{
+	if (job->msg) {
+		file_msg("%s", job->msg);
+		free(job->msg);
+	} else {
+		job->done(job->arg);
+	}
+	free(job);
+}
+
+/* without threads, run one job each time xfig is idle */
+static Boolean
+run_idle_job(XtPointer client_data)
+{
+	struct job	*job;
+
+	(void)client_data;
+	if ((job = take(&todo, &todo_last)) == NULL)
+		return True;
+	job->work(job->arg);
+	finish(job);
+	return todo == NULL;
+}
+
+#ifdef HAVE_PTHREAD
+
+static pthread_mutex_t	queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	todo_cond = PTHREAD_COND_INITIALIZER;
+static struct job	*finished = NULL, *finished_last = NULL;
+static int		nbackground = -1;	/* -1: not started yet */
+static int		wake_fd[2];		/* finished jobs, see finish() */
+
+/* with queue_lock held */
+static void
+put_finished(struct job *job)
+{
+	char	c = 0;
+
+	if (finished == NULL && write(wake_fd[1], &c, 1) < 0 &&
+			appres.DEBUG)
+		perror("xfig: waking up the main thread");
+	append(&finished, &finished_last, job);
+}
+
+static void *
+background_worker(void *unused)
+{
+	struct job	*job;
+
+	(void)unused;
+	pthread_mutex_lock(&queue_lock);
+	for (;;) {
+		while ((job = take(&todo, &todo_last)) == NULL)
+			pthread_cond_wait(&todo_cond, &queue_lock);
+		pthread_mutex_unlock(&queue_lock);
+		job->work(job->arg);
+		pthread_mutex_lock(&queue_lock);
+		put_finished(job);
+	}
+	/* NOTREACHED */
+	return NULL;
+}
+
+/* called from the event loop when the pipe is readable */
+static void
+finished_jobs(XtPointer client_data, int *fd, XtInputId *id)
+{
+	char		buf[32];
+	struct job	*list, *list_last, *job;
+
+	(void)client_data;
+	(void)id;
+	while (read(*fd, buf, sizeof buf) > 0)
+		;
+	pthread_mutex_lock(&queue_lock);
+	list = finished;
+	list_last = finished_last;
+	finished = finished_last = NULL;
+	pthread_mutex_unlock(&queue_lock);
+	while ((job = take(&list, &list_last)))
+		finish(job);
+}
+
+static void
+start_background(void)
+{
+	pthread_t	thread;
+	sigset_t	all, old;
+	int		i, n;
+
+	nbackground = 0;
+	main_thread = pthread_self();
+	main_known = True;
+	if (pipe(wake_fd) != 0) {
+		if (appres.DEBUG)
+			perror("xfig: cannot create a pipe for worker threads");
+		return;
+	}
+	fcntl(wake_fd[0], F_SETFL, O_NONBLOCK);
+	fcntl(wake_fd[1], F_SETFL, O_NONBLOCK);
+	fcntl(wake_fd[0], F_SETFD, FD_CLOEXEC);
+	fcntl(wake_fd[1], F_SETFD, FD_CLOEXEC);
+
+	n = max2(thread_count() - 1, 1);
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	for (i = 0; i < n; ++i) {
+		if (pthread_create(&thread, NULL, background_worker, NULL) != 0)
+			break;
+		pthread_detach(thread);
+		++nbackground;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (nbackground > 0)
+		XtAppAddInput(tool_app, wake_fd[0], (XtPointer)XtInputReadMask,
+				finished_jobs, NULL);
+	if (appres.DEBUG)
+		fprintf(stderr, "Started %d background threads\n", nbackground);
+}
+
+#endif /* HAVE_PTHREAD */
+
+/*
+ * Call work(arg) in the background, and afterwards done(arg) from the event
+ * loop of the main thread. Only done() may call Xlib or Xt, or touch the
+ * figure. The jobs are started in the order of the calls.
+ */
+void
+background_job(void (*work)(void *arg), void (*done)(void *arg), void *arg)
+{
+	struct job	*job;
+
+	if ((job = malloc(sizeof(struct job))) == NULL) {
+		work(arg);
+		done(arg);
+		return;
+	}
+	job->work = work;
+	job->done = done;
+	job->arg = arg;
+	job->msg = NULL;
+
+#ifdef HAVE_PTHREAD
+	if (nbackground < 0)
+		start_background();
+	if (nbackground > 0) {
+		pthread_mutex_lock(&queue_lock);
+		append(&todo, &todo_last, job);
+		pthread_cond_signal(&todo_cond);
+		pthread_mutex_unlock(&queue_lock);
+		return;
+	}
+#endif
+	if (todo == NULL)
+		XtAppAddWorkProc(tool_app, run_idle_job, NULL);
+	append(&todo, &todo_last, job);
+}
+
+/* return True if called from the main thread, which may use Xlib */
+Boolean
+in_main_thread(void)
+{
+#ifdef HAVE_PTHREAD
+	return !main_known || pthread_equal(pthread_self(), main_thread);
+#else
+	return True;
+#endif
+}
+
+/*
+ * Pass a message from a worker thread to file_msg() in the main thread.
+ * The message is shown before the done() function of the job runs.
+ */
+void
+main_thread_msg(const char *msg)
+{
+#ifdef HAVE_PTHREAD
+	struct job	*job;
+
+	if ((job = malloc(sizeof(struct job))) == NULL)
+		return;
+	if ((job->msg = strdup(msg)) == NULL) {
+		free(job);
+		return;
+	}
+	pthread_mutex_lock(&queue_lock);
+	put_finished(job);
+	pthread_mutex_unlock(&queue_lock);
+#else
+	file_msg("%s", msg);
+#endif
+}
@@ -0,0 +1,36 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2015 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+#ifndef U_THREADS_H
+#define U_THREADS_H
+
+/*
+ * A small pool of worker threads for loops whose iterations are independent,
+ * e.g., the rows of an image, and for jobs that run in the background, e.g.,
+ * reading pictures. The worker threads must not call Xlib or Xt.
+ */
+
+extern int	thread_count(void);
+extern Boolean	parallel_rows(void (*rows)(void *arg, int first, int last),
+			void *arg, int nrows);
+extern void	background_job(void (*work)(void *arg),
+			void (*done)(void *arg), void *arg);
+extern Boolean	in_main_thread(void);
+extern void	main_thread_msg(const char *msg);
+
+#endif /* U_THREADS_H */
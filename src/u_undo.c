@@ -165,6 +165,8 @@ undo(void)
 	put_msg("Nothing to UNDO");
 	return;
     }
+    /* the undo functions swap the contents of objects in place */
+    objects_modified();
     put_msg("Undo complete");
 }
 
@@ -0,0 +1,181 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2015 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+/*
+ * Batch evaluation of X-spline segments.
+ *
+ * u_draw_spline.c computes a spline segment at parameter values t = 0,
+ * step, 2*step, ... below 1. Here, the blending weights for several values
+ * of t are computed in parallel, using the vector extensions of gcc and
+ * clang, which map to SSE2 on x86-64 and to NEON on arm64, or to scalar code
+ * on other targets. Each lane performs exactly the same floating point
+ * operations, in the same order, as the scalar code, hence the integer
+ * points are identical. Contraction into fused multiply-add instructions
+ * is switched off for this file, because it could be done differently for
+ * the scalar and the vector code.
+ * Compile with -DXSPLINE_SCALAR to use only the scalar code.
+ */
+
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+#include "fig.h"
+#include "u_xspline.h"
+
+#if defined(__GNUC__) && !defined(XSPLINE_SCALAR)
+#define USE_VECTOR
+#endif
+
+/* one point, as formerly done by point_adding() in u_draw_spline.c */
+static void
+scalar_point(int k, double s1, double s2, const int *px, const int *py,
+		double t, int *x, int *y)
+{
+	double	A_blend[4];
+	double	weights_sum;
+
+	if (s1 < 0) {
+		negative_s1_influence(t, s1, &A_blend[0], &A_blend[2]);
+		if (s2 < 0)
+			negative_s2_influence(t, s2, &A_blend[1], &A_blend[3]);
+		else
+			positive_s2_influence(k, t, s2, &A_blend[1], &A_blend[3]);
+	} else {
+		positive_s1_influence(k, t, s1, &A_blend[0], &A_blend[2]);
+		if (s2 < 0)
+			negative_s2_influence(t, s2, &A_blend[1], &A_blend[3]);
+		else
+			positive_s2_influence(k, t, s2, &A_blend[1], &A_blend[3]);
+	}
+
+	weights_sum = A_blend[0] + A_blend[1] + A_blend[2] + A_blend[3];
+	*x = round((A_blend[0]*px[0] + A_blend[1]*px[1] + A_blend[2]*px[2] +
+				A_blend[3]*px[3]) / weights_sum);
+	*y = round((A_blend[0]*py[0] + A_blend[1]*py[1] + A_blend[2]*py[2] +
+				A_blend[3]*py[3]) / weights_sum);
+}
+
+void
+xspline_points_scalar(int k, double s1, double s2, const int *px,
+		const int *py, const double *t, int n, int *x, int *y)
+{
+	int	i;
+
+	for (i = 0; i < n; ++i)
+		scalar_point(k, s1, s2, px, py, t[i], &x[i], &y[i]);
+}
+
+#ifdef USE_VECTOR
+
+#define VLEN	2
+typedef double v2d __attribute__ ((vector_size (VLEN * sizeof(double))));
+
+/* lanes where mask is false are set to zero */
+#define VSELECT(mask, v)	((v2d) ((__typeof__(mask)) (v) & (mask)))
+
+/*
+ * The vector versions of the functions in u_xspline.h. Sub-expressions
+ * that only depend on the shape factors are computed as scalars, as they
+ * are in the scalar code.
+ */
+
+static inline v2d
+vf_blend(v2d numerator, double denominator)
+{
+	double	p = 2 * denominator * denominator;
+	v2d	u = numerator / denominator;
+	v2d	u2 = u * u;
+
+	return (u * u2 * (10 - p + (2*p - 15)*u + (6 - p)*u2));
+}
+
+static inline v2d
+vg_blend(v2d u, double q)
+{
+	return (u*(q + u*(2*q + u*(8 - 12*q + u*(14*q - 11 + u*(4 - 5*q))))));
+}
+
+static inline v2d
+vh_blend(v2d u, double q)
+{
+	v2d	u2 = u * u;
+
+	return (u * (q + u * (2 * q + u2 * (-2*q - u*q))));
+}
+
+void
+xspline_points(int k, double s1, double s2, const int *px, const int *py,
+		const double *t, int n, int *x, int *y)
+{
+	double	Tk0, Tk1, Tk2, Tk3;
+	double	dk = k;
+	v2d	vt, vtk, A0, A1, A2, A3, ws, vx, vy;
+	int	i, j;
+
+	/* the constants of positive_s[12]_influence() */
+	Tk0 = k+1+s1;
+	Tk1 = k+1-s1;
+	Tk2 = k+2+s2;
+	Tk3 = k+2-s2;
+
+	for (i = 0; i + VLEN <= n; i += VLEN) {
+		vt = (v2d){t[i], t[i + 1]};
+		/* t+k+1 */
+		vtk = vt + dk + 1;
+
+		if (s1 < 0) {
+			A0 = vh_blend(-vt, Q(s1));
+			A2 = vg_blend(vt, Q(s1));
+		} else {
+			A0 = VSELECT(vtk < Tk0, vf_blend(vtk - Tk0, k - Tk0));
+			A2 = vf_blend(vtk - Tk1, k+2 - Tk1);
+		}
+		if (s2 < 0) {
+			A1 = vg_blend(1 - vt, Q(s2));
+			A3 = vh_blend(vt - 1, Q(s2));
+		} else {
+			A1 = vf_blend(vtk - Tk2, k+1 - Tk2);
+			A3 = VSELECT(vtk > Tk3, vf_blend(vtk - Tk3, k+3 - Tk3));
+		}
+
+		ws = A0 + A1 + A2 + A3;
+		vx = (A0*px[0] + A1*px[1] + A2*px[2] + A3*px[3]) / ws;
+		vy = (A0*py[0] + A1*py[1] + A2*py[2] + A3*py[3]) / ws;
+		for (j = 0; j < VLEN; ++j) {
+			x[i + j] = round(vx[j]);
+			y[i + j] = round(vy[j]);
+		}
+	}
+	/* the remaining points */
+	for (; i < n; ++i)
+		scalar_point(k, s1, s2, px, py, t[i], &x[i], &y[i]);
+}
+
+#else /* USE_VECTOR */
+
+void
+xspline_points(int k, double s1, double s2, const int *px, const int *py,
+		const double *t, int n, int *x, int *y)
+{
+	xspline_points_scalar(k, s1, s2, px, py, t, n, x, y);
+}
+
+#endif /* USE_VECTOR */
@@ -0,0 +1,106 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2015 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies of
+ * the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+#ifndef U_XSPLINE_H
+#define U_XSPLINE_H
+
+/*
+ * The blending functions of X-splines, see u_draw_spline.c, and an evaluator
+ * that computes the points of a spline segment for many values of the
+ * parameter t at once.
+ */
+
+#define Q(s)  (-(s))
+
+static inline double
+f_blend(double numerator, double denominator)
+{
+  double p = 2 * denominator * denominator;
+  double u = numerator / denominator;
+  double u2 = u * u;
+
+  return (u * u2 * (10 - p + (2*p - 15)*u + (6 - p)*u2));
+}
+
+static inline double
+g_blend(double u, double q)             /* p equals 2 */
+
+{
+  return(u*(q + u*(2*q + u*(8 - 12*q + u*(14*q - 11 + u*(4 - 5*q))))));
+}
+
+static inline double
+h_blend(double u, double q)
+{
+  double u2=u*u;
+   return (u * (q + u * (2 * q + u2 * (-2*q - u*q))));
+}
+
+static inline
+void negative_s1_influence(double t, double s1, double *A0, double *A2)
+{
+  *A0 = h_blend(-t, Q(s1));
+  *A2 = g_blend(t, Q(s1));
+}
+
+static inline
+void negative_s2_influence(double t, double s2, double *A1, double *A3)
+{
+  *A1 = g_blend(1-t, Q(s2));
+  *A3 = h_blend(t-1, Q(s2));
+}
+
+static inline
+void positive_s1_influence(int k, double t, double s1, double *A0, double *A2)
+{
+  double Tk;
+
+  Tk = k+1+s1;
+  *A0 = (t+k+1<Tk) ? f_blend(t+k+1-Tk, k-Tk) : 0.0;
+
+  Tk = k+1-s1;
+  *A2 = f_blend(t+k+1-Tk, k+2-Tk);
+}
+
+static inline
+void positive_s2_influence(int k, double t, double s2, double *A1, double *A3)
+{
+  double Tk;
+
+  Tk = k+2+s2;
+  *A1 = f_blend(t+k+1-Tk, k+1-Tk);
+
+  Tk = k+2-s2;
+  *A3 = (t+k+1>Tk) ? f_blend(t+k+1-Tk, k+3-Tk) : 0.0;
+}
+
+/*
+ * Compute the points (x[i], y[i]) of segment k, with the control points
+ * (px[j], py[j]), j = 0..3, and the shape factors s1 and s2 of the inner
+ * control points, for the n parameter values t[i].
+ * xspline_points() uses SIMD instructions, if the compiler supports them,
+ * xspline_points_scalar() computes one point after the other. Both give
+ * the same result.
+ */
+extern void	xspline_points(int k, double s1, double s2, const int *px,
+			const int *py, const double *t, int n, int *x, int *y);
+extern void	xspline_points_scalar(int k, double s1, double s2,
+			const int *px, const int *py, const double *t, int n,
+			int *x, int *y);
+
+#endif /* U_XSPLINE_H */
@@ -25,6 +25,7 @@
 #include "f_util.h"
 #include "u_create.h"
 #include "u_fonts.h"
+#include "u_ghostscript.h"
 #include "u_pan.h"
 #include "u_redraw.h"
 #include "u_search.h"
@@ -592,6 +593,9 @@ void goodbye(Boolean abortflag)
     if (batch_exists)
 	unlink(batch_file);
 
+    /* stop ghostscript and delete its directories */
+    gs_stop_workers();
+
     XSync(tool_d, False);	/* https://sourceforge.net/p/mcj/tickets/54 */
 
     /* free all the GC's */
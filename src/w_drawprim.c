@@ -25,11 +25,14 @@
  * GRAPHICS CONTEXTS (which are used by all the following)
  * FONTS
  * LINES
+ * BATCHING
  * SHADING
  */
 
 /* IMPORTS */
 
+#include <string.h>
+
 #include "fig.h"
 #include "figx.h"
 #include "resources.h"
@@ -67,6 +70,8 @@ static Boolean	inside (XPoint testVertex, int x1, int y1, int x2, int y2);
 static void	setup_next(int npoints, XPoint *in, XPoint *out);
 static Pixel	gc_color[NUMOPS], gc_background[NUMOPS];
 static XRectangle clip[1];
+static unsigned	clip_serial = 0;	/* incremented on each change of clip */
+static unsigned	fill_gc_clip[NUMFILLPATS];	/* clip_serial of fill_gc[] */
 static int	parsesize(char *name);
 static Boolean	openwinfonts;
 static Boolean  font_scalable[NUM_FONTS];
@@ -256,6 +261,25 @@ parsesize(char *name)
     return 0;
 }
 
+/*
+ * The fonts returned by lookfont(), hashed by font number and size. The
+ * lists in x_fontinfo[] are only searched when a size is first requested.
+ */
+
+#define FONT_HASH_SIZE	128
+
+static struct font_hash {
+	int		    fnum;
+	int		    size;
+	XFontStruct	   *fstruct;
+	struct font_hash   *next;
+} *font_hash[FONT_HASH_SIZE];
+
+static Boolean	prefetching = False;	/* loading fonts in the background */
+static unsigned long font_loads = 0;
+
+#define font_hash_index(fnum, size)	(((fnum) * 31 + (size)) % FONT_HASH_SIZE)
+
 /*
  * Lookup an X font, "fnum" corresponding to a Postscript font style that is
  * close in size to "size"
@@ -270,6 +294,7 @@ lookfont(int fnum, int size)
 	char		template[300], *sub;
 	Boolean		found;
 	struct xfont   *newfont, *nf, *oldnf;
+	struct font_hash *fh;
 
 #ifdef I18N
 	char **mcharset;
@@ -290,6 +315,11 @@ lookfont(int fnum, int size)
 	if (appres.correct_font_size)
 	    size = round(size*80.0/72.0);
 
+	/* did we return that font before? */
+	for (fh = font_hash[font_hash_index(fnum, size)]; fh; fh = fh->next)
+	    if (fh->fnum == fnum && fh->size == size)
+		return fh->fstruct;
+
 	/* see if we've already loaded that font size 'size'
 	   from the font family 'fnum' */
 
@@ -316,12 +346,12 @@ lookfont(int fnum, int size)
 	}
 	if (found) {		/* found exact size (or only larger available) */
 	    strcpy(fn,nf->fname);  /* put the name in fn */
-	    if (size < nf->size)
+	    if (size < nf->size && !prefetching)
 		put_msg("Font size %d not found, using larger %d point",size,nf->size);
 	} else if (!font_scalable[fnum]) {	/* not found, use largest available */
 	    nf = oldnf;
 	    strcpy(fn,nf->fname);		/* put the name in fn */
-	    if (size > nf->size)
+	    if (size > nf->size && !prefetching)
 		put_msg("Font size %d not found, using smaller %d point",size,nf->size);
 	} else { /* scalablefonts; none yet of that size, alloc one and put it in the list */
 	    newfont = (struct xfont *) malloc(sizeof(struct xfont));
@@ -385,9 +415,11 @@ lookfont(int fnum, int size)
 		fprintf(stderr,"Loading font %s\n",fn);
 	    /* if we are previewing a figure and the user pressed Cancel,
 	       return now with the simple roman font */
-	    if (check_cancel())
+	    if (!prefetching && check_cancel())
 		return roman_font;
-	    set_temp_cursor(wait_cursor);
+	    if (!prefetching)
+		set_temp_cursor(wait_cursor);
+	    ++font_loads;
 	    fontst = XLoadQueryFont(tool_d, fn);
 #ifdef I18N
             /* create fontsets for all fonts but Symbol and Dingbats */
@@ -396,7 +428,8 @@ lookfont(int fnum, int size)
 		strstr(fn,"ingbats") == NULL)
 		  fontset = XCreateFontSet(tool_d, fn, &mcharset, &ncharset, &defstr);
 #endif
-	    reset_cursor();
+	    if (!prefetching)
+		reset_cursor();
 	    if (fontst == NULL) {
 		/* doesn't exist, see if substituting "condensed" for "narrow" will match */
 		if ((sub=strstr(fn,"-narrow-")) != NULL) {
@@ -426,7 +459,8 @@ lookfont(int fnum, int size)
 	    }
 	    if (fontst == NULL) {
 		/* even that font doesn't exist, use a plain one */
-		file_msg("Can't find %s, using %s", fn, appres.normalFont);
+		if (!prefetching)
+		    file_msg("Can't find %s, using %s", fn, appres.normalFont);
 		fontst = XLoadQueryFont(tool_d, appres.normalFont);
 		if (nf->fname)
 		    free(nf->fname);
@@ -440,9 +474,36 @@ lookfont(int fnum, int size)
 	    nf->fset = fontset;
 	} /* if (nf->fstruct == NULL) */
 
+	/* remember it for the next time */
+	if (nf->fstruct != NULL &&
+		(fh = (struct font_hash *) malloc(sizeof(struct font_hash)))) {
+	    fh->fnum = fnum;
+	    fh->size = size;
+	    fh->fstruct = nf->fstruct;
+	    fh->next = font_hash[font_hash_index(fnum, size)];
+	    font_hash[font_hash_index(fnum, size)] = fh;
+	}
+
 	return (nf->fstruct);
 }
 
+/*
+ * Load the font that lookfont(fnum, size) returns, without messages or a
+ * change of the cursor. Return True if the font had to be loaded from the
+ * server, False if it was loaded before.
+ */
+
+Boolean
+prefetch_font(int fnum, int size)
+{
+	unsigned long	loads = font_loads;
+
+	prefetching = True;
+	(void) lookfont(fnum, size);
+	prefetching = False;
+	return font_loads != loads;
+}
+
 /* print "string" in window "w" using font specified in fstruct at angle
 	"angle" (radians) at (x,y)
    If background is != COLOR_NONE, draw background color ala DrawImageString
@@ -458,6 +519,7 @@ pw_text(Window w, int x, int y, int op, int depth, XFontStruct *fstruct,
 	fprintf(stderr,"Error, in pw_text, fstruct==NULL\n");
 	return;
     }
+    flush_draw_batch();
 
     /* if this depth is inactive, draw the text in gray */
     /* if depth == MAX_DEPTH+1 then the caller wants the original color no matter what */
@@ -524,7 +586,8 @@ textsize(XFontStruct *fstruct, int n, char *s)
 static int	gc_thickness[NUMOPS],
 		gc_line_style[NUMOPS],
 		gc_join_style[NUMOPS],
-		gc_cap_style[NUMOPS];
+		gc_cap_style[NUMOPS],
+		gc_ndashes[NUMOPS];
 
 GC
 makegc(int op, Pixel fg, Pixel bg)
@@ -586,6 +649,8 @@ void init_gc(void)
 	gc_thickness[i] = -1;
 	gc_line_style[i] = -1;
 	gc_join_style[i] = -1;
+	gc_cap_style[i] = -1;
+	gc_ndashes[i] = 0;
     }
     /* gc for page border and axis lines */
     border_gc = DefaultGC(tool_d, tool_sn);
@@ -1061,6 +1126,97 @@ void init_fill_pm(void)
     }
 }
 
+/* BATCHING */
+
+/*
+ * While the figure is redrawn, thin solid lines are not sent to the server
+ * one by one, but collected and drawn with one XDrawSegments() request, as
+ * long as they go to the same drawable with the same gc. The batch must be
+ * flushed before anything else is drawn and before any gc in gccache[] is
+ * changed. The primitives in this file do so; code that draws directly or
+ * changes the clipping of gccache[] during a redraw must call
+ * flush_draw_batch() first. XOR drawing (INV_PAINT) is never batched,
+ * because segments drawn separately would XOR the shared end points twice.
+ */
+
+#define		SEG_BATCH	256	/* segments per XDrawSegments() */
+#define		BATCH_MAXPTS	16	/* longer polylines are drawn as before */
+
+static XSegment	seg_batch[SEG_BATCH];
+static int	num_segs = 0;
+static Window	seg_win;
+static int	seg_op;
+static Boolean	batching = False;
+
+/* statistics, printed with -debug */
+static unsigned long batch_request;
+static int	batch_segs, batch_reqs;
+
+void
+flush_draw_batch(void)
+{
+    if (num_segs == 0)
+	return;
+    XDrawSegments(tool_d, seg_win, gccache[seg_op], seg_batch, num_segs);
+    num_segs = 0;
+    ++batch_reqs;
+}
+
+/* start collecting thin lines, and counting the X requests */
+void
+begin_draw_batch(void)
+{
+    flush_draw_batch();
+    batching = True;
+    batch_request = NextRequest(tool_d);
+    batch_segs = batch_reqs = 0;
+}
+
+void
+end_draw_batch(void)
+{
+    flush_draw_batch();
+    if (!batching)
+	return;
+    batching = False;
+    if (appres.DEBUG)
+	fprintf(stderr, "redraw: %lu X requests, %d segments in %d batches\n",
+		NextRequest(tool_d) - batch_request, batch_segs, batch_reqs);
+}
+
+/*
+ * Return True, if a line with the given parameters, already set by
+ * set_line_stuff(), can be added to the batch.
+ */
+static Boolean
+batchable(Window w, int op, int line_style)
+{
+    if (!batching || op == INV_PAINT || line_style != SOLID_LINE ||
+		gc_thickness[op] != 0) {
+	flush_draw_batch();
+	return False;
+    }
+    if (num_segs > 0 && (w != seg_win || op != seg_op || num_segs == SEG_BATCH))
+	flush_draw_batch();
+    seg_win = w;
+    seg_op = op;
+    return True;
+}
+
+/* the coordinates are given in screen coordinates */
+static void
+batch_segment(int x1, int y1, int x2, int y2)
+{
+    if (num_segs == SEG_BATCH)
+	flush_draw_batch();
+    seg_batch[num_segs].x1 = (short) x1;
+    seg_batch[num_segs].y1 = (short) y1;
+    seg_batch[num_segs].x2 = (short) x2;
+    seg_batch[num_segs].y2 = (short) y2;
+    ++num_segs;
+    ++batch_segs;
+}
+
 void
 pw_vector(Window w, int x1, int y1, int x2, int y2, int op,
 	  int line_width, int line_style, float style_val, Color color)
@@ -1068,7 +1224,9 @@ pw_vector(Window w, int x1, int y1, int x2, int y2, int op,
     if (line_width == 0)
 	return;
     set_line_stuff(line_width, line_style, style_val, JOIN_MITER, CAP_BUTT, op, color);
-    if (line_style == PANEL_LINE)
+    if (batchable(w, op, line_style))
+	batch_segment(ZOOMX(x1), ZOOMY(y1), ZOOMX(x2), ZOOMY(y2));
+    else if (line_style == PANEL_LINE)
 	XDrawLine(tool_d, w, gccache[op], x1, y1, x2, y2);
     else
 	zXDrawLine(tool_d, w, gccache[op], x1, y1, x2, y2);
@@ -1089,6 +1247,7 @@ pw_curve(Window w, int xstart, int ystart, int xend, int yend,
 	fill_color = LT_GRAY;
     }
 
+    flush_draw_batch();
     xmin = min2(xstart, xend);
     ymin = min2(ystart, yend);
     wd = (unsigned int) abs(xstart - xend);
@@ -1113,6 +1272,42 @@ pw_curve(Window w, int xstart, int ystart, int xend, int yend,
     }
 }
 
+/*
+ * Draw a circular arc, with the bounding square of the full circle at
+ * (xmin, ymin) and diameter diam, from angle1 through angle2, both in 64ths
+ * of a degree, counter-clockwise. If pie is set, fill the sector, otherwise
+ * the segment between the arc and its chord. Only the arc itself is
+ * stroked.
+ */
+void
+pw_arc(Window w, int xmin, int ymin, int diam, int angle1, int angle2,
+	 Boolean pie, int op, int depth, int linewidth, int style,
+	 float style_val, int fill_style, Color pen_color, Color fill_color,
+	 int cap_style)
+{
+    /* if this depth is inactive, draw the arc and any fill in gray */
+    if (draw_parent_gray || (depth < MAX_DEPTH+1 && !active_layer(depth))) {
+	pen_color = MED_GRAY;
+	fill_color = LT_GRAY;
+    }
+
+    flush_draw_batch();
+    if (fill_style >= 0 && fill_style < NUMFILLPATS) {
+	set_fill_gc(fill_style, op, pen_color, fill_color, xmin, ymin);
+	/* the fill gcs are shared, and otherwise in ArcPieSlice mode */
+	if (!pie)
+	    XSetArcMode(tool_d, fillgc, ArcChord);
+	zXFillArc(tool_d, w, fillgc, xmin, ymin, diam, diam, angle1, angle2);
+	if (!pie)
+	    XSetArcMode(tool_d, fillgc, ArcPieSlice);
+    }
+    if (linewidth == 0)
+	return;
+    set_line_stuff(linewidth, style, style_val, JOIN_MITER, cap_style, op,
+		    pen_color);
+    zXDrawArc(tool_d, w, gccache[op], xmin, ymin, diam, diam, angle1, angle2);
+}
+
 /* a point object - actually draw a line from (x-line_width/2,y) to (x+linewidth/2,y)
 	so that we get some thickness */
 
@@ -1129,6 +1324,7 @@ pw_point(Window w, int x, int y, int op, int depth, int line_width,
     /* pw_point doesn't use line_style or fill_style but needs color */
     set_line_stuff(line_width, SOLID_LINE, 0.0, JOIN_MITER, cap_style,
 		op, color);
+    flush_draw_batch();
     if (cap_style > 0)
 	hf_wid = 0;
     else
@@ -1145,6 +1341,7 @@ pw_arcbox(Window w, int xmin, int ymin, int xmax, int ymax, int radius,
     GC		    gc;
     int		    diam = 2 * radius;
 
+    flush_draw_batch();
     /* if this depth is inactive, draw the arcbox in gray */
     if (draw_parent_gray || (depth < MAX_DEPTH+1 && !active_layer(depth))) {
 	pen_color = MED_GRAY;
@@ -1252,22 +1449,30 @@ pw_lines(Window w, zXPoint *points, int npoints, int op, int depth,
 	return;
     set_line_stuff(line_width, line_style, style_val, join_style, cap_style,
 			op, pen_color);
-    if (line_style == PANEL_LINE) {
+    if (npoints <= BATCH_MAXPTS && batchable(w, op, line_style)) {
+	for (i = 1; i < npoints; i++)
+	    batch_segment(ZOOMX(points[i-1].x), ZOOMY(points[i-1].y),
+			  ZOOMX(points[i].x), ZOOMY(points[i].y));
+    } else if (line_style == PANEL_LINE) {
+	flush_draw_batch();
 	XDrawLines(tool_d, w, gccache[op], p, npoints, CoordModeOrigin);
 	free((char *) p);
     } else {
+	flush_draw_batch();
 	zXDrawLines(tool_d, w, gccache[op], points, npoints, CoordModeOrigin);
     }
 }
 
 void set_clip_window(int xmin, int ymin, int xmax, int ymax)
 {
+    flush_draw_batch();
     clip_xmin = clip[0].x = xmin;
     clip_ymin = clip[0].y = ymin;
     clip_xmax = xmax;
     clip_ymax = ymax;
     clip_width = clip[0].width = xmax - xmin + 1;
     clip_height = clip[0].height = ymax - ymin + 1;
+    ++clip_serial;
     XSetClipRectangles(tool_d, border_gc, 0, 0, clip, 1, YXBanded);
     XSetClipRectangles(tool_d, gccache[PAINT], 0, 0, clip, 1, YXBanded);
     XSetClipRectangles(tool_d, gccache[INV_PAINT], 0, 0, clip, 1, YXBanded);
@@ -1291,6 +1496,7 @@ void set_fill_gc(int fill_style, int op, int pencolor, int fillcolor, int xorg,
     /* see if we need to create this fill style if it is a pattern.
        This might have happened if there was a change of zoom. */
 
+    flush_draw_batch();
     if ((fill_style >= NUMSHADEPATS+NUMTINTPATS) &&
 	((fill_pm[fill_style] == 0) || (fill_pm_zoom[fill_style] != display_zoomscale)))
 	    rescale_pattern(fill_style);
@@ -1322,7 +1528,11 @@ void set_fill_gc(int fill_style, int op, int pencolor, int fillcolor, int xorg,
     XSetStipple(tool_d, fillgc, fill_pm[fill_style]);
     /* set origin of pattern relative to object itself */
     XSetTSOrigin(tool_d, fillgc, ZOOMX(xorg), ZOOMY(yorg));
-    XSetClipRectangles(tool_d, fillgc, 0, 0, clip, 1, YXBanded);
+    /* Xlib sends the clip rectangles at once, even if they did not change */
+    if (fill_gc_clip[fill_style] != clip_serial) {
+	XSetClipRectangles(tool_d, fillgc, 0, 0, clip, 1, YXBanded);
+	fill_gc_clip[fill_style] = clip_serial;
+    }
 }
 
 
@@ -1355,10 +1565,75 @@ static int ndash_3dots = 8;
 static float dash_3dots[8] = { 1., 0.4, 0., 0.3, 0., 0.3, 0., 0.4 };
 
 
+/*
+ * Put the dash list for the given line style into dashes and return its
+ * length, or return 0 if the style is not dashed or style_val is not
+ * positive.
+ */
+static int
+dash_pattern(int style, float style_val, unsigned char *dashes)
+{
+    int		    il, nd;
+    float	   *fl;
+
+    if (style_val <= 0.0)	/* style_val of 0.0 causes problems */
+	return 0;
+    if (style == DASH_LINE || style == DOTTED_LINE) {
+	/* length of ON/OFF pixels */
+	if (style_val * display_zoomscale > 255.0)
+	    dashes[0] = dashes[1] = (char) 255;	/* too large for X! */
+	else
+	    dashes[0] = dashes[1] = (char) round(style_val * display_zoomscale);
+	/* length of ON pixels for dotted */
+	if (style == DOTTED_LINE)
+	    dashes[0] = (char)display_zoomscale;
+
+	if (dashes[0]==0)		/* take care for rounding to zero ! */
+	    dashes[0]=1;
+	if (dashes[1]==0)		/* take care for rounding to zero ! */
+	    dashes[1]=1;
+	return 2;
+    } else if (style == DASH_DOT_LINE || style == DASH_2_DOTS_LINE ||
+	      style == DASH_3_DOTS_LINE) {
+	if (style == DASH_2_DOTS_LINE) {
+	    fl=dash_2dots;
+	    nd=ndash_2dots;
+	} else if (style == DASH_3_DOTS_LINE) {
+	    fl=dash_3dots;
+	    nd=ndash_3dots;
+	} else {
+	    fl=dash_dot;
+	    nd=ndash_dot;
+	}
+	for (il =0; il<nd; il ++) {
+	    if (fl[il] != 0.) {
+		if (fl[il] * style_val * display_zoomscale > 255.0)
+		    dashes[il] = (char) 255;	/* too large for X! */
+		else
+		    dashes[il] = (char) round(fl[il] * style_val *
+				    display_zoomscale);
+	    } else {
+		dashes[il] = (char)display_zoomscale;
+	    }
+	    if (dashes[il]==0)	/* take care for rounding to zero ! */
+		    dashes[il]=1;
+	}
+	return nd;
+    }
+    return 0;
+}
+
+/*
+ * Set the line attributes of gccache[op]. The values last set are kept in
+ * the gc_*[] arrays and dash_list[], and only what differs is sent.
+ */
+
 void set_line_stuff(int width, int style, float style_val, int join_style, int cap_style, int op, int color)
 {
     XGCValues	    gcv;
     unsigned long   mask;
+    unsigned char   dashes[8];
+    int		    nd, xcolor;
 
     switch (style) {
       case RUBBER_LINE:
@@ -1380,87 +1655,55 @@ void set_line_stuff(int width, int style, float style_val, int join_style, int c
     if (width == 0 && style != SOLID_LINE)
 	width = 1;
 
-    /* see if all gc stuff is already correct */
-
-    if (width == gc_thickness[op] && style == gc_line_style[op] &&
-	join_style == gc_join_style[op] &&
-	cap_style == gc_cap_style[op] &&
-	(x_color(color) == gc_color[op]) &&
-	((style != DASH_LINE && style != DOTTED_LINE &&
-          style != DASH_DOT_LINE && style != DASH_2_DOTS_LINE &&
-          style != DASH_3_DOTS_LINE) ||
-	 dash_list[op][1] == (unsigned char) round(style_val * display_zoomscale)))
-	    return;			/* no need to change anything */
-
-    gcv.line_width = width;
-    mask = GCLineWidth | GCLineStyle | GCCapStyle | GCJoinStyle;
-    if (op == PAINT) {
-	gcv.foreground = x_color(color);
-	mask |= GCForeground;
-    } else if (op == INV_PAINT) {
-	gcv.foreground = x_color(color) ^ x_bg_color.pixel;
-	mask |= GCForeground;
+    xcolor = x_color(color);
+    nd = dash_pattern(style, style_val, dashes);
+
+    /* see which parts of the gc must be changed */
+    mask = 0;
+    if (width != gc_thickness[op]) {
+	gcv.line_width = width;
+	mask |= GCLineWidth;
     }
-    gcv.join_style = join_styles[join_style];
-    gcv.cap_style = cap_styles[cap_style];
-    gcv.line_style = (style == DASH_LINE || style == DOTTED_LINE ||
-             style == DASH_DOT_LINE || style == DASH_2_DOTS_LINE ||
-             style == DASH_3_DOTS_LINE) ?
-	LineOnOffDash : LineSolid;
-
-    XChangeGC(tool_d, gccache[op], mask, &gcv);
-    if (style_val > 0.0) {	/* style_val of 0.0 causes problems */
-	if (style == DASH_LINE || style == DOTTED_LINE) {
-	    /* length of ON/OFF pixels */
-	    if (style_val * display_zoomscale > 255.0)
-		dash_list[op][0] = dash_list[op][1] = (char) 255;	/* too large for X! */
-	    else
-	        dash_list[op][0] = dash_list[op][1] =
-				(char) round(style_val * display_zoomscale);
-	    /* length of ON pixels for dotted */
-	    if (style == DOTTED_LINE)
-		dash_list[op][0] = (char)display_zoomscale;
-
-	    if (dash_list[op][0]==0)		/* take care for rounding to zero ! */
-		dash_list[op][0]=1;
-	    if (dash_list[op][1]==0)		/* take care for rounding to zero ! */
-		dash_list[op][1]=1;
-	    XSetDashes(tool_d, gccache[op], 0, (char *) dash_list[op], 2);
-	} else if (style == DASH_DOT_LINE || style == DASH_2_DOTS_LINE ||
-		  style == DASH_3_DOTS_LINE) {
-            int il, nd;
-            float *fl;
-            if (style == DASH_2_DOTS_LINE) {
-		fl=dash_2dots;
-		nd=ndash_2dots;
-	    } else if (style == DASH_3_DOTS_LINE) {
-		fl=dash_3dots;
-		nd=ndash_3dots;
-	    } else {
-		fl=dash_dot;
-		nd=ndash_dot;
-	    }
-	    for (il =0; il<nd; il ++) {
-                if (fl[il] != 0.) {
-		    if (fl[il] * style_val * display_zoomscale > 255.0)
-			dash_list[op][il] = (char) 255;	/* too large for X! */
-		    else
-			dash_list[op][il] = (char) round(fl[il] * style_val *
-					display_zoomscale);
-		} else {
-		    dash_list[op][il] = (char)display_zoomscale;
-		}
-		if (dash_list[op][il]==0)	/* take care for rounding to zero ! */
-			dash_list[op][il]=1;
-	    }
-	    XSetDashes(tool_d, gccache[op], 0, (char *) dash_list[op], nd);
+    if (style != gc_line_style[op]) {
+	gcv.line_style = (style == DASH_LINE || style == DOTTED_LINE ||
+		 style == DASH_DOT_LINE || style == DASH_2_DOTS_LINE ||
+		 style == DASH_3_DOTS_LINE) ?
+	    LineOnOffDash : LineSolid;
+	mask |= GCLineStyle;
+    }
+    if (join_style != gc_join_style[op]) {
+	gcv.join_style = join_styles[join_style];
+	mask |= GCJoinStyle;
+    }
+    if (cap_style != gc_cap_style[op]) {
+	gcv.cap_style = cap_styles[cap_style];
+	mask |= GCCapStyle;
+    }
+    if (xcolor != gc_color[op]) {
+	if (op == PAINT) {
+	    gcv.foreground = xcolor;
+	    mask |= GCForeground;
+	} else if (op == INV_PAINT) {
+	    gcv.foreground = xcolor ^ x_bg_color.pixel;
+	    mask |= GCForeground;
 	}
     }
+
+    if (mask) {
+	flush_draw_batch();
+	XChangeGC(tool_d, gccache[op], mask, &gcv);
+    }
+    if (nd > 0 && (nd != gc_ndashes[op] || memcmp(dashes, dash_list[op], nd))) {
+	flush_draw_batch();
+	memcpy(dash_list[op], dashes, nd);
+	XSetDashes(tool_d, gccache[op], 0, (char *) dash_list[op], nd);
+	gc_ndashes[op] = nd;
+    }
     gc_thickness[op] = width;
     gc_line_style[op] = style;
     gc_join_style[op] = join_style;
     gc_cap_style[op] = cap_style;
-    gc_color[op] = x_color(color);
+    gc_color[op] = xcolor;
 }
 
 int
@@ -1604,26 +1847,91 @@ static XPoint	*_pp_ = (XPoint *) NULL;	/* data pointer itself */
 static int	 _npp_ = 0;			/* number of points currently allocated */
 static Boolean	 _noalloc_ = False;		/* signals previous failed alloc */
 static Boolean	 chkalloc(int n);
-static void	 convert_sh(zXPoint *p, int n);
+static void	 convert_sh(zXPoint *p, int n, XPoint *q);
+static void	 draw_lines(Display *d, Window w, GC gc, XPoint *p, int n,
+			int coordmode);
+static Boolean	 may_chunk(Display *d, GC gc, zXPoint *p, int n,
+			int coordmode);
+static void	 shrink_alloc(void);
+
+/*
+ * Polylines with more than DRAW_CHUNK points are sent to the server in
+ * pieces, so that neither the conversion buffer nor a single request grow
+ * with the size of the object. A piece ends, and the next one starts, in
+ * the middle of a segment. Hence, all vertices are drawn with the join
+ * style of the line, and the caps of adjacent pieces meet on a straight
+ * line. Only the dash pattern starts anew at each piece.
+ * The pieces share their end points, and a closed polyline would lose the
+ * join at its closing point. Therefore, only open polylines drawn with GXcopy
+ * are split, see may_chunk(); others are drawn with a single request.
+ */
+#define		DRAW_CHUNK	4096
 
 void zXDrawLines(Display *d, Window w, GC gc, zXPoint *points, int n, int coordmode)
 {
-#ifdef CLIP_LINE
-    XPoint	*outp;
-#endif /* CLIP_LINE */
+    int		 start, len, k;
+    XPoint	 mid;
 
-    /* make sure we have allocated data */
-    if (!chkalloc(n)) {
+    if (n <= DRAW_CHUNK || !may_chunk(d, gc, points, n, coordmode)) {
+	/* make sure we have allocated data */
+	if (!chkalloc(n)) {
+	    return;
+	}
+	/* now convert each point to short into _pp_ */
+	convert_sh(points, n, _pp_);
+	draw_lines(d, w, gc, _pp_, n, coordmode);
+	shrink_alloc();
 	return;
     }
-    /* now convert each point to short into _pp_ */
-    convert_sh(points, n);
+
+    if (!chkalloc(DRAW_CHUNK + 1))
+	return;
+    for (start = 0; start < n; start += len) {
+	k = 0;
+	if (start > 0)
+	    _pp_[k++] = mid;
+	len = min2(n - start, DRAW_CHUNK - 1);
+	convert_sh(points + start, len, _pp_ + k);
+	k += len;
+	if (start + len < n) {
+	    mid.x = (_pp_[k-1].x + ZOOMX(points[start+len].x)) / 2;
+	    mid.y = (_pp_[k-1].y + ZOOMY(points[start+len].y)) / 2;
+	    _pp_[k++] = mid;
+	}
+	draw_lines(d, w, gc, _pp_, k, coordmode);
+    }
+}
+
+/*
+ * Return True, if the polyline may be drawn in pieces. In XOR mode, the
+ * shared end point of two pieces would be drawn twice and vanish.
+ */
+static Boolean
+may_chunk(Display *d, GC gc, zXPoint *p, int n, int coordmode)
+{
+    XGCValues	 gcv;
+
+    if (coordmode != CoordModeOrigin)
+	return False;
+    if (p[0].x == p[n-1].x && p[0].y == p[n-1].y)
+	return False;
+    if (!XGetGCValues(d, gc, GCFunction, &gcv) || gcv.function != GXcopy)
+	return False;
+    return True;
+}
+
+static void
+draw_lines(Display *d, Window w, GC gc, XPoint *p, int n, int coordmode)
+{
 #ifdef CLIP_LINE
+    XPoint	*outp;
+
     outp = (XPoint *) malloc(2*n*sizeof(XPoint));
-    n = clip_poly(_pp_, n, outp);
+    n = clip_poly(p, n, outp);
     XDrawLines(d, w, gc, outp, n, coordmode);
+    free(outp);
 #else
-    XDrawLines(d, w, gc, _pp_, n, coordmode);
+    XDrawLines(d, w, gc, p, n, coordmode);
 #endif /* CLIP_LINE */
 }
 
@@ -1636,23 +1944,40 @@ void zXFillPolygon(Display *d, Window w, GC gc, zXPoint *points, int n, int comp
 	return;
     }
     /* now convert each point to short into _pp_ */
-    convert_sh(points, n);
+    convert_sh(points, n, _pp_);
     outp = (XPoint *) malloc(2*n*sizeof(XPoint));
     n = clip_poly(_pp_, n, outp);
     XFillPolygon(d, w, gc, outp, n, complex, coordmode);
     free(outp);
+
+    /* a polygon must be filled at once */
+    shrink_alloc();
+}
+
+/* do not keep a huge buffer after drawing a large object at once */
+static void
+shrink_alloc(void)
+{
+    if (_npp_ > 2 * DRAW_CHUNK) {
+	XPoint	*tpp;
+
+	if ((tpp = (XPoint *) realloc(_pp_, (DRAW_CHUNK + 1) * sizeof(XPoint)))) {
+	    _pp_ = tpp;
+	    _npp_ = DRAW_CHUNK + 1;
+	}
+    }
 }
 
 /* convert each point to short */
 
 static void
-convert_sh(zXPoint *p, int n)
+convert_sh(zXPoint *p, int n, XPoint *q)
 {
     int		 i;
 
     for (i=0; i<n; i++) {
-	_pp_[i].x = ZOOMX(p[i].x);
-	_pp_[i].y = ZOOMY(p[i].y);
+	q[i].x = ZOOMX(p[i].x);
+	q[i].y = ZOOMY(p[i].y);
     }
 }
 
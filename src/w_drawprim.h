@@ -34,6 +34,10 @@ extern void pw_vector(Window w, int x1, int y1, int x2, int y2, int op,
 extern void pw_curve(Window w, int xstart, int ystart, int xend, int yend,
 	 int op, int depth, int linewidth, int style, float style_val, int fill_style,
 	 Color pen_color, Color fill_color, int cap_style);
+extern void pw_arc(Window w, int xmin, int ymin, int diam, int angle1,
+	 int angle2, Boolean pie, int op, int depth, int linewidth, int style,
+	 float style_val, int fill_style, Color pen_color, Color fill_color,
+	 int cap_style);
 extern void pw_point(Window w, int x, int y, int op, int depth, int line_width,
 	 Color color, int cap_style);
 extern void pw_arcbox(Window w, int xmin, int ymin, int xmax, int ymax, int radius,
@@ -50,6 +54,9 @@ extern void reset_clip_window (void);
 extern void set_clip_window (int xmin, int ymin, int xmax, int ymax);
 extern void set_fill_gc (int fill_style, int op, int pencolor, int fillcolor, int xorg, int yorg);
 extern void set_line_stuff (int width, int style, float style_val, int join_style, int cap_style, int op, int color);
+extern void begin_draw_batch(void);
+extern void end_draw_batch(void);
+extern void flush_draw_batch(void);
 extern int x_color (int col);
 extern void init_gc(void);
 
@@ -96,6 +103,7 @@ extern XFontStruct *roman_font;
 extern XFontStruct *button_font;
 extern XFontStruct *canvas_font;
 extern XFontStruct *lookfont(int fnum, int size);
+extern Boolean	prefetch_font(int fnum, int size);
 extern GC	    makegc(int op, Pixel fg, Pixel bg);
 
 /* patterns like bricks, etc */
@@ -110,12 +118,6 @@ typedef struct _patrn_strct {
 extern patrn_strct	pattern_images[NUMPATTERNS];
 extern unsigned char	shade_images[NUMSHADEPATS][128];
 
-/* Maximum number of points for polygons etc */
-/* This may be overridden by adding -DMAXNUMPTS=xxxx in the Imakefile/Makefile */
-#ifndef MAXNUMPTS
-#define		MAXNUMPTS	25000
-#endif /* MAXNUMPTS */
-
 #define		NORMAL_FONT	"fixed"
 #define		BOLD_FONT	"8x13bold"
 #define		BUTTON_FONT	"6x13"
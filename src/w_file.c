@@ -20,6 +20,7 @@
 #include "object.h"
 #include "mode.h"
 #include "e_edit.h"
+#include "f_picobj.h"		/* picture_size_limit */
 #include "f_read.h"
 #include "f_util.h"
 #include "u_create.h"
@@ -1318,7 +1319,11 @@ void preview_figure(char *filename, Widget parent, Widget canvas, Widget size_wi
     /* read the figure into the local F_compound "figure" */
 
     /* we'll ignore the stuff returned in "settings" */
-    if ((status = read_figc(filename,figure, DONT_MERGE, REMAP_IMAGES, 0,0,&settings)) != 0) {
+    /* the whole figure fits into the preview, and so do its pictures */
+    picture_size_limit = PREVIEW_CANVAS_W;
+    status = read_figc(filename,figure, DONT_MERGE, REMAP_IMAGES, 0,0,&settings);
+    picture_size_limit = 0;
+    if (status != 0) {
 	switch (status) {
 	   case -1: file_msg("Bad format");
 		   break;
@@ -35,6 +35,10 @@ static char	null_bits[null_width * null_height / 8] = {0};
 
 static Pixmap	null_pm, grid_pm = 0;
 static unsigned long bg, fg;
+static Boolean	grid_shown = False;	/* grid_pm is the canvas background */
+static int	grid_wd, grid_ht;	/* size of grid_pm */
+
+static Boolean	set_grid(Boolean pan);
 
 
 
@@ -56,6 +60,23 @@ void init_grid(void)
 /* grid in X11 is simply the background of the canvas */			// isometric grid
 
 void setup_grid(void)
+{
+    (void)set_grid(False);
+}
+
+/*
+ * The canvas was panned: draw the grid into the current pixmap, and change
+ * the background of the canvas without clearing it. Return False, if the
+ * grid needs a new pixmap; then, nothing was done and setup_grid() must be
+ * called, which redraws the whole canvas.
+ */
+Boolean pan_grid(void)
+{
+    return set_grid(True);
+}
+
+static Boolean
+set_grid(Boolean pan)
 {
     double	spacing;			/* grid spacing in pixels */
     double	x, x0c, y, y0c, y1c;
@@ -70,7 +91,10 @@ void setup_grid(void)
     grid = cur_gridmode;
 
     if( grid == GRID_0 ) {
+		if (pan)
+		    return !grid_shown;
 		FirstArg( XtNbackgroundPixmap, null_pm );
+		grid_shown = False;
     } else if( cur_gridtype == GRID_ISO ) {
 		grid_unit = cur_gridunit;
 
@@ -91,7 +115,10 @@ void setup_grid(void)
 
 		if( ys <= 4.0 ) {
 		    /* too small at this zoom, no grid */
+		    if (pan)
+			return !grid_shown;
 		    FirstArg(XtNbackgroundPixmap, null_pm);
+		    grid_shown = False;
 		    redisplay_canvas();
 		} else {
 			/* size of the pixmap equal to 1 inch or 2 cm to reset any
@@ -123,8 +150,15 @@ void setup_grid(void)
 //			printf( "xdim: %i\t ydim: %i\n", xdim, ydim );
 
 			/* clear pixmap */
-			if (grid_pm) XFreePixmap(tool_d, grid_pm);
-			grid_pm = XCreatePixmap(tool_d, canvas_win, xdim, ydim, tool_dpth);
+			if (pan) {
+			    if (!grid_shown || xdim != grid_wd || ydim != grid_ht)
+				return False;
+			} else {
+			    if (grid_pm) XFreePixmap(tool_d, grid_pm);
+			    grid_pm = XCreatePixmap(tool_d, canvas_win, xdim, ydim, tool_dpth);
+			    grid_wd = xdim;
+			    grid_ht = ydim;
+			}
 
 			/* first fill the pixmap with the background color */
 			XSetForeground(tool_d, grid_gc, bg);
@@ -154,8 +188,12 @@ void setup_grid(void)
 			    XDrawLine( tool_d, grid_pm, grid_gc, 0, (int) round(y), xdim, (int) round( y - yd ) );
 //			XDrawLine( tool_d, grid_pm, grid_gc, 0, 0, xdim, ydim );
 
-
+			if (pan) {
+			    XSetWindowBackgroundPixmap(tool_d, XtWindow(canvas_sw), grid_pm);
+			    return True;
+			}
 			FirstArg(XtNbackgroundPixmap, grid_pm);
+			grid_shown = True;
 		}
     } else {
 	    grid_unit = cur_gridunit;
@@ -175,7 +213,10 @@ void setup_grid(void)
 
 		if (spacing <= 4.0) {
 		    /* too small at this zoom, no grid */
+		    if (pan)
+			return !grid_shown;
 		    FirstArg(XtNbackgroundPixmap, null_pm);
+		    grid_shown = False;
 		    redisplay_canvas();
 		} else {
 			/* size of the pixmap equal to 1 inch or 2 cm to reset any
@@ -199,8 +240,14 @@ void setup_grid(void)
 			}
 //			printf( "dim: %i\n", dim );
 
-			if (grid_pm) XFreePixmap(tool_d, grid_pm);
-			grid_pm = XCreatePixmap(tool_d, canvas_win, dim, dim, tool_dpth);
+			if (pan) {
+			    if (!grid_shown || dim != grid_wd || dim != grid_ht)
+				return False;
+			} else {
+			    if (grid_pm) XFreePixmap(tool_d, grid_pm);
+			    grid_pm = XCreatePixmap(tool_d, canvas_win, dim, dim, tool_dpth);
+			    grid_wd = grid_ht = dim;
+			}
 
 			/* first fill the pixmap with the background color */
 			XSetForeground(tool_d, grid_gc, bg);
@@ -224,11 +271,17 @@ void setup_grid(void)
 			    XDrawLine(tool_d, grid_pm, grid_gc, 0, (int) round(y), dim, (int) round(y));
 //			printf( "done\n" );
 
+			if (pan) {
+			    XSetWindowBackgroundPixmap(tool_d, XtWindow(canvas_sw), grid_pm);
+			    return True;
+			}
 			FirstArg(XtNbackgroundPixmap, grid_pm);
+			grid_shown = True;
 		}
 	}
     SetValues(canvas_sw);
     if (prev_grid == GRID_0 && grid == GRID_0)
 	redisplay_canvas();
     prev_grid = grid;
+    return True;
 }
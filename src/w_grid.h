@@ -1,2 +1,3 @@
 extern void init_grid (void);
 extern void setup_grid (void);
+extern Boolean pan_grid (void);
@@ -4412,71 +4412,87 @@ show_numycopies(ind_sw_info *sw)
 
 /* ZOOM */
 
-/* zoom in */
-void
-inc_zoom(void)
+/* the zoom scale one step in from zoom */
+float
+zoom_in_scale(float zoom)
 {
     float	 intzoom;
 
-    /* don't allow zooming while previewing */
-    if (preview_in_progress || check_action_on())
-	return;
-
-    if (display_zoomscale < (float) 0.1) {
-	display_zoomscale = (int)(display_zoomscale * 100.0 + 0.1) + 1.0;
-	display_zoomscale /= 100.0;
-    } else if (display_zoomscale < 1.0) {
-	if (display_zoomscale < 0.1)
-	    display_zoomscale = 0.1;
+    if (zoom < (float) 0.1) {
+	zoom = (int)(zoom * 100.0 + 0.1) + 1.0;
+	zoom /= 100.0;
+    } else if (zoom < 1.0) {
+	if (zoom < 0.1)
+	    zoom = 0.1;
 	else
-	    display_zoomscale += 0.1; /* always quantized */
-	display_zoomscale = (int)(display_zoomscale*10.0+0.01);
-	display_zoomscale /= 10.0;
+	    zoom += 0.1; /* always quantized */
+	zoom = (int)(zoom*10.0+0.01);
+	zoom /= 10.0;
     } else {
 	if (integral_zoom) {
-	    intzoom = round(display_zoomscale * 1.5);
+	    intzoom = round(zoom * 1.5);
 	    /* if user wants integral zoom, but 1.5 factor isn't enough, just increment zoom by 1 */
-	    if (intzoom == display_zoomscale)
+	    if (intzoom == zoom)
 		intzoom++;
-	    display_zoomscale = intzoom;
+	    zoom = intzoom;
 	} else
-	    display_zoomscale = display_zoomscale * 1.5;
+	    zoom = zoom * 1.5;
     }
+    return zoom;
 }
 
-/* zoom out */
-void
-dec_zoom(void)
+/* the zoom scale one step out from zoom */
+float
+zoom_out_scale(float zoom)
 {
     float	 intzoom;
 
-    /* don't allow zooming while previewing */
-    if (preview_in_progress || check_action_on())
-	return;
-
-    if (display_zoomscale <= (float) 0.1) {
-	display_zoomscale = ((int)(display_zoomscale * 100.0 + 0.1)) - 1.0;
-	display_zoomscale /= 100.0;
-	if (display_zoomscale <= MIN_ZOOM)
-	    display_zoomscale = MIN_ZOOM;
-    } else if (display_zoomscale < (float) 0.3) {
-	display_zoomscale = 0.1; /* always quantized */
-    } else if (display_zoomscale <= (float) 1.0) {
-	display_zoomscale -= 0.1; /* always quantized */
-	display_zoomscale = (int)(display_zoomscale*10.0+0.01);
-	display_zoomscale /= 10.0;
+    if (zoom <= (float) 0.1) {
+	zoom = ((int)(zoom * 100.0 + 0.1)) - 1.0;
+	zoom /= 100.0;
+	if (zoom <= MIN_ZOOM)
+	    zoom = MIN_ZOOM;
+    } else if (zoom < (float) 0.3) {
+	zoom = 0.1; /* always quantized */
+    } else if (zoom <= (float) 1.0) {
+	zoom -= 0.1; /* always quantized */
+	zoom = (int)(zoom*10.0+0.01);
+	zoom /= 10.0;
     } else {
 	if (integral_zoom) {
-	    intzoom = round(display_zoomscale / 1.5);
+	    intzoom = round(zoom / 1.5);
 	    /* if user wants integral zoom, but 1.5 factor isn't enough, just decrement zoom by 1 */
-	    if (intzoom == display_zoomscale)
+	    if (intzoom == zoom)
 		intzoom--;
-	    display_zoomscale = intzoom;
+	    zoom = intzoom;
 	} else
-	    display_zoomscale = display_zoomscale / 1.5;
-	if (display_zoomscale < (float) 1.0)
-		display_zoomscale = 1.0;
+	    zoom = zoom / 1.5;
+	if (zoom < (float) 1.0)
+		zoom = 1.0;
     }
+    return zoom;
+}
+
+/* zoom in */
+void
+inc_zoom(void)
+{
+    /* don't allow zooming while previewing */
+    if (preview_in_progress || check_action_on())
+	return;
+
+    display_zoomscale = zoom_in_scale(display_zoomscale);
+}
+
+/* zoom out */
+void
+dec_zoom(void)
+{
+    /* don't allow zooming while previewing */
+    if (preview_in_progress || check_action_on())
+	return;
+
+    display_zoomscale = zoom_out_scale(display_zoomscale);
 }
 
 /* zoom in or out, keeping location x,y fixed */
@@ -4673,6 +4689,10 @@ show_zoom(ind_sw_info *sw)
     /* reload text objects' font structures since we need
 	to load larger/smaller fonts */
     reload_text_fstructs();
+    /* and load those for the next zoom steps while idle */
+    if (appres.prefetch_fonts)
+	prefetch_text_fstructs(zoom_in_scale(display_zoomscale),
+			zoom_out_scale(display_zoomscale));
     setup_grid();
     old_display_zoomscale = display_zoomscale;
 }
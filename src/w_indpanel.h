@@ -171,6 +171,8 @@ extern void	inc_zoom_centered(ind_sw_info *sw);
 extern void	dec_zoom_centered(ind_sw_info *sw);
 extern void	fit_zoom(ind_sw_info *sw);
 extern void	wheel_inc_zoom(), wheel_dec_zoom();
+extern float	zoom_in_scale(float zoom);
+extern float	zoom_out_scale(float zoom);
 extern void update_current_settings(void);
 extern void setup_ind_panel(void);
 extern void manage_update_buts (void);
@@ -29,6 +29,9 @@
 #include "w_layers.h"
 #include "w_util.h"
 #include "w_setup.h"
+#include "u_depth.h"
+#include "u_layercache.h"
+#include "u_rtree.h"
 #include "u_redraw.h"
 #include "w_snap.h"
 
@@ -108,6 +111,9 @@ void
 reset_depths(void)
 {
   int i;
+  invalidate_depth_index();
+  invalidate_spatial_index();
+  invalidate_layer_cache(-1);
   for (i=0; i<=MAX_DEPTH;  i++) {
      object_depths[i] = 0;
   }
@@ -557,14 +563,13 @@ toggle_layer(Widget w, XButtonEvent *event, String *params, Cardinal *nparams)
 		obscure = True;
 		break;
 	    }
-	if (!obscure) {
-	    clearcounts();
-	    redisplay_compoundobject(&objects, but);
-	} else
-	    redisplay_canvas();
+	if (!obscure)
+	    redisplay_depth(&objects, but);
+	else
+	    redisplay_layers();
     } else {
 	/* otherwise redraw whole canvas to get rid of that layer */
-	redisplay_canvas();
+	redisplay_layers();
     }
     pressed_but = but;
 }
@@ -605,7 +610,7 @@ sweep_layer(Widget w, XButtonEvent *event, String *params, Cardinal *nparams)
     }
 
     if (changed)
-	redisplay_canvas();
+	redisplay_layers();
 }
 
 static void
@@ -631,7 +636,7 @@ all_active(Widget w, XtPointer closure, XtPointer call_data)
     /* only redisplay if any of the buttons changed */
     if (changed) {
 	draw_layer_buttons();
-	redisplay_canvas();
+	redisplay_layers();
     }
 }
 
@@ -652,7 +657,7 @@ all_inactive(Widget w, XtPointer closure, XtPointer call_data)
     /* only redisplay if any of the buttons changed */
     if (changed) {
 	draw_layer_buttons();
-	redisplay_canvas();
+	redisplay_layers();
     }
 }
 
@@ -667,7 +672,7 @@ toggle_all(Widget w, XtPointer closure, XtPointer call_data)
 	active_layers[i] = !active_layers[i];
     }
     draw_layer_buttons();
-    redisplay_canvas();
+    redisplay_layers();
 }
 
 /* when user toggles between gray-out and blank inactive layers */
@@ -710,7 +715,7 @@ switch_layer_mode(Widget w, XtPointer closure, XtPointer call_data)
 
     /* now simply redisplay everything */
     clear_canvas();
-    redisplay_canvas();
+    redisplay_layers();
 }
 
 /* return True if *any* object in the compound is in any active layer */
@@ -974,6 +979,9 @@ void
 restore_depths(void)
 {
     int		 i;
+    invalidate_depth_index();
+    invalidate_spatial_index();
+    invalidate_layer_cache(-1);
     min_depth = saved_min_depth;
     max_depth = saved_max_depth;
     for (i=0; i<=MAX_DEPTH; i++)
@@ -998,6 +1006,10 @@ swap_depths(void)
     int	i;
     int	temp;
 
+    invalidate_depth_index();
+    invalidate_spatial_index();
+    invalidate_layer_cache(-1);
+
     temp = min_depth;
     min_depth = saved_min_depth;
     saved_min_depth = temp;
@@ -24,6 +24,7 @@
 #include "mode.h"
 #include "e_placelib.h"
 #include "e_placelib.h"
+#include "f_picobj.h"		/* picture_size_limit */
 #include "f_read.h"
 #include "u_create.h"
 #include "u_redraw.h"
@@ -1596,6 +1597,12 @@ MakeLibraryFileList(char *dir_name, char **obj_list)
   return True;
 }
 
+/* the number of entries of lib_compounds in the current library */
+int num_library_objects(void)
+{
+    return num_list_items;
+}
+
 /* update the status indicator with the string */
 
 static char statstr[100];
@@ -1653,7 +1660,11 @@ preview_libobj(int objnum, Pixmap pixmap, int pixsize, int margin)
     XDefineCursor(tool_d, XtWindow(library_form), wait_cursor);
     app_flush();
 
-    if ((status=load_lib_obj(objnum)) == True) {
+    /* the pictures of the object are not shown larger than the icon */
+    picture_size_limit = pixsize;
+    status = load_lib_obj(objnum);
+    picture_size_limit = 0;
+    if (status == True) {
 	compound = lib_compounds[objnum]->compound;
 	add_compound_depth(compound);	/* count objects at each depth */
 	/* put any comments in the comment window */
@@ -40,6 +40,7 @@
 #include "w_zoom.h"
 
 #include "u_geom.h"
+#include "u_threads.h"
 #include "w_color.h"
 
 /********************* EXPORTS *******************/
@@ -564,6 +565,7 @@ areameas_msg(char *msgtext, float area, float totarea, int flag)
 
 /* This is the section for the popup message window (file_msg) */
 /* if global update_figs is true, do a fprintf(stderr,msg) instead of in the window */
+/* messages from worker threads are passed on to the main thread */
 
 /* VARARGS1 */
 void
@@ -572,6 +574,16 @@ file_msg(char *format,...)
     XawTextBlock block;
     va_list ap;
 
+    if (!in_main_thread()) {
+	char	msg[512];
+
+	va_start(ap, format);
+	vsnprintf(msg, sizeof msg, format, ap);
+	va_end(ap);
+	main_thread_msg(msg);
+	return;
+    }
+
     if (!update_figs) {
 	popup_file_msg();
 	if (first_file_msg) {
@@ -40,11 +40,7 @@
 /* ---------------------------------------------------------------------- */
 
 
-/* Make sure cache size is set */
-
-#ifndef CACHE_SIZE_LIMIT
-#define CACHE_SIZE_LIMIT 0
-#endif /*CACHE_SIZE_LIMIT */
+/* The size of the cache is given by appres.text_cache, in kB */
 
 /* Cache by FID if can't find name because OpenWindows screws up */
 
@@ -100,10 +96,37 @@ typedef struct rotated_text_item_template {
     long int size;
     int cached;
 
-    struct rotated_text_item_template *next;
+    /* key of the hash table, see XRotRetrieveFromCache() */
+    unsigned long hash;
+    long angle_key;
+    int align_key;
+
+    struct rotated_text_item_template *hnext;	/* in the hash bucket */
+    struct rotated_text_item_template *prev;	/* less recently used */
+    struct rotated_text_item_template *next;	/* more recently used */
 } RotatedTextItem;
 
-RotatedTextItem *first_text_item=NULL;
+
+/* ---------------------------------------------------------------------- */
+
+
+/* The cache: a hash table, and a list from least to most recently used */
+
+static struct text_cache_template {
+    RotatedTextItem **table;
+    unsigned long nbuckets;
+    unsigned long nitems;
+    long int size;
+    RotatedTextItem *lru;
+    RotatedTextItem *mru;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evicted;
+} cache={
+    NULL, 0, 0, 0, NULL, NULL, 0, 0, 0
+    };
+
+#define CACHE_MIN_BUCKETS	256
 
 
 /* ---------------------------------------------------------------------- */
@@ -139,7 +162,8 @@ static int              XRotPaintAlignedString(Display *dpy, XFontStruct *font,
 static int              XRotDrawHorizontalString(Display *dpy, XFontStruct *font, Drawable drawable, GC gc, int x, int y, char *text, int align, int bg);
 static RotatedTextItem *XRotRetrieveFromCache(Display *dpy, XFontStruct *font, float angle, char *text, int align);
 static RotatedTextItem *XRotCreateTextItem(Display *dpy, XFontStruct *font, float angle, char *text, int align);
-static void             XRotAddToLinkedList(Display *dpy, RotatedTextItem *item);
+static void             XRotAddToCache(Display *dpy, RotatedTextItem *item);
+static void             XRotRemoveFromCache(RotatedTextItem *item);
 static void             XRotFreeTextItem(Display *dpy, RotatedTextItem *item);
 static XImage          *XRotMagnifyImage(Display *dpy, XImage *ximage);
 
@@ -688,6 +712,34 @@ XRotDrawHorizontalString(Display *dpy, XFontStruct *font, Drawable drawable, GC
 /* ---------------------------------------------------------------------- */
 
 
+/**************************************************************************/
+/*   Hash the key of a cache item                                         */
+/**************************************************************************/
+
+static unsigned long
+XRotHash(char *text, char *font_name, Font fid, long angle_key, float magnify,
+	 int align_key)
+{
+    unsigned long h=2166136261UL;	/* FNV-1a */
+    unsigned char *c;
+
+    for (c=(unsigned char *)text; *c; c++)
+	h=(h^*c)*16777619UL;
+    if (font_name!=NULL)
+	for (c=(unsigned char *)font_name; *c; c++)
+	    h=(h^*c)*16777619UL;
+    else
+	h=(h^(unsigned long)fid)*16777619UL;
+    h=(h^(unsigned long)angle_key)*16777619UL;
+    h=(h^(unsigned long)(long)(magnify*1024.))*16777619UL;
+    h=(h^(unsigned long)(align_key+1))*16777619UL;
+    return h;
+}
+
+
+/* ---------------------------------------------------------------------- */
+
+
 /**************************************************************************/
 /*   Query cache for a match with this font/text/angle/alignment          */
 /*       request, otherwise arrange for its creation                      */
@@ -700,7 +752,11 @@ static RotatedTextItem
     char *font_name=NULL;
     unsigned long name_value;
     RotatedTextItem *item=NULL;
-    RotatedTextItem *i1=first_text_item;
+    RotatedTextItem *i1;
+    unsigned long hash;
+    long angle_key;
+    int align_key;
+    int i, nl;
 
     /* get font name, if it exists */
     if (XGetFontProperty(font, XA_FONT, &name_value)) {
@@ -724,61 +780,62 @@ static RotatedTextItem
     }
 #endif /*CACHE_FID*/
 
-    /* look for a match in cache */
-
-    /* matching formula:
+    /* the key:
        identical text;
        identical fontname (if defined, font ID's if not);
-       angles close enough (<0.0001 here, could be smaller);
+       angles equal to within 0.0001;
        HORIZONTAL alignment matches, OR it's a one line string;
        magnifications the same */
 
-    while(i1 && !item) {
-	/* match everything EXCEPT fontname/ID */
-	if (strcmp(text, i1->text)==0 &&
-	   fabs(angle-i1->angle)<0.0001 &&
-	   style.magnify==i1->magnify &&
-	   (i1->nl==1 ||
-	    ((align==0)?9:(align-1))%3==
-	      ((i1->align==0)?9:(i1->align-1))%3)) {
-
-	    /* now match fontname/ID */
-	    if (font_name!=NULL && i1->font_name!=NULL) {
-		if (strcmp(font_name, i1->font_name)==0) {
-		    item=i1;
-		    DEBUG_PRINT1("Matched against font names\n");
-		}
-		else
-		    i1=i1->next;
-	    }
-#ifdef CACHE_FID
-	    else if (font_name==NULL && i1->font_name==NULL) {
-		if (fid==i1->fid) {
-		    item=i1;
-		    DEBUG_PRINT1("Matched against FID's\n");
-                }
-		else
-                    i1=i1->next;
-	    }
-#endif /*CACHE_FID*/
-	    else
-		i1=i1->next;
+    /* count the lines as XRotCreateTextItem() does */
+    nl=1;
+    if (align!=NONE)
+	for (i=0; text[i]!='\0' && text[i+1]!='\0'; i++)
+	    if (text[i]=='\n')
+		nl++;
+    align_key= nl==1 ? -1 : ((align==0)?9:(align-1))%3;
+    angle_key=(long)(angle*10000.+0.5);
+    hash=XRotHash(text, font_name, fid, angle_key, style.magnify, align_key);
+
+    if (cache.nbuckets>0) {
+	for (i1=cache.table[hash%cache.nbuckets]; i1 && !item; i1=i1->hnext) {
+	    if (i1->hash==hash && i1->angle_key==angle_key &&
+		    i1->align_key==align_key && i1->magnify==style.magnify &&
+		    strcmp(text, i1->text)==0 &&
+		    ((font_name!=NULL && i1->font_name!=NULL &&
+		      strcmp(font_name, i1->font_name)==0) ||
+		     (font_name==NULL && i1->font_name==NULL && fid==i1->fid)))
+		item=i1;
 	}
-	else
-	    i1=i1->next;
     }
 
-    if (item)
+    if (item) {
 	DEBUG_PRINT1("**Found target in cache.\n");
-    if (!item)
+	cache.hits++;
+	/* make it the most recently used item */
+	if (item!=cache.mru) {
+	    XRotRemoveFromCache(item);
+	    XRotAddToCache(dpy, item);
+	}
+    } else {
 	DEBUG_PRINT1("**No match in cache.\n");
+	cache.misses++;
+    }
+    if (appres.DEBUG && (cache.hits+cache.misses)%1000==0)
+	fprintf(stderr, "rotated text cache: %lu hits, %lu misses, %lu evicted,"
+		" %lu items, %ld of %d kB\n", cache.hits, cache.misses,
+		cache.evicted, cache.nitems, cache.size/1024,
+		appres.text_cache);
 
     /* no match */
     if (!item) {
 	/* create new item */
 	item=XRotCreateTextItem(dpy, font, angle, text, align);
-	if (!item)
+	if (!item) {
+	    if (font_name)
+		XFree(font_name);
 	    return NULL;
+	}
 
 	/* record what it shows */
 	item->text=strdup(text);
@@ -796,9 +853,13 @@ static RotatedTextItem
 	item->angle=angle;
 	item->align=align;
 	item->magnify=style.magnify;
+	item->hash=hash;
+	item->angle_key=angle_key;
+	item->align_key=align_key;
 
 	/* cache it */
-	XRotAddToLinkedList(dpy, item);
+	item->cached=0;
+	XRotAddToCache(dpy, item);
     }
 
     if (font_name)
@@ -1147,107 +1208,128 @@ static RotatedTextItem
 
 
 /**************************************************************************/
-/*  Adds a text item to the end of the cache, removing as many items      */
-/*      from the front as required to keep cache size below limit         */
+/*  Adds a text item to the cache, as the most recently used one, and     */
+/*      evicts the least recently used items to keep the cache size       */
+/*      below appres.text_cache kB                                        */
 /**************************************************************************/
 
 static void
-XRotAddToLinkedList(Display *dpy, RotatedTextItem *item)
+XRotAddToCache(Display *dpy, RotatedTextItem *item)
 {
+    long int limit=(long)appres.text_cache*1024;
+    unsigned long b;
 
-    static long int current_size=0;
-    static RotatedTextItem *last=NULL;
-    RotatedTextItem *i1=first_text_item, *i2=NULL;
+    /* an item moved to the front of the list is already accounted for */
+    if (!item->cached) {
 
 #ifdef CACHE_BITMAPS
 
-    /* I don't know how much memory a pixmap takes in the server -
-           probably this + a bit more we can't account for */
+	/* I don't know how much memory a pixmap takes in the server -
+	       probably this + a bit more we can't account for */
 
-    item->size=((item->cols_out-1)/8+1)*item->rows_out;
+	item->size=((item->cols_out-1)/8+1)*item->rows_out;
 
 #else
 
-    /* this is pretty much the size of a RotatedTextItem */
+	/* this is pretty much the size of a RotatedTextItem */
 
-    item->size=((item->cols_out-1)/8+1)*item->rows_out +
-	sizeof(XImage) + strlen(item->text) +
-	    item->nl*8*sizeof(float) + sizeof(RotatedTextItem);
+	item->size=((item->cols_out-1)/8+1)*item->rows_out +
+	    sizeof(XImage) + strlen(item->text) +
+		item->nl*8*sizeof(float) + sizeof(RotatedTextItem);
 
-    if (item->font_name!=NULL)
-	item->size+=strlen(item->font_name);
-    else
-	item->size+=sizeof(Font);
+	if (item->font_name!=NULL)
+	    item->size+=strlen(item->font_name);
+	else
+	    item->size+=sizeof(Font);
 
 #endif /*CACHE_BITMAPS */
 
-    /* count number of items in cache, for debugging */
-    if (appres.DEBUG) {
-	int i=0;
+	DEBUG_PRINT4("current cache size=%ld, new item=%ld, limit=%ld\n",
+		     cache.size, item->size, limit);
 
-	while(i1) {
-	    i++;
-	    i1=i1->next;
+	/* if this item is bigger than whole cache, forget it */
+	if (item->size>limit) {
+	    DEBUG_PRINT1("Too big to cache\n\n");
+	    return;
 	}
-	DEBUG_PRINT2("Cache has %d items.\n", i);
-	i1=first_text_item;
-    }
 
-    DEBUG_PRINT4("current cache size=%ld, new item=%ld, limit=%ld\n",
-		 current_size, item->size, CACHE_SIZE_LIMIT*1024);
+	/* remove the least recently used items as needed */
+	while (cache.lru && cache.size+item->size>limit) {
+	    RotatedTextItem *i1=cache.lru;
 
-    /* if this item is bigger than whole cache, forget it */
-    if (item->size>CACHE_SIZE_LIMIT*1024) {
-	DEBUG_PRINT1("Too big to cache\n\n");
-	item->cached=0;
-	return;
-    }
+	    DEBUG_PRINT2("Removed %ld bytes\n", i1->size);
+	    XRotRemoveFromCache(i1);
+	    cache.size-=i1->size;
+	    cache.nitems--;
+	    cache.evicted++;
+	    XRotFreeTextItem(dpy, i1);
+	}
 
-    /* remove elements from cache as needed */
-    while(i1 && current_size+item->size>CACHE_SIZE_LIMIT*1024) {
+	/* grow the hash table, if it gets crowded */
+	if (cache.nitems>=cache.nbuckets) {
+	    unsigned long n=cache.nbuckets ? 2*cache.nbuckets : CACHE_MIN_BUCKETS;
+	    RotatedTextItem **t, *i1;
 
-	DEBUG_PRINT2("Removed %d bytes\n", i1->size);
+	    if ((t=(RotatedTextItem **)calloc(n, sizeof(RotatedTextItem *)))) {
+		for (i1=cache.lru; i1; i1=i1->next) {
+		    i1->hnext=t[i1->hash%n];
+		    t[i1->hash%n]=i1;
+		}
+		free(cache.table);
+		cache.table=t;
+		cache.nbuckets=n;
+	    } else if (cache.nbuckets==0) {
+		return;
+	    }
+	}
 
-	if (i1->font_name!=NULL)
-	    DEBUG_PRINT5("  (`%s'\n   %s\n   angle=%f align=%d)\n",
-			 i1->text, i1->font_name, i1->angle, i1->align);
+	cache.size+=item->size;
+	cache.nitems++;
+	item->cached=1;
+	DEBUG_PRINT1("Added item to cache.\n");
+    }
 
-#ifdef CACHE_FID
-	if (i1->font_name==NULL)
-	    DEBUG_PRINT5("  (`%s'\n  FID=%ld\n   angle=%f align=%d)\n",
-                         i1->text, i1->fid, i1->angle, i1->align);
-#endif /*CACHE_FID*/
+    /* put it into its bucket */
+    b=item->hash%cache.nbuckets;
+    item->hnext=cache.table[b];
+    cache.table[b]=item;
 
-	current_size-=i1->size;
+    /* and at the most recently used end of the list */
+    item->prev=cache.mru;
+    item->next=NULL;
+    if (cache.mru)
+	cache.mru->next=item;
+    else
+	cache.lru=item;
+    cache.mru=item;
+}
 
-	i2=i1->next;
 
-	/* free resources used by the unlucky item */
-	XRotFreeTextItem(dpy, i1);
+/* ---------------------------------------------------------------------- */
 
-	/* remove it from linked list */
-	first_text_item=i2;
-	i1=i2;
-    }
 
-    /* add new item to end of linked list */
-    if (first_text_item==NULL) {
-	item->next=NULL;
-	first_text_item=item;
-	last=item;
-    }
-    else {
-	item->next=NULL;
-	last->next=item;
-	last=item;
-    }
+/**************************************************************************/
+/*  Unlink a text item from the hash table and the list; its size is      */
+/*      still accounted for                                               */
+/**************************************************************************/
 
-    /* new cache size */
-    current_size+=item->size;
+static void
+XRotRemoveFromCache(RotatedTextItem *item)
+{
+    RotatedTextItem **p;
 
-    item->cached=1;
+    for (p=&cache.table[item->hash%cache.nbuckets]; *p!=item; p=&(*p)->hnext)
+	;
+    *p=item->hnext;
 
-    DEBUG_PRINT1("Added item to cache.\n");
+    if (item->prev)
+	item->prev->next=item->next;
+    else
+	cache.lru=item->next;
+    if (item->next)
+	item->next->prev=item->prev;
+    else
+	cache.mru=item->prev;
 }
 
 
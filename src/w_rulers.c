@@ -970,7 +970,7 @@ topruler_selected(Widget tool, XButtonEvent *event, String *params, Cardinal *np
 	    break;
 	  case Button2:
 	    if (orig_zoomoff != zoomxoff)
-		setup_grid();
+		pan_canvas(orig_zoomoff, zoomyoff);
 	    break;
 	  case Button3:
 	    pan_right(event->state&ShiftMask);
@@ -1297,7 +1297,7 @@ sideruler_selected(Widget tool, XButtonEvent *event, String *params, Cardinal *n
 	    break;
 	case Button2:
 	    if (orig_zoomoff != zoomyoff)
-		setup_grid();
+		pan_canvas(zoomxoff, orig_zoomoff);
 	    break;
 	case Button3:
 	    pan_down(event->state&ShiftMask);
@@ -0,0 +1,115 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2007 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies
+ * of the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+/*
+ *	test4.c: Compare the vectorized and the scalar evaluation of X-spline
+ *	segments, and measure their speed.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* u_xspline.c */
+extern void	xspline_points(int k, double s1, double s2, const int *px,
+			const int *py, const double *t, int n, int *x, int *y);
+extern void	xspline_points_scalar(int k, double s1, double s2,
+			const int *px, const int *py, const double *t, int n,
+			int *x, int *y);
+
+#define NSEG	20000
+#define MAXN	64
+#define NREP	50
+
+/* shape factors of X-splines are within [-1, 1] */
+static double
+random_sfactor(void)
+{
+	switch (rand() % 4) {
+	case 0:
+		return 0.0;
+	case 1:
+		return rand() % 2 ? 1.0 : -1.0;
+	default:
+		return (double)(rand() % 2001 - 1000) / 1000.;
+	}
+}
+
+int
+main(void)
+{
+	static int	k[NSEG], n[NSEG], px[NSEG][4], py[NSEG][4];
+	static double	s1[NSEG], s2[NSEG], t[NSEG][MAXN];
+	int		x[MAXN], y[MAXN], xs[MAXN], ys[MAXN];
+	int		i, j, r;
+	float		step;
+	double		tt;
+	clock_t		c;
+
+	srand(1);
+	for (i = 0; i < NSEG; ++i) {
+		k[i] = rand() % 8 - 1;
+		s1[i] = random_sfactor();
+		s2[i] = random_sfactor();
+		for (j = 0; j < 4; ++j) {
+			px[i][j] = rand() % 200001 - 100000;
+			py[i][j] = rand() % 200001 - 100000;
+		}
+		/* the parameter values, as in spline_segment_computing() */
+		step = (float)(rand() % 1000 + 1) / 5000.f;
+		n[i] = 0;
+		for (tt = 0.0; tt < 1 && n[i] < MAXN; tt += step)
+			t[i][n[i]++] = tt;
+	}
+
+	for (i = 0; i < NSEG; ++i) {
+		xspline_points(k[i], s1[i], s2[i], px[i], py[i], t[i], n[i],
+				x, y);
+		xspline_points_scalar(k[i], s1[i], s2[i], px[i], py[i], t[i],
+				n[i], xs, ys);
+		for (j = 0; j < n[i]; ++j) {
+			if (x[j] != xs[j] || y[j] != ys[j]) {
+				fprintf(stderr, "segment %d, t = %.17g: (%d, %d) "
+					"differs from (%d, %d)\n", i, t[i][j],
+					x[j], y[j], xs[j], ys[j]);
+				return 1;
+			}
+		}
+	}
+
+	c = clock();
+	for (r = 0; r < NREP; ++r)
+		for (i = 0; i < NSEG; ++i)
+			xspline_points_scalar(k[i], s1[i], s2[i], px[i], py[i],
+					t[i], n[i], xs, ys);
+	printf("scalar:     %.3f s\n", (double)(clock() - c) / CLOCKS_PER_SEC);
+
+	c = clock();
+	for (r = 0; r < NREP; ++r)
+		for (i = 0; i < NSEG; ++i)
+			xspline_points(k[i], s1[i], s2[i], px[i], py[i], t[i],
+					n[i], x, y);
+	printf("vectorized: %.3f s\n", (double)(clock() - c) / CLOCKS_PER_SEC);
+
+	return 0;
+}
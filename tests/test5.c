@@ -0,0 +1,91 @@
+/*
+ * FIG : Facility for Interactive Generation of figures
+ * Copyright (c) 1985-1988 by Supoj Sutanthavibul
+ * Parts Copyright (c) 1989-2007 by Brian V. Smith
+ * Parts Copyright (c) 1991 by Paul King
+ * Parts Copyright (c) 2016-2020 by Thomas Loimer
+ *
+ * Any party obtaining a copy of these files is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and documentation
+ * files (the "Software"), including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense and/or sell copies
+ * of the Software, and to permit persons who receive copies from any such
+ * party to do so, with the only requirement being that the above copyright
+ * and this permission notice remain intact.
+ *
+ */
+
+/*
+ *	test5.c: The spatial index, src/u_rtree.c, must return thick lines and
+ *	splines whose stroke reaches into the queried rectangle, although
+ *	their points are outside.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fig.h"
+#include "resources.h"
+#include "object.h"
+#include "u_depth.h"
+#include "u_rtree.h"
+#include "w_setup.h"		/* PIX_PER_INCH */
+
+static F_point	p[6] = {
+	{ 0, 1000, &p[1] }, { 2400, 1000, NULL },	/* a thick line */
+	{ 0, 5000, &p[3] }, { 2400, 5000, NULL },	/* a thick spline */
+	{ 0, 9000, &p[5] }, { 2400, 9000, NULL }	/* a thin line, far away */
+};
+static F_line	thin = {
+	.type = T_POLYLINE, .thickness = 1, .depth = 50, .points = &p[4]
+};
+static F_line	line = {
+	.type = T_POLYLINE, .thickness = 20, .depth = 50, .points = &p[0],
+	.next = &thin
+};
+static F_spline	spline = {
+	.type = T_OPEN_APPROX, .thickness = 20, .depth = 50, .points = &p[2]
+};
+
+/* return the number of objects found in the rectangle, or -1 */
+static int
+query(int xmin, int ymin, int xmax, int ymax, void *obj)
+{
+	F_depth_obj	*objs;
+	int		num;
+
+	if (!spatial_query(&objects, xmin, ymin, xmax, ymax, &objs, &num))
+		return -1;
+	if (num == 1 && objs[0].obj != obj)
+		return -1;
+	return num;
+}
+
+int
+main(void)
+{
+	int	errcode = 0;
+
+	ZOOM_FACTOR = PIX_PER_INCH / DISPLAY_PIX_PER_INCH;
+	objects.lines = &line;
+	objects.splines = &spline;
+
+	/* A stroke of thickness 20 reaches 20 * 15 / 2 = 150 units to either
+	   side of its points, into the rectangles 100 units away, ... */
+	if (query(0, 1100, 2400, 2000, &line) != 1)
+		errcode |= 0x1;
+	if (query(0, 5100, 2400, 6000, &spline) != 1)
+		errcode |= 0x2;
+	if (query(0, 4000, 2400, 4900, &spline) != 1)
+		errcode |= 0x4;
+
+	/* ... but not into those 300 units away */
+	if (query(0, 1300, 2400, 2000, NULL) != 0)
+		errcode |= 0x8;
+	if (query(0, 5300, 2400, 6000, NULL) != 0)
+		errcode |= 0x10;
+	return errcode;
+}